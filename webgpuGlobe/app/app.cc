@@ -178,10 +178,19 @@ namespace wg {
         requiredLimits.limits.minStorageBufferOffsetAlignment  = supportedLimits.limits.minStorageBufferOffsetAlignment;
         requiredLimits.limits.minUniformBufferOffsetAlignment  = supportedLimits.limits.minUniformBufferOffsetAlignment;
 
+        // Optional features: only request them if the adapter has them, and record what we got in `appObjects`.
+        std::vector<WGPUFeatureName> requiredFeatures;
+        if (wgpuAdapterHasFeature(appObjects.adapter, WGPUFeatureName_TextureCompressionBC)) {
+            requiredFeatures.push_back(WGPUFeatureName_TextureCompressionBC);
+            appObjects.textureCompressionBC = true;
+        }
+        logger->info("TextureCompressionBC supported: {}", appObjects.textureCompressionBC);
+
         WGPUDeviceDescriptor deviceDesc;
         deviceDesc.nextInChain          = nullptr;
         deviceDesc.label                = "MyDevice";
-        deviceDesc.requiredFeatureCount = 0;
+        deviceDesc.requiredFeatureCount = requiredFeatures.size();
+        deviceDesc.requiredFeatures     = requiredFeatures.data();
         deviceDesc.requiredLimits       = &requiredLimits;
         deviceDesc.defaultQueue.label   = "MyQueue";
         deviceDesc.deviceLostCallback = [](WGPUDeviceLostReason reason, char const* msg, void* userdata) {
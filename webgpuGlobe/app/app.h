@@ -78,6 +78,9 @@ namespace wg {
         WGPUTextureFormat surfaceColorFormat        = WGPUTextureFormat_Undefined;
         WGPUTextureFormat surfaceDepthStencilFormat = WGPUTextureFormat_Undefined;
 
+		// Optional device features, set only if the adapter supported them and they were requested.
+		bool textureCompressionBC = false;
+
 		BindGroupLayout *sceneBindGroupLayoutPtr = nullptr;
 		inline BindGroupLayout& getSceneBindGroupLayout(bool required=true) {
 			if (required) assert(sceneBindGroupLayoutPtr != nullptr);
@@ -266,6 +266,13 @@ namespace wg {
         inline void setIndexBuffer(Buffer& b, WGPUIndexFormat format, uint64_t offset, uint64_t size) {
             wgpuRenderPassEncoderSetIndexBuffer(ptr, b.ptr, format, offset, size);
         }
+        // Non-owning handles, for draw lists made away from the buffers' owner.
+        inline void setVertexBuffer(uint32_t slot, WGPUBuffer buffer, uint64_t offset, uint64_t size) {
+            wgpuRenderPassEncoderSetVertexBuffer(ptr, slot, buffer, offset, size);
+        }
+        inline void setIndexBuffer(WGPUBuffer b, WGPUIndexFormat format, uint64_t offset, uint64_t size) {
+            wgpuRenderPassEncoderSetIndexBuffer(ptr, b, format, offset, size);
+        }
     };
 
     struct RenderPassEncoder;
@@ -140,7 +140,7 @@ namespace wg {
 
             std::vector<double> pts(pts_uwm);
             spdlog::get("wg")->info("transforming pts");
-            unit_wm_to_ecef(pts.data(), pts.size() / 3, pts_uwm.data());
+            unit_wm_to_ecef_batch(pts.data(), pts.size() / 3, pts_uwm.data());
             spdlog::get("wg")->info("making verts");
 
             std::vector<float> verts;
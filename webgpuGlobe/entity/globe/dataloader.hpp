@@ -7,6 +7,10 @@
 #include <thread>
 #include <unistd.h>
 #include <deque>
+#include <algorithm>
+#include <atomic>
+#include <unordered_map>
+#include <vector>
 
 // #define logTrace1(...) spdlog::get("tiffRndr")->trace( __VA_ARGS__ );
 #define logTrace1(...) {};
@@ -22,6 +26,74 @@ namespace wg {
 
     enum class LoadAction { LoadRoot, OpenChildren, CloseToParent };
 
+	// How often the loader had to allocate, see `TileDataPool` and `BaseDataLoader::allocStats`.
+	struct LoaderAllocStats {
+		uint64_t itemsCreated  = 0; // `TileData`s made because the pool was empty
+		uint64_t itemsReused   = 0; // ... taken from the pool instead
+		uint64_t itemsRecycled = 0; // ... given back to the pool after upload
+		uint64_t bufferGrowths = 0; // payload or scratch buffers that had to grow (reported by the derived loader)
+	};
+
+	//
+	// Recycles `TileData`s (and the item lists of responses) so that their payload buffers -- image, vertices, heights --
+	// keep their capacity from tile to tile. Once the render thread has uploaded a response it gives the items back
+	// with `recycle`, and the workers `take` them for the next tiles: in the steady state nothing is allocated.
+	//
+	// A taken item still holds the last tile's data, so `loadActualData` must overwrite all of it.
+	// A globe that never recycles just gets fresh items, as before.
+	//
+	template <class TileData>
+	struct TileDataPool {
+
+		// At most this many items (each holds a tile's worth of buffers) are kept, the rest are freed. Set by `loaderPoolSize`.
+		size_t maxFree = 64;
+
+		inline TileData take() {
+			{
+				std::lock_guard<std::mutex> lck(mtx);
+				if (freeItems.size()) {
+					TileData item = std::move(freeItems.back());
+					freeItems.pop_back();
+					stats.itemsReused++;
+					return item;
+				}
+				stats.itemsCreated++;
+			}
+			return TileData{};
+		}
+
+		// An empty list, with the capacity of one that was recycled.
+		inline std::vector<TileData> takeList() {
+			std::lock_guard<std::mutex> lck(mtx);
+			if (freeLists.empty()) return {};
+			std::vector<TileData> list = std::move(freeLists.back());
+			freeLists.pop_back();
+			return list;
+		}
+
+		inline void recycle(std::vector<TileData>&& items) {
+			std::lock_guard<std::mutex> lck(mtx);
+			for (auto& item : items) {
+				if (freeItems.size() >= maxFree) break;
+				freeItems.push_back(std::move(item));
+				stats.itemsRecycled++;
+			}
+			items.clear();
+			if (freeLists.size() < maxFree) freeLists.push_back(std::move(items));
+		}
+
+		inline LoaderAllocStats getStats() {
+			std::lock_guard<std::mutex> lck(mtx);
+			return stats;
+		}
+
+		private:
+		std::mutex mtx;
+		std::vector<TileData> freeItems;
+		std::vector<std::vector<TileData>> freeLists;
+		LoaderAllocStats stats;
+	};
+
 	template <class GlobeTypes>
 	struct BaseDataLoader {
 
@@ -44,6 +116,14 @@ namespace wg {
 			// When closing: the parent coordinate to load data for.
 			TheCoordinate parentCoord;
 			LoadAction action;
+
+			// When opening: if not empty, the tiles to load instead of the children. Deeper descendants of `parentCoord`,
+			// for a globe that skips levels when refining (see the tiff globe's `Tile::refinementCut`).
+			std::vector<TheCoordinate> coords;
+
+			// The loader splits an open into one part per tile (see `DiskDataLoader::pushRequests`), each answered on its own.
+			int32_t part   = 0;
+			int32_t nparts = 1;
 		};
 
 		struct LoadDataResponse {
@@ -52,6 +132,10 @@ namespace wg {
 			TheCoordinate parentCoord;
 			LoadAction action;
 			std::vector<TileData> items;
+
+			// Which part of the request this answers: an open is answered child by child, as each is loaded.
+			int32_t part   = 0;
+			int32_t nparts = 1;
 		};
 
 		struct UpdateState {
@@ -59,19 +143,42 @@ namespace wg {
 			Vector3f eye;
 			float tanHalfFovTimesHeight;
 
+			// Tiles open above the one and close below the other (see `SseGovernor`).
+			float sseOpenThresh  = 4.f;
+			float sseCloseThresh = .7f;
+
 			std::vector<LoadDataRequest> requests;
 			int32_t seq = 0;
+
+			// Skip-level refinement: how many levels below the children an open may reach, and the boxes to decide by.
+			int maxSkipLevels = 0;
+			TheBoundingBoxMap* boundingBoxMap = nullptr;
 		};
 
 		public:
 
 		TheBoundingBoxMap boundingBoxMap;
+		TileDataPool<TileData> tileDataPool;
 
 		inline virtual ~BaseDataLoader() {}
 
         virtual void pushRequests(std::vector<LoadDataRequest>&& reqs) =0;
         virtual std::deque<LoadDataResponse> pullResponses() =0;
 
+        // Give a response's items back once they are uploaded, so the loader can reuse their buffers.
+        inline void recycle(LoadDataResponse&& resp) {
+            tileDataPool.recycle(std::move(resp.items));
+        }
+
+        inline virtual LoaderAllocStats allocStats() {
+            return tileDataPool.getStats();
+        }
+
+        // Requests pushed and not yet all pulled back (see `SseGovernor`). An open counts once, whatever the parts it is split into.
+        inline virtual int loadsInFlight() const {
+            return 0;
+        }
+
 		// -----------------------------------------------------------------------------------------------------
 		// Misc.
 		// -----------------------------------------------------------------------------------------------------
@@ -109,6 +216,11 @@ namespace wg {
 				logger = spdlog::stdout_color_mt("tiffLoader");
 			else
 				logger = spdlog::get("tiffLoader");
+
+			// Requests are independent (a tile never has more than one in flight), so any number of workers may serve them,
+			// as long as `Derived::loadActualData` is thread safe.
+			nworkers = std::max(1, (int)opts.getDouble("loaderThreads", 1));
+			Super::tileDataPool.maxFree = std::max(0, (int)opts.getDouble("loaderPoolSize", 64));
         }
 
 
@@ -118,12 +230,15 @@ namespace wg {
 
         inline void join() {
             stop = true;
-            cv.notify_one();
-            if (thread.joinable()) thread.join();
+            cv.notify_all();
+            for (auto& thread : threads)
+                if (thread.joinable()) thread.join();
+            threads.clear();
         }
 
 		inline void start() {
-            thread = std::thread(&DiskDataLoader::loop, this);
+            for (int i = 0; i < nworkers; i++) threads.emplace_back(&DiskDataLoader::loop, this);
+            if (nworkers > 1) logger->info("started {} loader threads", nworkers);
 		}
 
 
@@ -141,8 +256,9 @@ namespace wg {
             while (true) {
                 if (stop) break;
 
-                // Acquire requests results.
-                std::deque<LoadDataRequest> qInCopied;
+                // Take one request at a time, so that the other workers can take the rest, and so that each result is
+                // handed back as soon as it is ready rather than with the whole batch.
+                LoadDataRequest req;
                 {
                     std::unique_lock<std::mutex> lck(mtxIn);
                     cv.wait(lck, [this]() { return stop or qIn.size() > 0; });
@@ -150,64 +266,59 @@ namespace wg {
 
                     if (stop) break;
 
-                    // With the lock held, copy all requests.
-                    qInCopied = std::move(this->qIn);
-                }
-
-                if (qInCopied.size() == 0) {
-                    // FIXME: Improve this logic...
-                    logTrace1("no input requests -- sleeping 100ms");
-                    usleep(100'000);
-                    continue;
+                    req = std::move(qIn.front());
+                    qIn.pop_front();
                 }
 
                 // Load data.
-                std::vector<LoadDataResponse> qOutLocal;
-				qOutLocal.reserve(qInCopied.size());
-                for (const auto& req : qInCopied) { qOutLocal.emplace_back(load(req)); }
+                LoadDataResponse resp = load(req);
 
                 // Write results.
                 {
                     std::unique_lock<std::mutex> lck(mtxOut);
-                    logTrace1("appending {} results, now have {}", qOutLocal.size(), qOut.size() + qOutLocal.size());
-                    for (auto& resp : qOutLocal) qOut.push_back(std::move(resp));
+                    logTrace1("appending result, now have {}", qOut.size() + 1);
+                    qOut.push_back(std::move(resp));
                 }
             }
         }
 
         inline LoadDataResponse load(const LoadDataRequest& req) {
-            std::vector<TileData> items;
+            std::vector<TileData> items = Super::tileDataPool.takeList();
+
+            auto loadItem = [&](const TheCoordinate& c, const UnpackedOrientedBoundingBox& bb) {
+                TileData item = Super::tileDataPool.take();
+                static_cast<Derived*>(this)->loadActualData(item, c);
+                item.coord    = c;
+                item.terminal = bb.terminal;
+                item.root     = bb.root;
+                items.push_back(std::move(item));
+            };
 
-            if (req.action == LoadAction::OpenChildren) {
+            if (req.action == LoadAction::OpenChildren and req.coords.size()) {
+                for (const TheCoordinate& c : req.coords) {
+                    auto boundingBoxIt = Super::boundingBoxMap.find(c);
+                    assert(boundingBoxIt != Super::boundingBoxMap.end());
+                    loadItem(c, boundingBoxIt->second);
+                }
+				logTrace1("for OpenChildren action (skipping levels), pushed {} items", items.size());
+            } else if (req.action == LoadAction::OpenChildren) {
                 for (uint32_t childIndex = 0; childIndex < TheCoordinate::MaxChildren; childIndex++) {
                     TheCoordinate childCoord = req.parentCoord.child(childIndex);
 
                     auto boundingBoxIt                    = Super::boundingBoxMap.find(childCoord);
 
-                    if (boundingBoxIt != Super::boundingBoxMap.end()) {
-                        TileData item;
-                        static_cast<Derived*>(this)->loadActualData(item, childCoord);
-						item.coord = childCoord;
-                        item.terminal = boundingBoxIt->second.terminal;
-                        item.root     = boundingBoxIt->second.root;
-                        items.push_back(std::move(item));
-                    }
+                    if (boundingBoxIt != Super::boundingBoxMap.end()) loadItem(childCoord, boundingBoxIt->second);
                 }
 				logTrace1("for OpenChildren action, pushed {} items", items.size());
             } else if (req.action == LoadAction::CloseToParent or req.action == LoadAction::LoadRoot) {
                 auto boundingBoxIt = Super::boundingBoxMap.find(req.parentCoord);
                 assert(boundingBoxIt != Super::boundingBoxMap.end());
-
-                TileData item;
-                static_cast<Derived*>(this)->loadActualData(item, req.parentCoord);
-				item.coord = req.parentCoord;
-                item.terminal = boundingBoxIt->second.terminal;
-                item.root     = boundingBoxIt->second.root;
-                items.push_back(std::move(item));
+                loadItem(req.parentCoord, boundingBoxIt->second);
             }
 
             return LoadDataResponse {
-                .seq = req.seq, .src = req.src, .parentCoord = req.parentCoord, .action = req.action, .items = std::move(items)
+                .seq = req.seq, .src = req.src, .parentCoord = req.parentCoord, .action = req.action, .items = std::move(items),
+                .part = req.part, .nparts = req.nparts
             };
         }
 
@@ -216,22 +327,71 @@ namespace wg {
 		// -----------------------------------------------------------------------------------------------------
 
         // Called from main thread, typically.
+        // An open is queued as one part per tile to load, so that the workers load the children independently and each
+        // one is handed back as soon as it is ready, rather than all of them once the slowest is.
         inline virtual void pushRequests(std::vector<LoadDataRequest>&& reqs) override {
+            size_t n = 0, queued = 0;
             {
                 std::unique_lock<std::mutex> lck(mtxIn);
-                // What is the difference between the following two lines, and is one more correct?
-                for (auto& req : reqs) qIn.push_back(std::move(req));
-                // for (auto&& req : reqs) qIn.push_back(std::move(req));
+                size_t before = qIn.size();
+                for (auto& req : reqs) n += pushParts_(std::move(req));
+                // (Counted before a worker can see them, so that `pullResponses` never takes the count below zero)
+                nInFlight += n;
+                queued = qIn.size() - before;
             }
-            cv.notify_one();
+            if (queued > 1) cv.notify_all();
+            else cv.notify_one();
         }
 
         // Called from main thread, typically.
         inline virtual std::deque<LoadDataResponse> pullResponses() override {
             std::unique_lock<std::mutex> lck(mtxOut);
+            // A split request is done with its last part. (A tile has at most one request in flight, so `src` names it)
+            for (const auto& resp : qOut) {
+                if (resp.nparts <= 1) nInFlight--;
+                else if (++partsPulled[resp.src] == resp.nparts) {
+                    partsPulled.erase(resp.src);
+                    nInFlight--;
+                }
+            }
             return std::move(qOut);
         }
 
+        inline virtual int loadsInFlight() const override {
+            return nInFlight;
+        }
+
+        private:
+        // (mtxIn is held) Returns how many requests (not parts) it queued.
+        inline size_t pushParts_(LoadDataRequest&& req) {
+            if (req.action != LoadAction::OpenChildren) {
+                qIn.push_back(std::move(req));
+                return 1;
+            }
+            std::vector<TheCoordinate> coords = std::move(req.coords);
+            if (coords.empty()) {
+                for (uint32_t childIndex = 0; childIndex < TheCoordinate::MaxChildren; childIndex++) {
+                    TheCoordinate childCoord = req.parentCoord.child(childIndex);
+                    if (Super::boundingBoxMap.find(childCoord) != Super::boundingBoxMap.end()) coords.push_back(childCoord);
+                }
+            }
+            // (No children to load: answered once, with no items, like before)
+            if (coords.empty()) {
+                qIn.push_back(std::move(req));
+                return 1;
+            }
+            for (size_t i = 0; i < coords.size(); i++) {
+                LoadDataRequest part = req;
+                part.coords          = { coords[i] };
+                part.part            = i;
+                part.nparts          = coords.size();
+                qIn.push_back(std::move(part));
+            }
+            return 1;
+        }
+
+        public:
+
 
 		// -----------------------------------------------------------------------------------------------------
 		// Fields
@@ -243,8 +403,11 @@ namespace wg {
 
         std::condition_variable cv;
         std::mutex mtxIn, mtxOut;
-        std::thread thread;
+        std::vector<std::thread> threads;
+        int nworkers = 1;
         std::atomic<bool> stop;
+        std::atomic<int> nInFlight { 0 };
+        std::unordered_map<void*, int32_t> partsPulled; // (mtxOut) of the split requests not yet done
         std::shared_ptr<spdlog::logger> logger;
 
 	};
@@ -0,0 +1,116 @@
+#include "rt_decode.hpp"
+#include "util/mappedFile.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+
+//
+// Decodes a corpus of rocktree node files (`<gearthPath>/node/*`) with the scalar and the SIMD kernels of `rt_simd.hpp`,
+// checks the outputs are identical, then reports the throughput of each.
+//
+// Usage: benchDecode <gearthPath> [maxNodes=1000] [iters=5] [keepDxt1=1]
+//
+
+using namespace wg;
+using namespace wg::gearth;
+
+namespace {
+
+	bool sameTile(const DecodedCpuTileData& a, const DecodedCpuTileData& b) {
+		if (memcmp(a.modelMat, b.modelMat, sizeof(a.modelMat)) != 0) return false;
+		if (a.meshes.size() != b.meshes.size()) return false;
+		for (size_t i=0; i<a.meshes.size(); i++) {
+			auto& ma = a.meshes[i];
+			auto& mb = b.meshes[i];
+			if (ma.vert_buffer_cpu.size() != mb.vert_buffer_cpu.size()) return false;
+			if (memcmp(ma.vert_buffer_cpu.data(), mb.vert_buffer_cpu.data(), ma.vert_buffer_cpu.size() * sizeof(RtPackedVertex)) != 0) return false;
+			if (ma.ind_buffer_cpu != mb.ind_buffer_cpu) return false;
+			if (ma.img_buffer_cpu != mb.img_buffer_cpu) return false;
+			if (memcmp(ma.layerBounds, mb.layerBounds, sizeof(ma.layerBounds)) != 0) return false;
+		}
+		return true;
+	}
+
+	// Returns seconds.
+	double decodeAll(const std::vector<MappedFile>& files, int iters, bool keepDxt1) {
+		auto st = std::chrono::high_resolution_clock::now();
+		for (int it=0; it<iters; it++) {
+			for (auto& f : files) {
+				DecodedCpuTileData dtd;
+				decode_node_to_tile(f.data(), f.size(), dtd, true, keepDxt1);
+			}
+		}
+		auto et = std::chrono::high_resolution_clock::now();
+		return std::chrono::duration<double>(et - st).count();
+	}
+
+}
+
+int main(int argc, char** argv) {
+	if (argc < 2) {
+		fmt::print("Usage: {} <gearthPath> [maxNodes=1000] [iters=5] [keepDxt1=1]\n", argv[0]);
+		return 1;
+	}
+
+	std::string root = argv[1];
+	size_t maxNodes  = argc > 2 ? std::stoul(argv[2]) : 1000;
+	int iters        = argc > 3 ? std::stoi(argv[3]) : 5;
+	bool keepDxt1    = argc > 4 ? std::stoi(argv[4]) != 0 : true;
+
+	std::vector<std::string> paths;
+	for (auto& ent : std::filesystem::directory_iterator(root + "/node")) {
+		if (ent.is_regular_file()) paths.push_back(ent.path().string());
+	}
+	std::sort(paths.begin(), paths.end());
+	if (paths.size() > maxNodes) paths.resize(maxNodes);
+
+	std::vector<MappedFile> files;
+	std::vector<std::string> filePaths; // paths[] of files[], skipping the ones that did not open
+	size_t totalBytes = 0;
+	for (auto& path : paths) {
+		MappedFile f;
+		if (not f.open(path, false)) continue;
+		totalBytes += f.size();
+		files.push_back(std::move(f));
+		filePaths.push_back(path);
+	}
+	fmt::print(" - Corpus: {} nodes, {:.2f} MB.\n", files.size(), totalBytes / (1024. * 1024.));
+	if (files.empty()) return 1;
+
+	// Check the kernels are bit-exact with the scalar loops.
+	int mismatches = 0, failures = 0;
+	for (size_t i=0; i<files.size(); i++) {
+		DecodedCpuTileData a, b;
+		simdEnabled() = false;
+		bool badA = decode_node_to_tile(files[i].data(), files[i].size(), a, true, keepDxt1);
+		simdEnabled() = true;
+		bool badB = decode_node_to_tile(files[i].data(), files[i].size(), b, true, keepDxt1);
+		if (badA or badB) {
+			failures++;
+			if (badA != badB) fmt::print(" - '{}': scalar bad={} simd bad={}\n", filePaths[i], badA, badB);
+			continue;
+		}
+		if (not sameTile(a, b)) {
+			fmt::print(" - '{}': outputs differ!\n", filePaths[i]);
+			mismatches++;
+		}
+	}
+	fmt::print(" - Checked {} nodes, {} mismatches, {} failed to decode.\n", files.size(), mismatches, failures);
+
+	// Warm up, then time.
+	decodeAll(files, 1, keepDxt1);
+
+	double mb = totalBytes * iters / (1024. * 1024.);
+	double n  = (double)files.size() * iters;
+
+	simdEnabled() = false;
+	double scalarTime = decodeAll(files, iters, keepDxt1);
+	simdEnabled() = true;
+	double simdTime = decodeAll(files, iters, keepDxt1);
+
+	fmt::print(" - scalar: {:>8.1f} nodes/s {:>8.2f} MB/s\n", n / scalarTime, mb / scalarTime);
+	fmt::print(" - simd  : {:>8.1f} nodes/s {:>8.2f} MB/s (x{:.2f})\n", n / simdTime, mb / simdTime, scalarTime / simdTime);
+
+	return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,418 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+//
+// Minimal crunch (.crn, v1.04 chunk format) transcoder.
+// Only supports DXT1, which is the only crunched format the rocktree servers hand out (`CRN_DXT1`).
+//
+// The rocktree textures are ~256x256 and I only ever want the first level, so this is kept as small as possible:
+// no mips/faces other than the first, no alpha palettes, no ETC.
+// It follows the structure of `crn_decomp.h` closely (header layout, the static huffman model transmission,
+// the palette deltas and the 2x2 block "chunk" walk), just without all of the allocator / platform scaffolding.
+//
+// The output is the raw DXT1 (BC1) block stream: 8 bytes per 4x4 block, rows of blocks top to bottom.
+// That can be uploaded directly to a `WGPUTextureFormat_BC1RGBAUnorm` texture.
+//
+// If the device does not support BC textures, `decode_dxt1_to_rgba` is used instead.
+//
+
+namespace wg {
+namespace gearth {
+	namespace {
+
+	namespace crn {
+
+		// All multi-byte fields in the header are big endian.
+		inline uint32_t readBe(const uint8_t* p, int n) {
+			uint32_t v = 0;
+			for (int i=0; i<n; i++) v = (v << 8) | p[i];
+			return v;
+		}
+
+		struct Header {
+			uint32_t headerSize, dataSize;
+			uint32_t width, height, levels, faces, format;
+
+			struct Palette {
+				uint32_t ofs, size, num;
+			};
+			Palette colorEndpoints, colorSelectors, alphaEndpoints, alphaSelectors;
+
+			uint32_t tablesSize, tablesOfs;
+			uint32_t level0Ofs;
+		};
+
+		constexpr uint32_t kSig       = ('H' << 8) | 'x';
+		constexpr uint32_t kFormatDxt1 = 0;
+		constexpr uint32_t kMinHeaderSize = 74;
+
+		inline bool parseHeader(Header& h, const uint8_t* p, size_t len) {
+			if (len < kMinHeaderSize) return false;
+			if (readBe(p+0, 2) != kSig) return false;
+
+			h.headerSize = readBe(p+2, 2);
+			h.dataSize   = readBe(p+6, 4);
+			h.width      = readBe(p+12, 2);
+			h.height     = readBe(p+14, 2);
+			h.levels     = readBe(p+16, 1);
+			h.faces      = readBe(p+17, 1);
+			h.format     = readBe(p+18, 1);
+
+			auto readPalette = [p](Header::Palette& pal, int ofs) {
+				pal.ofs  = readBe(p+ofs+0, 3);
+				pal.size = readBe(p+ofs+3, 3);
+				pal.num  = readBe(p+ofs+6, 2);
+			};
+			readPalette(h.colorEndpoints, 33);
+			readPalette(h.colorSelectors, 41);
+			readPalette(h.alphaEndpoints, 49);
+			readPalette(h.alphaSelectors, 57);
+
+			h.tablesSize = readBe(p+65, 2);
+			h.tablesOfs  = readBe(p+67, 3);
+			h.level0Ofs  = readBe(p+70, 4);
+
+			if (h.dataSize > len or h.headerSize > h.dataSize) return false;
+			if (h.levels < 1 or h.faces < 1 or h.width == 0 or h.height == 0) return false;
+			return true;
+		}
+
+		//
+		// Canonical huffman model, as sent by `symbol_codec::decode_receive_static_data_model`.
+		// Code lengths are at most 16 bits.
+		//
+		struct HuffmanModel {
+			static constexpr int kMaxCodeSize = 16;
+
+			std::vector<uint8_t> codeSizes;
+			std::vector<uint16_t> sortedSymbols;
+			uint32_t limit[kMaxCodeSize+1];  // left-justified (16 bit) exclusive upper bound of codes of each length
+			uint32_t first[kMaxCodeSize+1];  // first canonical code of each length
+			uint32_t offset[kMaxCodeSize+1]; // index into `sortedSymbols` of first symbol of each length
+
+			inline bool prepare() {
+				uint32_t counts[kMaxCodeSize+1] = {0};
+				for (auto s : codeSizes) {
+					if (s > kMaxCodeSize) return false;
+					counts[s]++;
+				}
+				counts[0] = 0;
+
+				uint32_t code = 0, n = 0;
+				for (int len=1; len<=kMaxCodeSize; len++) {
+					first[len]  = code;
+					offset[len] = n;
+					code += counts[len];
+					n    += counts[len];
+					limit[len] = code << (kMaxCodeSize - len);
+					code <<= 1;
+				}
+
+				sortedSymbols.resize(n);
+				uint32_t cur[kMaxCodeSize+1];
+				memcpy(cur, offset, sizeof(cur));
+				for (uint32_t sym=0; sym<codeSizes.size(); sym++)
+					if (codeSizes[sym]) sortedSymbols[cur[codeSizes[sym]]++] = sym;
+				return n > 0;
+			}
+		};
+
+		// MSB-first bit reader. Reading past the end yields zeros, same as crnd.
+		struct BitReader {
+			const uint8_t* cur = nullptr;
+			const uint8_t* end = nullptr;
+			uint64_t buf = 0;
+			int nbits    = 0;
+			int padBytes = 0;
+			bool bad     = false;
+
+			inline BitReader(const uint8_t* p, size_t len) : cur(p), end(p+len) {}
+
+			inline void fill(int n) {
+				while (nbits < n) {
+					uint64_t c = 0;
+					if (cur != end) c = *cur++;
+					else padBytes++;
+					buf |= c << (56 - nbits);
+					nbits += 8;
+				}
+			}
+
+			// True if any of the zero padding past the end was actually consumed, or an invalid code was seen.
+			inline bool overran() const {
+				return bad or padBytes * 8 > nbits;
+			}
+
+			inline uint32_t getBits(int n) {
+				if (n == 0) return 0;
+				fill(n);
+				uint32_t out = static_cast<uint32_t>(buf >> (64 - n));
+				buf <<= n;
+				nbits -= n;
+				return out;
+			}
+
+			inline uint32_t decode(const HuffmanModel& m) {
+				fill(HuffmanModel::kMaxCodeSize);
+				uint32_t peek = static_cast<uint32_t>(buf >> (64 - HuffmanModel::kMaxCodeSize));
+				for (int len=1; len<=HuffmanModel::kMaxCodeSize; len++) {
+					if (peek < m.limit[len]) {
+						uint32_t code = peek >> (HuffmanModel::kMaxCodeSize - len);
+						buf <<= len;
+						nbits -= len;
+						uint32_t i = m.offset[len] + code - m.first[len];
+						return i < m.sortedSymbols.size() ? m.sortedSymbols[i] : 0;
+					}
+				}
+				bad = true;
+				return 0;
+			}
+
+			inline bool receiveModel(HuffmanModel& model) {
+				constexpr uint8_t mostProbableCodeLengthCodes[21] = { 17, 18, 19, 20, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15, 16 };
+
+				uint32_t totalUsedSyms = getBits(14);
+				model.codeSizes.assign(totalUsedSyms, 0);
+				if (totalUsedSyms == 0) return true;
+
+				uint32_t numCodeLengthCodes = getBits(5);
+				if (numCodeLengthCodes < 1 or numCodeLengthCodes > 21) return false;
+
+				HuffmanModel dm;
+				dm.codeSizes.assign(21, 0);
+				for (uint32_t i=0; i<numCodeLengthCodes; i++) dm.codeSizes[mostProbableCodeLengthCodes[i]] = getBits(3);
+				if (!dm.prepare()) return false;
+
+				uint32_t ofs = 0;
+				while (ofs < totalUsedSyms) {
+					uint32_t remaining = totalUsedSyms - ofs;
+					uint32_t code = decode(dm);
+					if (code <= 16) {
+						model.codeSizes[ofs++] = code;
+					} else if (code == 17 or code == 18) {
+						uint32_t len = code == 17 ? getBits(3) + 3 : getBits(7) + 11;
+						if (len > remaining) return false;
+						ofs += len;
+					} else if (code == 19 or code == 20) {
+						uint32_t len = code == 19 ? getBits(2) + 3 : getBits(6) + 7;
+						if (ofs == 0 or len > remaining) return false;
+						uint8_t prev = model.codeSizes[ofs-1];
+						if (prev == 0) return false;
+						for (uint32_t i=0; i<len; i++) model.codeSizes[ofs++] = prev;
+					} else {
+						return false;
+					}
+				}
+
+				return model.prepare() and not overran();
+			}
+		};
+
+		struct ChunkTiles {
+			uint8_t n;
+			uint8_t tiles[4];
+		};
+		constexpr ChunkTiles chunkEncodingTiles[8] = {
+			{1, {0,0,0,0}},
+			{2, {0,0,1,1}},
+			{2, {0,1,0,1}},
+			{3, {0,0,1,2}},
+			{3, {1,2,0,0}},
+			{3, {0,1,0,2}},
+			{3, {1,0,2,0}},
+			{4, {0,1,2,3}},
+		};
+
+	}
+
+	//
+	// Transcode the first level of a CRN file to raw DXT1 blocks.
+	// Returns false on any failure (unsupported format, corrupt data...), in which case `out` is unspecified.
+	//
+	inline bool transcode_crn_to_dxt1(const uint8_t* data, size_t len, std::vector<uint8_t>& out, uint32_t& w, uint32_t& h) {
+		using namespace crn;
+
+		Header hdr;
+		if (!parseHeader(hdr, data, len)) return false;
+		if (hdr.format != kFormatDxt1) return false;
+		if (hdr.colorEndpoints.num == 0 or hdr.colorSelectors.num == 0) return false;
+
+		auto inBounds = [&](uint32_t ofs, uint32_t size) { return ofs + size <= hdr.dataSize; };
+		if (!inBounds(hdr.tablesOfs, hdr.tablesSize) or !inBounds(hdr.colorEndpoints.ofs, hdr.colorEndpoints.size)
+			or !inBounds(hdr.colorSelectors.ofs, hdr.colorSelectors.size))
+			return false;
+
+		// Tables.
+		HuffmanModel chunkEncodingDm, endpointDeltaDm, selectorDeltaDm;
+		{
+			BitReader br(data + hdr.tablesOfs, hdr.tablesSize);
+			if (!br.receiveModel(chunkEncodingDm)) return false;
+			if (!br.receiveModel(endpointDeltaDm)) return false;
+			if (!br.receiveModel(selectorDeltaDm)) return false;
+		}
+
+		// Endpoint palette: two 565 colors per entry, delta coded per channel.
+		std::vector<uint32_t> endpoints(hdr.colorEndpoints.num);
+		{
+			BitReader br(data + hdr.colorEndpoints.ofs, hdr.colorEndpoints.size);
+			HuffmanModel dm[2];
+			if (!br.receiveModel(dm[0]) or !br.receiveModel(dm[1])) return false;
+
+			uint32_t a=0,b=0,c=0, d=0,e=0,f=0;
+			for (auto& ep : endpoints) {
+				a = (a + br.decode(dm[0])) & 31;
+				b = (b + br.decode(dm[1])) & 63;
+				c = (c + br.decode(dm[0])) & 31;
+				d = (d + br.decode(dm[0])) & 31;
+				e = (e + br.decode(dm[1])) & 63;
+				f = (f + br.decode(dm[0])) & 31;
+				ep = c | (b << 5) | (a << 11) | (f << 16) | (e << 21) | (d << 27);
+			}
+			if (br.overran()) return false;
+		}
+
+		// Selector palette: 16 2-bit selectors per entry, coded as pairs of deltas in "linear" order.
+		std::vector<uint32_t> selectors(hdr.colorSelectors.num);
+		{
+			BitReader br(data + hdr.colorSelectors.ofs, hdr.colorSelectors.size);
+			HuffmanModel dm;
+			if (!br.receiveModel(dm)) return false;
+
+			constexpr uint32_t dxt1FromLinear[4] = { 0, 2, 3, 1 };
+			uint32_t cur[16] = {0};
+			for (auto& sel : selectors) {
+				for (int j=0; j<8; j++) {
+					int sym = br.decode(dm);
+					cur[j*2+0] = (cur[j*2+0] + (sym % 7) - 3) & 3;
+					cur[j*2+1] = (cur[j*2+1] + (sym / 7) - 3) & 3;
+				}
+				sel = 0;
+				for (int j=0; j<16; j++) sel |= dxt1FromLinear[cur[j]] << (j*2);
+			}
+			if (br.overran()) return false;
+		}
+
+		// Level 0.
+		uint32_t levelEnd = hdr.dataSize;
+		if (hdr.levels > 1) {
+			if (len < kMinHeaderSize + 4) return false;
+			levelEnd = readBe(data + 70 + 4, 4);
+		}
+		if (hdr.level0Ofs >= levelEnd or levelEnd > hdr.dataSize) return false;
+
+		w = hdr.width;
+		h = hdr.height;
+		const uint32_t blocksX = std::max(1u, (w + 3) / 4);
+		const uint32_t blocksY = std::max(1u, (h + 3) / 4);
+		const uint32_t chunksX = (blocksX + 1) / 2;
+		const uint32_t chunksY = (blocksY + 1) / 2;
+		const uint32_t rowPitch = blocksX * 8;
+		out.resize(rowPitch * blocksY);
+
+		BitReader br(data + hdr.level0Ofs, levelEnd - hdr.level0Ofs);
+
+		const uint32_t numEndpoints = endpoints.size();
+		const uint32_t numSelectors = selectors.size();
+		uint32_t chunkEncodingBits = 1;
+		uint32_t prevEndpoint = 0, prevSelector = 0;
+
+		for (uint32_t cy=0; cy<chunksY; cy++) {
+			// Chunks are visited in a serpentine order.
+			const bool reverse    = cy & 1;
+			const bool skipBottom = (cy == chunksY - 1) and (blocksY & 1);
+
+			for (uint32_t i=0; i<chunksX; i++) {
+				uint32_t cx = reverse ? chunksX - 1 - i : i;
+
+				if (chunkEncodingBits == 1) chunkEncodingBits = br.decode(chunkEncodingDm) | 512;
+				const ChunkTiles& ct = chunkEncodingTiles[chunkEncodingBits & 7];
+				chunkEncodingBits >>= 3;
+
+				uint32_t colorEndpoints[4];
+				for (uint32_t t=0; t<ct.n; t++) {
+					prevEndpoint += br.decode(endpointDeltaDm);
+					if (prevEndpoint >= numEndpoints) prevEndpoint -= numEndpoints;
+					// A delta is below the palette size, so one wrap is enough, unless the data is corrupt.
+					if (prevEndpoint >= numEndpoints) return false;
+					colorEndpoints[t] = endpoints[prevEndpoint];
+				}
+
+				const bool skipRight = (cx == chunksX - 1) and (blocksX & 1);
+
+				for (uint32_t by=0; by<2; by++) {
+					for (uint32_t bx=0; bx<2; bx++) {
+						prevSelector += br.decode(selectorDeltaDm);
+						if (prevSelector >= numSelectors) prevSelector -= numSelectors;
+						if (prevSelector >= numSelectors) return false;
+
+						if ((bx and skipRight) or (by and skipBottom)) continue;
+
+						uint32_t* block = reinterpret_cast<uint32_t*>(out.data() + (cy*2+by) * rowPitch + (cx*2+bx) * 8);
+						block[0] = colorEndpoints[ct.tiles[by*2+bx]];
+						block[1] = selectors[prevSelector];
+					}
+				}
+			}
+		}
+
+		// The bit reader over-reading by a few bytes at the very end is fine (it pads with zeros), an invalid code is not.
+		return not br.bad;
+	}
+
+	//
+	// CPU fallback for devices without BC support. Writes w*h*4 RGBA bytes.
+	//
+	inline void decode_dxt1_to_rgba(const uint8_t* blocks, uint32_t w, uint32_t h, uint8_t* rgba) {
+		const uint32_t blocksX = std::max(1u, (w + 3) / 4);
+		const uint32_t blocksY = std::max(1u, (h + 3) / 4);
+
+		auto expand565 = [](uint16_t c, uint8_t* o) {
+			uint32_t r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+			o[0] = (r << 3) | (r >> 2);
+			o[1] = (g << 2) | (g >> 4);
+			o[2] = (b << 3) | (b >> 2);
+			o[3] = 255;
+		};
+
+		for (uint32_t by=0; by<blocksY; by++) {
+			for (uint32_t bx=0; bx<blocksX; bx++) {
+				const uint8_t* blk = blocks + (by*blocksX + bx) * 8;
+				uint16_t c0 = blk[0] | (blk[1] << 8);
+				uint16_t c1 = blk[2] | (blk[3] << 8);
+				uint32_t sel = blk[4] | (blk[5] << 8) | (blk[6] << 16) | ((uint32_t)blk[7] << 24);
+
+				uint8_t pal[4][4];
+				expand565(c0, pal[0]);
+				expand565(c1, pal[1]);
+				for (int i=0; i<3; i++) {
+					if (c0 > c1) {
+						pal[2][i] = (2*pal[0][i] + pal[1][i]) / 3;
+						pal[3][i] = (pal[0][i] + 2*pal[1][i]) / 3;
+					} else {
+						pal[2][i] = (pal[0][i] + pal[1][i]) / 2;
+						pal[3][i] = 0;
+					}
+				}
+				pal[2][3] = 255;
+				pal[3][3] = c0 > c1 ? 255 : 0;
+
+				for (uint32_t y=0; y<4; y++) {
+					uint32_t yy = by*4 + y;
+					if (yy >= h) break;
+					for (uint32_t x=0; x<4; x++) {
+						uint32_t xx = bx*4 + x;
+						if (xx >= w) break;
+						memcpy(rgba + (yy*w + xx) * 4, pal[(sel >> ((y*4+x)*2)) & 3], 4);
+					}
+				}
+			}
+		}
+	}
+
+	}
+}
+}
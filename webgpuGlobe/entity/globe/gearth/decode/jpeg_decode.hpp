@@ -0,0 +1,102 @@
+#pragma once
+
+#include <csetjmp>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <vector>
+
+#include <jpeglib.h>
+#include <opencv2/imgproc.hpp>
+
+#include "rt_decode.h"
+
+//
+// JPEG decoding with libjpeg-turbo, straight to the texture bucket size.
+//
+// `cv::imdecode` always decodes at full size, and then the result has to be resized and swizzled to RGBA.
+// libjpeg-turbo can instead scale by 1/2, 1/4 or 1/8 inside the IDCT (much cheaper than decoding everything and then
+// throwing most of it away), and can output RGBA itself. So: pick the smallest such scale that is still at least the bucket size,
+// decode with it, and only `cv::resize` for what is left over (nothing, in the usual power-of-two case).
+//
+
+namespace wg {
+namespace gearth {
+	namespace {
+
+	// libjpeg's default `error_exit` calls `exit()`.
+	struct RtJpegError {
+		jpeg_error_mgr pub;
+		jmp_buf jump;
+	};
+	inline void rt_jpeg_error_exit(j_common_ptr cinfo) {
+		longjmp(((RtJpegError*)cinfo->err)->jump, 1);
+	}
+	// Warnings (e.g. "premature end of data") are printed to stderr by default, they are not worth it.
+	inline void rt_jpeg_emit_message(j_common_ptr, int) {}
+
+	// Decodes to `edge` x `edge` RGBA8 in `out`, where `edge` is the bucket for the JPEG's size, at most `maxEdge`.
+	// Returns true on error (corrupt data, or a color space libjpeg-turbo can not convert to RGBA, like CMYK).
+	inline bool decodeJpegToRgba(const uint8_t* data, size_t len, uint32_t maxEdge, std::vector<uint8_t>& out, uint32_t& edge) {
+		jpeg_decompress_struct cinfo;
+		RtJpegError err;
+		cinfo.err              = jpeg_std_error(&err.pub);
+		err.pub.error_exit     = rt_jpeg_error_exit;
+		err.pub.emit_message   = rt_jpeg_emit_message;
+
+		// Must be volatile: it is changed after the setjmp and read after a longjmp.
+		// (And it is malloc'ed rather than a std::vector, since nothing here may need a destructor run.)
+		uint8_t* volatile scaled = nullptr;
+
+		if (setjmp(err.jump)) {
+			jpeg_destroy_decompress(&cinfo);
+			free(scaled);
+			return true;
+		}
+
+		jpeg_create_decompress(&cinfo);
+		jpeg_mem_src(&cinfo, data, len);
+		jpeg_read_header(&cinfo, TRUE);
+
+		edge = textureBucketSize(cinfo.image_width, cinfo.image_height, maxEdge);
+
+		cinfo.scale_num   = 1;
+		cinfo.scale_denom = 1;
+		for (uint32_t d = 8; d > 1; d /= 2) {
+			if ((cinfo.image_width + d - 1) / d >= edge and (cinfo.image_height + d - 1) / d >= edge) {
+				cinfo.scale_denom = d;
+				break;
+			}
+		}
+		cinfo.out_color_space = JCS_EXT_RGBA;
+		jpeg_start_decompress(&cinfo);
+
+		const uint32_t w = cinfo.output_width, h = cinfo.output_height;
+		const bool direct = w == edge and h == edge;
+
+		out.resize(edge * edge * 4);
+		if (not direct) scaled = (uint8_t*)malloc(w * h * 4);
+		uint8_t* dst = direct ? out.data() : scaled;
+
+		while (cinfo.output_scanline < h) {
+			JSAMPROW row = dst + cinfo.output_scanline * w * 4;
+			jpeg_read_scanlines(&cinfo, &row, 1);
+		}
+
+		jpeg_finish_decompress(&cinfo);
+		jpeg_destroy_decompress(&cinfo);
+
+		if (not direct) {
+			bool shrink = w > edge or h > edge;
+			cv::Mat src(h, w, CV_8UC4, scaled);
+			cv::Mat dstMat(edge, edge, CV_8UC4, out.data());
+			cv::resize(src, dstMat, dstMat.size(), 0, 0, shrink ? cv::INTER_AREA : cv::INTER_LINEAR);
+			free(scaled);
+		}
+
+		return false;
+	}
+
+	}
+}
+}
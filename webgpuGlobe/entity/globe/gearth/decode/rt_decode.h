@@ -5,6 +5,8 @@
 namespace wg {
 namespace gearth {
 
+	// This is also the GPU vertex format: the vertex shader applies `modelMat` and the mesh's uv offset/scale.
+	// `w` holds the octant (0-7) of the vertex, `extra` is unused.
 	struct __attribute__((packed)) RtPackedVertex {
 		uint8_t x,y,z,w;
 		uint16_t u,v;
@@ -13,22 +15,42 @@ namespace gearth {
 	};
 	static_assert(sizeof(RtPackedVertex) == 12);
 
-	struct __attribute__((packed)) RtUnpackedVertex {
-		float x,y,z,w;
-		float u,v;
-		float nx,ny,nz,extra;
-	};
-	static_assert(sizeof(RtUnpackedVertex) == 10*4);
+	// How `MeshData::img_buffer_cpu` is laid out.
+	//     Rgba8: texSize[0] * texSize[1] * 4 bytes.
+	//     Dxt1 : raw BC1 blocks, 8 bytes per 4x4 block (texSize[2] is 0).
+	enum class RtTextureFormat : uint8_t { Rgba8, Dxt1 };
+
+	// Textures are stored in square, power-of-two texture arrays ("buckets"), see `gpu/resources.h`.
+	// A texture goes into the smallest bucket that fits it (and is resized up to it, if it is not already that size).
+	// Anything larger than the largest bucket is downsampled to it.
+	constexpr uint32_t kTextureBucketSizes[] = { 128, 256, 512, 1024 };
+	constexpr int kNumTextureBuckets = sizeof(kTextureBucketSizes) / sizeof(kTextureBucketSizes[0]);
+
+	inline uint32_t textureBucketSize(uint32_t w, uint32_t h) {
+		uint32_t edge = w > h ? w : h;
+		for (auto size : kTextureBucketSizes)
+			if (edge <= size) return size;
+		return kTextureBucketSizes[kNumTextureBuckets - 1];
+	}
+
+	// Same, but no larger than the largest bucket that is <= `maxEdge` (and no smaller than the smallest bucket).
+	inline uint32_t textureBucketSize(uint32_t w, uint32_t h, uint32_t maxEdge) {
+		uint32_t cap = kTextureBucketSizes[0];
+		for (auto size : kTextureBucketSizes)
+			if (size <= maxEdge) cap = size;
+		uint32_t bucket = textureBucketSize(w, h);
+		return bucket < cap ? bucket : cap;
+	}
 
 	struct DecodedCpuTileData {
 		alignas(16) double modelMat[16];
 		struct MeshData {
-			// std::vector<RtPackedVertex> vert_buffer_cpu;
-			std::vector<RtUnpackedVertex> vert_buffer_cpu;
+			std::vector<RtPackedVertex> vert_buffer_cpu;
 			std::vector<uint16_t> ind_buffer_cpu;
 			std::vector<uint8_t> img_buffer_cpu;
 			std::vector<uint8_t> tmp_buffer;
 			uint32_t texSize[3];
+			RtTextureFormat texFormat = RtTextureFormat::Rgba8;
 			float uvOffset[2];
 			float uvScale[2];
 			int layerBounds[10];
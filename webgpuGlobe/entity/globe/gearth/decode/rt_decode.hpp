@@ -7,9 +7,10 @@
 
 #include "rt_convert.hpp"
 #include "rt_decode.h"
-#include "rocktree.pb.h"
-
-namespace rtpb = ::geo_globetrotter_proto_rocktree;
+#include "crn_decode.hpp"
+#include "rt_view.hpp"
+#include "rt_simd.hpp"
+#include "jpeg_decode.hpp"
 
 namespace wg {
 namespace gearth {
@@ -36,7 +37,7 @@ inline int unpackVarInt(uint8_t*& b) {
 }
 
 // Almost directly from the 'client' code in the gearth repo
-int unpackNormalsStepOne(const rtpb::NodeData& nodeData, std::vector<uint8_t>& partialNormals) {
+int unpackNormalsStepOne(const RtNodeView& nodeData, std::vector<uint8_t>& partialNormals) {
 	auto f1 = [](int v, int l) {
 		if (4 >= l)
 			return (v << l) + (v & (1 << l) - 1);
@@ -105,7 +106,7 @@ int unpackNormalsStepOne(const rtpb::NodeData& nodeData, std::vector<uint8_t>& p
 	}
 	return 3*count;
 }
-int unpackNormalsStepTwo(const rtpb::Mesh& mesh, std::vector<RtPackedVertex>& verts, const std::vector<uint8_t>& partialNormals) {
+int unpackNormalsStepTwo(const RtMeshView& mesh, std::vector<RtPackedVertex>& verts, const std::vector<uint8_t>& partialNormals) {
 	auto normals = mesh.normals();
 	uint8_t *new_normals = NULL;
 	int count = 0;
@@ -132,7 +133,7 @@ int unpackNormalsStepTwo(const rtpb::Mesh& mesh, std::vector<RtPackedVertex>& ve
 	return 4 * count;
 }
 
-void computeNormals(const rtpb::Mesh& mesh, std::vector<RtPackedVertex>& vs) {
+void computeNormals(const RtMeshView& mesh, std::vector<RtPackedVertex>& vs) {
 	std::vector<Vector3f> nacc(vs.size());
 
 	for (int i=0; i<vs.size(); i++) {
@@ -142,19 +143,135 @@ void computeNormals(const rtpb::Mesh& mesh, std::vector<RtPackedVertex>& vs) {
 }
 
 
+// Returns true on error, like `decode_node_to_tile`.
+inline bool decodeTextureJpg(const RtTextureView& tex, DecodedCpuTileData::MeshData& md, uint32_t maxTexEdge) {
+	int dc = 4;
+	md.texSize[0] = tex.height();
+	md.texSize[1] = tex.width();
+	md.texSize[2] = dc;
+	// if (md.texSize[0] > RtCfg::maxTextureEdge) printf(" - texture had larger size then allowed : %u / %u\n", (uint32_t)md.texSize[0], (uint32_t)RtCfg::maxTextureEdge);
+	// if (md.texSize[1] > RtCfg::maxTextureEdge) printf(" - texture had larger size then allowed : %u / %u\n", (uint32_t)md.texSize[1], (uint32_t)RtCfg::maxTextureEdge);
+
+	// Fast path: libjpeg-turbo decodes (DCT scaled, if the texture is larger than its bucket) straight to RGBA in `img_buffer_cpu`.
+	uint32_t edge = 0;
+	if (not decodeJpegToRgba((const uint8_t*)tex.data(0).data(), tex.data(0).size(), maxTexEdge, md.img_buffer_cpu, edge)) {
+		md.texSize[0] = edge;
+		md.texSize[1] = edge;
+		return false;
+	}
+
+	// Otherwise go through OpenCV, which handles a few more exotic JPEGs.
+	cv::Mat tmpMat = cv::imdecode(cv::InputArray{tex.data(0).data(), tex.data(0).size()}, cv::IMREAD_UNCHANGED);
+
+	// Most textures already are one of the bucket sizes and are not touched.
+	// Others are resized up to the bucket that fits them (or down to the largest bucket).
+	uint32_t bucket = tmpMat.empty() ? textureBucketSize(tex.width(), tex.height(), maxTexEdge) : textureBucketSize(tmpMat.cols, tmpMat.rows, maxTexEdge);
+	if (not tmpMat.empty() and (tmpMat.cols != bucket or tmpMat.rows != bucket)) {
+		bool shrink = tmpMat.cols > bucket or tmpMat.rows > bucket;
+		cv::resize(tmpMat, tmpMat, cv::Size(bucket, bucket), 0, 0, shrink ? cv::INTER_AREA : cv::INTER_LINEAR);
+	}
+	md.texSize[0] = bucket;
+	md.texSize[1] = bucket;
+
+	md.img_buffer_cpu.resize(md.texSize[0]*md.texSize[1]*md.texSize[2], 255);
+
+	// STBIDEF stbi_uc *stbi_load_from_memory   (stbi_uc           const *buffer, int len   , int *x, int *y, int *channels_in_file, int desired_channels);
+	int w,h,c;
+	w = tmpMat.cols;
+	h = tmpMat.rows;
+	c = tmpMat.channels();
+	// uint8_t* tmp = stbi_load_from_memory((const uint8_t*)tex.data(0).data(), tex.data(0).length(), &w,&h,&c, 3);
+	// uint8_t* tmp = stbi_load_from_memory((const uint8_t*)tex.data(0).data(), tex.data(0).length(), &w,&h,&c, dc);
+	if (tmpMat.empty()) {
+		fmt::print(" [decode] Warning: failed to decode jpeg of size {} {} {}!\n", md.texSize[0],md.texSize[1],md.texSize[2]);
+	} else {
+		// memcpy(md.img_buffer_cpu.data(), tmp, w*h*dc);
+		if (c == 3 and tmpMat.isContinuous()) {
+			rt_bgr_to_rgba(tmpMat.data, w*h, md.img_buffer_cpu.data());
+		} else {
+			for (int y=0; y<h; y++) for (int x=0; x<w; x++) for (int i=0; i<c; i++)
+				md.img_buffer_cpu[y*w*4+x*4+i] = tmpMat.data[y*w*c+x*c+(2-i)];
+		}
+
+		// if (w!=tex.width() or h!=tex.height()) { fmt::print(" [decode] Warning: decoded size did not match pb size: {} {} vs {} {}\n", md.texSize[0], md.texSize[1], h,w); }
+	}
+
+	return false;
+}
+
+// Handles both `CRN_DXT1` (transcoded to DXT1 blocks) and raw `DXT1`.
+// If `keepDxt1` the blocks are passed through untouched, otherwise they are decompressed to RGBA8.
+// Returns true on error.
+inline bool decodeTextureDxt1(const RtTextureView& tex, DecodedCpuTileData::MeshData& md, bool keepDxt1, uint32_t maxTexEdge) {
+	std::string_view bytes = tex.data(0);
+	std::vector<uint8_t> blocks;
+	uint32_t w = 0, h = 0;
+
+	if (tex.format() == rtpb::Texture::CRN_DXT1) {
+		if (!transcode_crn_to_dxt1((const uint8_t*)bytes.data(), bytes.size(), blocks, w, h)) {
+			fmt::print(" [decode] Warning: failed to transcode crn texture ({} bytes)!\n", bytes.size());
+			return true;
+		}
+	} else {
+		w = tex.width();
+		h = tex.height();
+		size_t n = ((w + 3) / 4) * ((h + 3) / 4) * 8;
+		if (n == 0 or bytes.size() < n) {
+			fmt::print(" [decode] Warning: dxt1 texture {}x{} had only {} bytes!\n", w, h, bytes.size());
+			return true;
+		}
+		blocks.assign(bytes.begin(), bytes.begin() + n);
+	}
+
+	// DXT1 can only go into a bucket as-is if it is exactly the bucket size.
+	uint32_t bucket = textureBucketSize(w, h, maxTexEdge);
+	if (keepDxt1 and w == bucket and h == bucket) {
+		md.texFormat      = RtTextureFormat::Dxt1;
+		md.texSize[0]     = h;
+		md.texSize[1]     = w;
+		md.texSize[2]     = 0;
+		md.img_buffer_cpu = std::move(blocks);
+		return false;
+	}
+
+	cv::Mat rgba(h, w, CV_8UC4);
+	decode_dxt1_to_rgba(blocks.data(), w, h, rgba.data);
+	if (w != bucket or h != bucket) {
+		bool shrink = w > bucket or h > bucket;
+		cv::resize(rgba, rgba, cv::Size(bucket, bucket), 0, 0, shrink ? cv::INTER_AREA : cv::INTER_LINEAR);
+	}
+
+	md.texFormat  = RtTextureFormat::Rgba8;
+	md.texSize[0] = bucket;
+	md.texSize[1] = bucket;
+	md.texSize[2] = 4;
+	md.img_buffer_cpu.assign(rgba.data, rgba.data + bucket*bucket*4);
+	return false;
+}
+
+
+// If `keepDxt1`, DXT1/CRN_DXT1 textures are preferred and passed through as BC1 blocks (see `RtTextureFormat`).
+// Decoded textures are at most `maxTexEdge` on a side (rounded down to a bucket size), see `textureBucketSize`.
+// `data` is a serialized `NodeData` message, typically an mmapped node file. It is parsed in place (see `RtNodeView`)
+// and need only live for the duration of the call: everything in `dtd` is copied out or decoded.
 inline bool decode_node_to_tile(
-		std::ifstream &ifs,
-		DecodedCpuTileData& dtd, bool forceTriList) {
+		const uint8_t* data, size_t len,
+		DecodedCpuTileData& dtd, bool forceTriList, bool keepDxt1=false,
+		uint32_t maxTexEdge=kTextureBucketSizes[kNumTextureBuckets-1]) {
 
-	rtpb::NodeData nd;
-	if (!nd.ParseFromIstream(&ifs)) {
-		fmt::print(" - [#decode_node_to_tile] ERROR: failed to parse istream!\n");
+	RtNodeView nd;
+	if (nd.parse(data, len)) {
+		fmt::print(" - [#decode_node_to_tile] ERROR: failed to parse node data!\n");
 		return true;
 	}
 
 	std::vector<uint8_t> partialNormals;
 	unpackNormalsStepOne(nd, partialNormals);
 
+	// Scratch for the SIMD kernels, reused across meshes.
+	std::vector<uint8_t> vertScratch;
+	std::vector<uint16_t> uvScratch;
+
 	Matrix4d globeFromMesh1;
 	for (int i=0; i<16; i++) globeFromMesh1(i) = nd.matrix_globe_from_mesh(i);
 	if (0) {
@@ -174,25 +291,15 @@ inline bool decode_node_to_tile(
 		bool bad = false;
 
 		int nv = mesh.vertices().length() / 3;
-		md.vert_buffer_cpu.resize(nv);
 
 		std::vector<RtPackedVertex> packed_verts;
 		packed_verts.resize(nv);
 
 		// Decode verts
-		const std::string& verts = mesh.vertices();
-		uint8_t * v_data = (uint8_t*) verts.data();
-		for (int i=0; i<3; i++) {
-			uint8_t acc = 0;
-			for (int j=0; j<nv; j++) {
-				acc = acc + v_data[i*nv+j];
-				// (&md.vert_buffer_cpu[j].x)[i] = acc;
-				// NOTE TODO XXX SWAP Y Z
-				if (i==0) packed_verts[j].x = acc;
-				if (i==1) packed_verts[j].y = acc;
-				if (i==2) packed_verts[j].z = acc;
-			}
-		}
+		std::string_view verts = mesh.vertices();
+		const uint8_t * v_data = (const uint8_t*) verts.data();
+		// NOTE TODO XXX SWAP Y Z
+		rt_decode_vertices(v_data, nv, packed_verts.data(), vertScratch);
 
 		unpackNormalsStepTwo(mesh, packed_verts, partialNormals);
 		// computeNormals(mesh, packed_verts);
@@ -203,13 +310,7 @@ inline bool decode_node_to_tile(
 		auto v_mod = 1 + *(uint16_t*)(data+2);
 		// fmt::print(" - UV MOD {} {}\n", u_mod, v_mod);
 		data += 4;
-		auto u=0,v=0;
-		for (int i=0; i<nv; i++) {
-			u = (u + data[nv*0 + i] + (data[nv*2 + i] << 8)) % u_mod;
-			v = (v + data[nv*1 + i] + (data[nv*3 + i] << 8)) % v_mod;
-			packed_verts[i].u = u;
-			packed_verts[i].v = v;
-		}
+		rt_decode_uvs(data, nv, u_mod, v_mod, packed_verts.data(), uvScratch);
 
 
 		md.uvOffset[0] = 0.5;
@@ -234,28 +335,27 @@ inline bool decode_node_to_tile(
 
 
 		// Normals
-		auto& ns_bites = mesh.normals();
+		auto ns_bites = mesh.normals();
 		auto &fns = md.tmp_buffer;
 		// TODO
 
 
 		// Inds
-		auto& indices = mesh.indices();
+		auto indices = mesh.indices();
 		uint8_t* ptr = (uint8_t*) indices.data();
 		uint32_t strip_len = unpackVarInt(ptr);
 		md.ind_buffer_cpu.resize(strip_len);
-		int j=0, zeros=0;
-		while (j<strip_len) {
-			int v = unpackVarInt(ptr);
-
-			md.ind_buffer_cpu[j] = (uint16_t)(zeros - v);
-
-			if (md.ind_buffer_cpu[j] >= nv) {
-				fmt::print(" - ind {}/{} was invalid, pointed to vert {} / {}\n",j,strip_len, md.ind_buffer_cpu[j],nv);
-			}
+		{
+			const uint8_t* cptr = ptr;
+			rt_decode_strip(cptr, (const uint8_t*)indices.data() + indices.size(), strip_len, md.ind_buffer_cpu.data());
+		}
 
-			if (v==0) zeros += 1;
-			j += 1;
+		// If every index is in range (the usual case), the octant walk below need not check each one.
+		bool indsValid = strip_len == 0 or rt_max_u16(md.ind_buffer_cpu.data(), strip_len) < nv;
+		if (not indsValid) {
+			for (uint32_t j=0; j<strip_len; j++)
+				if (md.ind_buffer_cpu[j] >= nv)
+					fmt::print(" - ind {}/{} was invalid, pointed to vert {} / {}\n",j,strip_len, md.ind_buffer_cpu[j],nv);
 		}
 
 		// Octant & layer bounds (?)
@@ -300,6 +400,14 @@ inline bool decode_node_to_tile(
 					md.layerBounds[m++] = k;
 				}
 				auto v = unpackVarInt(ptr);
+				if (indsValid and idx_i + v <= strip_len) {
+					const uint16_t* inds = md.ind_buffer_cpu.data() + idx_i;
+					const uint8_t w = i & 7;
+					for (auto j=0; j<v; j++) packed_verts[inds[j]].w = w;
+					idx_i += v;
+					k += v;
+					continue;
+				}
 				for (auto j=0; j<v; j++) {
 					auto idx = md.ind_buffer_cpu[idx_i++];
 					auto vi = idx;
@@ -344,86 +452,39 @@ inline bool decode_node_to_tile(
 					packed_verts[j].z, packed_verts[j].w);
 		}
 
-		// Convert packed to unpacked. Unlike previous OpenGL/vulkan impls for webgpu we render with floating point vertex attribs.
-		for (int j=0; j<nv; j++) {
-
-			if (0) {
-				md.vert_buffer_cpu[j].x = packed_verts[j].x;
-				md.vert_buffer_cpu[j].y = packed_verts[j].y;
-				md.vert_buffer_cpu[j].z = packed_verts[j].z;
-				md.vert_buffer_cpu[j].w = 1.f;
-			} else {
-				Vector4d p {
-					 (double)packed_verts[j].x,
-					 (double)packed_verts[j].y,
-					 (double)packed_verts[j].z,
-					 1.f };
-				Vector3d p1 = (globeFromMesh1 * p).hnormalized() / R1;
-				md.vert_buffer_cpu[j].x = (float)p1[0];
-				md.vert_buffer_cpu[j].y = (float)p1[1];
-				md.vert_buffer_cpu[j].z = (float)p1[2];
-				md.vert_buffer_cpu[j].w = 1.f;
-				// fmt::print("vert: {} {} {} r={:.5f}\n", p1(0), p1(1), p1(2), p1.norm());
-			}
-
-			// fmt::print("vert uv: {} {} from scale {} {} offset {} {}\n", (int)packed_verts[j].u, (int)packed_verts[j].v, md.uvScale[0], md.uvScale[1], md.uvOffset[0], md.uvOffset[1]);
-			// md.vert_buffer_cpu[j].u = packed_verts[j].u * md.uvScale[0] + md.uvOffset[0];
-			// md.vert_buffer_cpu[j].v = packed_verts[j].v * md.uvScale[1] + md.uvOffset[1];
-			md.vert_buffer_cpu[j].u = ((float)packed_verts[j].u + md.uvOffset[0]) * md.uvScale[0];
-			md.vert_buffer_cpu[j].v = ((float)packed_verts[j].v + md.uvOffset[1]) * md.uvScale[1];
-			md.vert_buffer_cpu[j].nx = packed_verts[j].nx;
-			md.vert_buffer_cpu[j].ny = packed_verts[j].ny;
-			md.vert_buffer_cpu[j].nz = packed_verts[j].nz;
-			md.vert_buffer_cpu[j].extra = packed_verts[j].extra;
-		}
+		// The GPU consumes the packed vertices as is. Transforming to globe coordinates and applying the uv offset/scale is done in the vertex shader.
+		md.vert_buffer_cpu = std::move(packed_verts);
 
 
 		// Texture
 		md.texSize[0] = md.texSize[1] = md.texSize[2] = 0;
+		md.texFormat = RtTextureFormat::Rgba8;
 		if (mesh.texture_size() > 0) {
-			auto& tex = mesh.texture(0);
-			if (tex.format() != rtpb::Texture::JPG) {
-				printf(" - texture had non-JPG format, which is not supported.\n");
-				bad |= true;
-			} else {
-				int dc = 4;
-				md.texSize[0] = tex.height();
-				md.texSize[1] = tex.width();
-				md.texSize[2] = dc;
-				// if (md.texSize[0] > RtCfg::maxTextureEdge) printf(" - texture had larger size then allowed : %u / %u\n", (uint32_t)md.texSize[0], (uint32_t)RtCfg::maxTextureEdge);
-				// if (md.texSize[1] > RtCfg::maxTextureEdge) printf(" - texture had larger size then allowed : %u / %u\n", (uint32_t)md.texSize[1], (uint32_t)RtCfg::maxTextureEdge);
-
-
-				cv::Mat tmpMat = cv::imdecode(cv::InputArray{tex.data(0).data(), tex.data(0).size()}, cv::IMREAD_UNCHANGED);
-
-#warning "fix this; don't require downsampling... but its a big issue having to do with using texture arrays..."
-				if (tmpMat.cols != 256 or tmpMat.rows != 256) {
-					cv::resize(tmpMat, tmpMat, cv::Size{256,256});
-					md.texSize[0] = 256;
-					md.texSize[1] = 256;
+			// A mesh can carry the same texture in several formats.
+			// If the GPU can sample BC1 directly, prefer DXT1 (crunched or not): no JPEG decode, no BGR->RGBA swizzle
+			// and an 8x smaller upload. Otherwise prefer JPG, but still accept DXT1 and decompress it on the CPU.
+			int texIndex = -1;
+			for (int ti=0; ti<mesh.texture_size(); ti++) {
+				if (mesh.texture(ti).data_size() == 0) continue;
+				auto fmt = mesh.texture(ti).format();
+				bool isDxt1 = fmt == rtpb::Texture::CRN_DXT1 or fmt == rtpb::Texture::DXT1;
+				bool isJpg  = fmt == rtpb::Texture::JPG;
+				if (not isDxt1 and not isJpg) continue;
+				if (texIndex == -1) texIndex = ti;
+				if ((keepDxt1 and isDxt1) or (not keepDxt1 and isJpg)) {
+					texIndex = ti;
+					break;
 				}
-
-				md.img_buffer_cpu.resize(md.texSize[0]*md.texSize[1]*md.texSize[2], 255);
-
-				// STBIDEF stbi_uc *stbi_load_from_memory   (stbi_uc           const *buffer, int len   , int *x, int *y, int *channels_in_file, int desired_channels);
-				int w,h,c;
-				w = tmpMat.cols;
-				h = tmpMat.rows;
-				c = tmpMat.channels();
-				// uint8_t* tmp = stbi_load_from_memory((const uint8_t*)tex.data(0).data(), tex.data(0).length(), &w,&h,&c, 3);
-				// uint8_t* tmp = stbi_load_from_memory((const uint8_t*)tex.data(0).data(), tex.data(0).length(), &w,&h,&c, dc);
-				if (tmpMat.empty()) {
-					fmt::print(" [decode] Warning: failed to decode jpeg of size {} {} {}!\n", md.texSize[0],md.texSize[1],md.texSize[2]);
-				} else {
-					// memcpy(md.img_buffer_cpu.data(), tmp, w*h*dc);
-					for (int y=0; y<h; y++) for (int x=0; x<w; x++) for (int i=0; i<c; i++)
-						md.img_buffer_cpu[y*w*4+x*4+i] = tmpMat.data[y*w*c+x*c+(2-i)];
-
-					// if (w!=tex.width() or h!=tex.height()) { fmt::print(" [decode] Warning: decoded size did not match pb size: {} {} vs {} {}\n", md.texSize[0], md.texSize[1], h,w); }
-				}
-
 			}
 
+			if (texIndex == -1) {
+				printf(" - texture had unsupported format (%d).\n", (int)mesh.texture(0).format());
+				bad |= true;
+			} else if (mesh.texture(texIndex).format() == rtpb::Texture::JPG) {
+				bad |= decodeTextureJpg(mesh.texture(texIndex), md, maxTexEdge);
+			} else {
+				bad |= decodeTextureDxt1(mesh.texture(texIndex), md, keepDxt1, maxTexEdge);
+			}
 		}
 
 		if (not bad) {
@@ -0,0 +1,255 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#endif
+
+#include "rt_decode.h"
+#include "util/simd.h"
+
+//
+// The hot loops of `decode_node_to_tile`, as SIMD kernels with scalar fallbacks.
+// Every kernel must be bit-exact with its scalar version: `benchDecode` decodes a corpus both ways and compares.
+//
+// Only SSE2 (always there on x86_64) is assumed at compile time.
+// The SSSE3 swizzle is `expand3to4_ssse3` (`util/simd.h`), picked at runtime. `simdEnabled` turns all of them off.
+// On other architectures everything is scalar.
+//
+
+namespace wg {
+namespace gearth {
+	namespace {
+
+	// -----------------------------------------------------------------------------------------------------
+	// Byte-wise prefix sums (vertex delta decoding)
+	// -----------------------------------------------------------------------------------------------------
+
+#if defined(__SSE2__)
+	// Inclusive prefix sum of the 16 bytes of `x`, modulo 256.
+	inline __m128i rt_prefix_sum_u8(__m128i x) {
+		x = _mm_add_epi8(x, _mm_slli_si128(x, 1));
+		x = _mm_add_epi8(x, _mm_slli_si128(x, 2));
+		x = _mm_add_epi8(x, _mm_slli_si128(x, 4));
+		x = _mm_add_epi8(x, _mm_slli_si128(x, 8));
+		return x;
+	}
+
+	// Broadcast byte 15 of `x` to all lanes (SSE2 only, no pshufb).
+	inline __m128i rt_broadcast_last_u8(__m128i x) {
+		x = _mm_unpackhi_epi8(x, x);
+		x = _mm_unpackhi_epi16(x, x);
+		return _mm_shuffle_epi32(x, 0xFF);
+	}
+#endif
+
+	// out[j] = in[0] + ... + in[j], modulo 256.
+	inline void rt_prefix_sum_u8(const uint8_t* in, int n, uint8_t* out) {
+		int j = 0;
+		uint8_t acc = 0;
+#if defined(__SSE2__)
+		if (simdEnabled()) {
+			__m128i carry = _mm_setzero_si128();
+			for (; j + 16 <= n; j += 16) {
+				__m128i x = _mm_loadu_si128((const __m128i*)(in + j));
+				x = _mm_add_epi8(rt_prefix_sum_u8(x), carry);
+				_mm_storeu_si128((__m128i*)(out + j), x);
+				carry = rt_broadcast_last_u8(x);
+			}
+			if (j > 0) acc = out[j - 1];
+		}
+#endif
+		for (; j < n; j++) {
+			acc = acc + in[j];
+			out[j] = acc;
+		}
+	}
+
+	// The three delta coded channels of `vertices` (x's, then y's, then z's) into `verts[j].{x,y,z}`.
+	// `tmp` is scratch space.
+	inline void rt_decode_vertices(const uint8_t* v_data, int nv, RtPackedVertex* verts, std::vector<uint8_t>& tmp) {
+		tmp.resize(3 * nv);
+		for (int i = 0; i < 3; i++) rt_prefix_sum_u8(v_data + i * nv, nv, tmp.data() + i * nv);
+
+		const uint8_t* xs = tmp.data();
+		const uint8_t* ys = xs + nv;
+		const uint8_t* zs = ys + nv;
+		for (int j = 0; j < nv; j++) {
+			verts[j].x = xs[j];
+			verts[j].y = ys[j];
+			verts[j].z = zs[j];
+		}
+	}
+
+	// -----------------------------------------------------------------------------------------------------
+	// UV decoding
+	// -----------------------------------------------------------------------------------------------------
+
+	// For each of u and v: d[i] = lo[i] | hi[i] << 8, then u[i] = (u[i-1] + d[i]) % mod.
+	//
+	// The `%` is the expensive part, and it is in the loop carried dependency.
+	// But (a + d) % m == (a + d % m) % m, and with a < m and d % m < m the outer one is a conditional subtract.
+	// d % m for all i is independent, so that is done up front: with floats it is exact for d, m <= 2^16 after one fixup
+	// (the quotient estimate is off by at most one).
+	inline void rt_reduce_u16_mod(const uint8_t* lo, const uint8_t* hi, int n, uint32_t mod, uint16_t* out) {
+		int i = 0;
+#if defined(__SSE2__)
+		if (simdEnabled()) {
+			const __m128 inv   = _mm_set1_ps(1.f / (float)mod);
+			const __m128i m    = _mm_set1_epi32(mod);
+			const __m128i zero = _mm_setzero_si128();
+			auto reduce4 = [&](__m128i d) {
+				__m128i q = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(d), inv));
+				// d - q*m. SSE2 has no 32-bit mullo, but q*m <= 2^17 so it is exact in floats.
+				__m128i qm = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(q), _mm_cvtepi32_ps(m)));
+				__m128i r  = _mm_sub_epi32(d, qm);
+				r = _mm_add_epi32(r, _mm_and_si128(_mm_cmplt_epi32(r, zero), m));
+				r = _mm_sub_epi32(r, _mm_andnot_si128(_mm_cmplt_epi32(r, m), m));
+				return r;
+			};
+			for (; i + 8 <= n; i += 8) {
+				__m128i l = _mm_loadl_epi64((const __m128i*)(lo + i));
+				__m128i h = _mm_loadl_epi64((const __m128i*)(hi + i));
+				__m128i d16 = _mm_unpacklo_epi8(l, h); // 8 x u16
+				__m128i r0 = reduce4(_mm_unpacklo_epi16(d16, zero));
+				__m128i r1 = reduce4(_mm_unpackhi_epi16(d16, zero));
+				// r0, r1 < 2^16: pack to u16 without saturation by shifting into signed range and back.
+				const __m128i bias32 = _mm_set1_epi32(32768);
+				const __m128i bias16 = _mm_set1_epi16(-32768);
+				__m128i p = _mm_packs_epi32(_mm_sub_epi32(r0, bias32), _mm_sub_epi32(r1, bias32));
+				_mm_storeu_si128((__m128i*)(out + i), _mm_add_epi16(p, bias16));
+			}
+		}
+#endif
+		for (; i < n; i++) out[i] = (uint16_t)((lo[i] | (hi[i] << 8)) % mod);
+	}
+
+	// `data` is the mesh's `texture_coordinates` after the 4 byte header: nv lo-u, nv lo-v, nv hi-u, nv hi-v.
+	inline void rt_decode_uvs(const uint8_t* data, int nv, uint32_t u_mod, uint32_t v_mod, RtPackedVertex* verts, std::vector<uint16_t>& tmp) {
+		tmp.resize(2 * nv);
+		uint16_t* du = tmp.data();
+		uint16_t* dv = du + nv;
+		rt_reduce_u16_mod(data + nv * 0, data + nv * 2, nv, u_mod, du);
+		rt_reduce_u16_mod(data + nv * 1, data + nv * 3, nv, v_mod, dv);
+
+		uint32_t u = 0, v = 0;
+		for (int i = 0; i < nv; i++) {
+			u += du[i];
+			v += dv[i];
+			u = u >= u_mod ? u - u_mod : u;
+			v = v >= v_mod ? v - v_mod : v;
+			verts[i].u = u;
+			verts[i].v = v;
+		}
+	}
+
+	// -----------------------------------------------------------------------------------------------------
+	// Index strip decoding
+	// -----------------------------------------------------------------------------------------------------
+
+	// Same as `unpackVarInt` in rt_decode.hpp
+	inline int rt_varint(const uint8_t*& b) {
+		int c = 0, d = 1;
+		while (1) {
+			uint8_t e = *b++;
+			c += (e & 0x7f) * d;
+			d <<= 7;
+			if ((e & 0x80) == 0) return c;
+		}
+	}
+
+	// The strip is `strip_len` varints v, and out[j] = zeros - v, where `zeros` counts the v == 0 seen before j.
+	// Nearly every varint is a single byte, so 16 at a time are checked for that, and then done branch free:
+	// `zeros` per lane is an exclusive prefix sum of (v == 0).
+	// Advances `ptr` past the strip. The vector loads never read at or past `end` (the scalar tail trusts the data, like before).
+	inline void rt_decode_strip(const uint8_t*& ptr, const uint8_t* end, uint32_t strip_len, uint16_t* out) {
+		uint32_t j = 0;
+		int zeros = 0;
+#if defined(__SSE2__)
+		if (simdEnabled()) {
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i one  = _mm_set1_epi8(1);
+			while (j + 16 <= strip_len and end - ptr >= 16) {
+				__m128i v = _mm_loadu_si128((const __m128i*)ptr);
+				if (_mm_movemask_epi8(v) != 0) {
+					// Some multi-byte varint in the next 16 bytes: do one scalar and try again.
+					int x = rt_varint(ptr);
+					out[j++] = (uint16_t)(zeros - x);
+					if (x == 0) zeros += 1;
+					continue;
+				}
+				__m128i isZero = _mm_and_si128(_mm_cmpeq_epi8(v, zero), one);
+				__m128i incl   = rt_prefix_sum_u8(isZero);
+				__m128i excl   = _mm_sub_epi8(incl, isZero);
+
+				__m128i z = _mm_set1_epi16((int16_t)zeros);
+				__m128i lo = _mm_sub_epi16(_mm_add_epi16(z, _mm_unpacklo_epi8(excl, zero)), _mm_unpacklo_epi8(v, zero));
+				__m128i hi = _mm_sub_epi16(_mm_add_epi16(z, _mm_unpackhi_epi8(excl, zero)), _mm_unpackhi_epi8(v, zero));
+				_mm_storeu_si128((__m128i*)(out + j), lo);
+				_mm_storeu_si128((__m128i*)(out + j + 8), hi);
+
+				zeros += (uint8_t)_mm_cvtsi128_si32(_mm_srli_si128(incl, 15));
+				j += 16;
+				ptr += 16;
+			}
+		}
+#endif
+		for (; j < strip_len; j++) {
+			int x = rt_varint(ptr);
+			out[j] = (uint16_t)(zeros - x);
+			if (x == 0) zeros += 1;
+		}
+	}
+
+	// Largest of `n` uint16s (0 if n is 0).
+	inline uint16_t rt_max_u16(const uint16_t* in, size_t n) {
+		size_t i = 0;
+		uint16_t mx = 0;
+#if defined(__SSE2__)
+		if (simdEnabled() and n >= 8) {
+			// SSE2 only has the signed max, so flip the sign bit on the way in and out.
+			const __m128i flip = _mm_set1_epi16(-32768);
+			__m128i m = flip;
+			for (; i + 8 <= n; i += 8) m = _mm_max_epi16(m, _mm_xor_si128(_mm_loadu_si128((const __m128i*)(in + i)), flip));
+			m = _mm_max_epi16(m, _mm_srli_si128(m, 8));
+			m = _mm_max_epi16(m, _mm_srli_si128(m, 4));
+			m = _mm_max_epi16(m, _mm_srli_si128(m, 2));
+			mx = (uint16_t)(_mm_cvtsi128_si32(m) ^ 0x8000);
+		}
+#endif
+		for (; i < n; i++) mx = in[i] > mx ? in[i] : mx;
+		return mx;
+	}
+
+	// -----------------------------------------------------------------------------------------------------
+	// BGR -> RGBA
+	// -----------------------------------------------------------------------------------------------------
+
+	inline void rt_bgr_to_rgba_scalar(const uint8_t* in, int npix, uint8_t* out) {
+		for (int x = 0; x < npix; x++) {
+			out[x * 4 + 0] = in[x * 3 + 2];
+			out[x * 4 + 1] = in[x * 3 + 1];
+			out[x * 4 + 2] = in[x * 3 + 0];
+			out[x * 4 + 3] = 255;
+		}
+	}
+
+	// `in` is packed BGR, `out` packed RGBA with alpha 255.
+	inline void rt_bgr_to_rgba(const uint8_t* in, int npix, uint8_t* out) {
+		int x = 0;
+#if defined(__SSE2__)
+		if (simdEnabled() and haveSsse3()) {
+			const __m128i shuf = _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1);
+			x = (int)expand3to4_ssse3(in, npix, out, shuf, [](__m128i v) { return v; });
+		}
+#endif
+		rt_bgr_to_rgba_scalar(in + x * 3, npix - x, out + x * 4);
+	}
+
+	}
+}
+}
@@ -0,0 +1,195 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+#include "rocktree.pb.h"
+
+//
+// Zero-copy views of the rocktree `NodeData` message (see `protos/rocktree.proto`).
+//
+// `rtpb::NodeData::ParseFrom*` copies every `bytes` field (vertices, indices, textures, ...) into its own std::string.
+// For a node file that is mmapped anyway that is pure waste, so here is a minimal hand written protobuf wire format parser
+// that only records where those fields are. All `std::string_view`s point into the buffer passed to `parse`,
+// which must outlive the view.
+//
+// The accessors are named like the generated ones, so the decode code reads the same either way.
+// Only the fields that `decode_node_to_tile` needs are kept, everything else is skipped.
+//
+
+namespace rtpb = ::geo_globetrotter_proto_rocktree;
+
+namespace wg {
+namespace gearth {
+	namespace {
+
+	struct RtWireReader {
+		const uint8_t* p;
+		const uint8_t* end;
+		bool bad = false;
+
+		inline RtWireReader(const uint8_t* p, size_t len) : p(p), end(p + len) {}
+		inline RtWireReader(std::string_view s) : p((const uint8_t*)s.data()), end((const uint8_t*)s.data() + s.size()) {}
+
+		inline bool done() const { return bad or p >= end; }
+
+		inline uint64_t varint() {
+			uint64_t v = 0;
+			for (int shift = 0; shift < 64; shift += 7) {
+				if (p >= end) { bad = true; return 0; }
+				uint8_t b = *p++;
+				v |= uint64_t(b & 0x7f) << shift;
+				if ((b & 0x80) == 0) return v;
+			}
+			bad = true;
+			return 0;
+		}
+
+		inline std::string_view bytes() {
+			uint64_t n = varint();
+			if (bad or n > uint64_t(end - p)) { bad = true; return {}; }
+			std::string_view out { (const char*)p, (size_t)n };
+			p += n;
+			return out;
+		}
+
+		template <class T>
+		inline T fixed() {
+			T v;
+			if (size_t(end - p) < sizeof(T)) { bad = true; return T{}; }
+			memcpy(&v, p, sizeof(T));
+			p += sizeof(T);
+			return v;
+		}
+
+		// Returns the field number, and sets `wireType`.
+		inline uint32_t tag(uint32_t& wireType) {
+			uint64_t t = varint();
+			wireType = t & 7;
+			return uint32_t(t >> 3);
+		}
+
+		inline void skip(uint32_t wireType) {
+			switch (wireType) {
+				case 0: varint(); break;
+				case 1: fixed<uint64_t>(); break;
+				case 2: bytes(); break;
+				case 5: fixed<uint32_t>(); break;
+				default: bad = true; // groups are not used by rocktree
+			}
+		}
+
+		// A repeated fixed-width scalar may be encoded packed (wire type 2) or not (wire type 1 or 5).
+		template <class T>
+		inline void repeatedFixed(uint32_t wireType, std::vector<T>& out) {
+			if (wireType == 2) {
+				std::string_view s = bytes();
+				if (bad or s.size() % sizeof(T) != 0) { bad = true; return; }
+				size_t n0 = out.size();
+				out.resize(n0 + s.size() / sizeof(T));
+				memcpy(out.data() + n0, s.data(), s.size());
+			} else if (wireType == (sizeof(T) == 8 ? 1u : 5u)) {
+				out.push_back(fixed<T>());
+			} else {
+				bad = true;
+			}
+		}
+	};
+
+	struct RtTextureView {
+		std::vector<std::string_view> data_;
+		rtpb::Texture::Format format_ = rtpb::Texture::JPG;
+		uint32_t width_ = 256, height_ = 256;
+
+		inline std::string_view data(int i) const { return data_[i]; }
+		inline int data_size() const { return data_.size(); }
+		inline rtpb::Texture::Format format() const { return format_; }
+		inline uint32_t width() const { return width_; }
+		inline uint32_t height() const { return height_; }
+
+		// Returns true on error, like `decode_node_to_tile`.
+		inline bool parse(std::string_view buf) {
+			RtWireReader r { buf };
+			while (not r.done()) {
+				uint32_t wt, field = r.tag(wt);
+				if      (field == 1 and wt == 2) data_.push_back(r.bytes());
+				else if (field == 2 and wt == 0) format_ = (rtpb::Texture::Format) r.varint();
+				else if (field == 3 and wt == 0) width_ = r.varint();
+				else if (field == 4 and wt == 0) height_ = r.varint();
+				else r.skip(wt);
+			}
+			return r.bad;
+		}
+	};
+
+	struct RtMeshView {
+		std::string_view vertices_, texture_coordinates_, indices_, layer_and_octant_counts_, normals_;
+		bool has_normals_ = false;
+		std::vector<float> uv_offset_and_scale_;
+		std::vector<RtTextureView> texture_;
+
+		inline std::string_view vertices() const { return vertices_; }
+		inline std::string_view texture_coordinates() const { return texture_coordinates_; }
+		inline std::string_view indices() const { return indices_; }
+		inline std::string_view layer_and_octant_counts() const { return layer_and_octant_counts_; }
+		inline std::string_view normals() const { return normals_; }
+		inline bool has_normals() const { return has_normals_; }
+		inline int uv_offset_and_scale_size() const { return uv_offset_and_scale_.size(); }
+		inline float uv_offset_and_scale(int i) const { return uv_offset_and_scale_[i]; }
+		inline int texture_size() const { return texture_.size(); }
+		inline const RtTextureView& texture(int i) const { return texture_[i]; }
+
+		inline bool parse(std::string_view buf) {
+			RtWireReader r { buf };
+			while (not r.done()) {
+				uint32_t wt, field = r.tag(wt);
+				if      (field == 1 and wt == 2) vertices_ = r.bytes();
+				else if (field == 3 and wt == 2) indices_ = r.bytes();
+				else if (field == 6 and wt == 2) {
+					texture_.emplace_back();
+					if (texture_.back().parse(r.bytes())) return true;
+				}
+				else if (field == 7 and wt == 2) texture_coordinates_ = r.bytes();
+				else if (field == 8 and wt == 2) layer_and_octant_counts_ = r.bytes();
+				else if (field == 10) r.repeatedFixed<float>(wt, uv_offset_and_scale_);
+				else if (field == 11 and wt == 2) { normals_ = r.bytes(); has_normals_ = true; }
+				else r.skip(wt);
+			}
+			return r.bad;
+		}
+	};
+
+	struct RtNodeView {
+		std::vector<double> matrix_globe_from_mesh_;
+		std::vector<RtMeshView> meshes_;
+		std::string_view for_normals_;
+		bool has_for_normals_ = false;
+
+		inline double matrix_globe_from_mesh(int i) const { return matrix_globe_from_mesh_[i]; }
+		inline int meshes_size() const { return meshes_.size(); }
+		inline const RtMeshView& meshes(int i) const { return meshes_[i]; }
+		inline std::string_view for_normals() const { return for_normals_; }
+		inline bool has_for_normals() const { return has_for_normals_; }
+
+		// Returns true on error.
+		inline bool parse(const uint8_t* data, size_t len) {
+			RtWireReader r { data, len };
+			while (not r.done()) {
+				uint32_t wt, field = r.tag(wt);
+				if      (field == 1) r.repeatedFixed<double>(wt, matrix_globe_from_mesh_);
+				else if (field == 2 and wt == 2) {
+					meshes_.emplace_back();
+					if (meshes_.back().parse(r.bytes())) return true;
+				}
+				else if (field == 8 and wt == 2) { for_normals_ = r.bytes(); has_for_normals_ = true; }
+				else r.skip(wt);
+			}
+			return r.bad or matrix_globe_from_mesh_.size() != 16;
+		}
+	};
+
+	}
+}
+}
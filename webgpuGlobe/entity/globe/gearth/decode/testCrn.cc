@@ -0,0 +1,71 @@
+#include "crn_decode.hpp"
+
+#include <fmt/core.h>
+
+#include <cstdint>
+#include <vector>
+
+//
+// Checks `transcode_crn_to_dxt1` on a small hand made .crn, against BC1 blocks worked out from the format by hand.
+//
+// The file is 12x12, so 3x3 blocks in 2x2 chunks: the chunks on the right and at the bottom are half outside
+// (their blocks are still coded, and must be skipped), and the second row of chunks is walked right to left.
+//     endpoints (565 color0, color1): E0 = (31,0,0) (0,0,31)   E1 = (0,63,0) (31,63,31)   E2 = (1,2,3) (4,5,6)
+//     selectors ("linear" order):     S0 = pixel i is i % 4     S1 = pixel i is 3 - i / 4
+//     chunk (0,0): encoding 7 (one endpoint per block), chunk (1,0): encoding 0,
+//     chunk (1,1): encoding 1 (top / bottom),           chunk (0,1): encoding 2 (left / right)
+//
+
+using namespace wg::gearth;
+
+namespace {
+
+	const uint8_t kCrn[] = {
+		0x48, 0x78, 0x00, 0x4a, 0x00, 0x00, 0x00, 0x00, 0x00, 0xa0, 0x00, 0x00, 0x00, 0x0c, 0x00, 0x0c,
+		0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x69, 0x00, 0x00, 0x1e, 0x00, 0x03, 0x00, 0x00, 0x87, 0x00, 0x00, 0x14, 0x00,
+		0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x1f, 0x00, 0x00, 0x4a, 0x00, 0x00, 0x00, 0x9b, 0x01, 0x22, 0x61, 0x00, 0x80, 0x00,
+		0x00, 0x00, 0x00, 0x20, 0x67, 0x28, 0x00, 0x71, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00,
+		0x29, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x81, 0xe1, 0x00, 0x80, 0x00, 0x00,
+		0x02, 0x51, 0x11, 0x86, 0x20, 0x20, 0x44, 0x20, 0x10, 0x00, 0x00, 0x00, 0x01, 0x20, 0x83, 0x2d,
+		0x68, 0x01, 0x4e, 0x2e, 0x0a, 0x9d, 0x00, 0x00, 0xc5, 0xe9, 0x00, 0x80, 0x00, 0x00, 0x02, 0xc7,
+		0x32, 0x46, 0x8c, 0x11, 0x0d, 0x34, 0xd3, 0x58, 0x50, 0x38, 0x80, 0x8a, 0xab, 0xaa, 0x48, 0x40,
+	};
+
+	// Rows of blocks, top to bottom: { color0, color1 } little endian, then the 16 2-bit DXT1 selectors.
+	#define E0 0x00, 0xf8, 0x1f, 0x00
+	#define E1 0xe0, 0x07, 0xff, 0xff
+	#define E2 0x43, 0x08, 0xa6, 0x20
+	#define S0 0x78, 0x78, 0x78, 0x78 // linear 0,1,2,3 are DXT1 0,2,3,1
+	#define S1 0x55, 0xff, 0xaa, 0x00
+	const uint8_t kExpected[] = {
+		E0, S0,   E1, S1,   E1, S1,
+		E2, S1,   E0, S0,   E1, S0,
+		E2, S0,   E2, S1,   E2, S1,
+	};
+
+	int check(bool ok, const char* what) {
+		fmt::print(" - {}: {}\n", what, ok ? "ok" : "FAILED");
+		return ok ? 0 : 1;
+	}
+
+}
+
+int main() {
+	int failures = 0;
+
+	std::vector<uint8_t> blocks;
+	uint32_t w = 0, h = 0;
+	bool ok = transcode_crn_to_dxt1(kCrn, sizeof(kCrn), blocks, w, h);
+	failures += check(ok and w == 12 and h == 12, "transcodes, 12x12");
+	failures += check(ok and blocks == std::vector<uint8_t>(kExpected, kExpected + sizeof(kExpected)), "blocks match");
+
+	// Anything cut off or corrupt must fail rather than read out of bounds.
+	failures += check(not transcode_crn_to_dxt1(kCrn, sizeof(kCrn) - 1, blocks, w, h), "truncated file fails");
+	std::vector<uint8_t> bad(kCrn, kCrn + sizeof(kCrn));
+	bad[40] = 1; // 1 endpoint in the palette, while the level has endpoint deltas of 2 (but not at the end)
+	failures += check(not transcode_crn_to_dxt1(bad.data(), bad.size(), blocks, w, h), "endpoint index past the palette fails");
+
+	return failures == 0 ? 0 : 1;
+}
@@ -6,6 +6,7 @@
 #include "gearth_dataloader.hpp"
 
 #include "gpu/resources.h"
+#include "entity/globe/sseGovernor.h"
 
 #include "util/gdalDataset.h"
 #include "util/fmtEigen.h"
@@ -15,6 +16,7 @@
 #include <opencv2/core.hpp>
 #include <opencv2/imgproc.hpp>
 
+#include <chrono>
 #include <condition_variable>
 #include <mutex>
 #include <thread>
@@ -187,9 +189,11 @@ namespace gearth {
 		float sse;
 
 		std::vector<GpuTileData> gpuTileDatas;
-		std::vector<ExtraTileData> extraTileDatas;
 
-		const float sseOpenThresh = 4.f;
+		// While `OpeningChildrenAsParent`: the children arrive one by one (see `DiskDataLoader::pushRequests`) and draw as
+		// soon as they do. This tile's meshes then skip the octants they cover (bit i: child i, see `MeshShaderData::octantMask`).
+		int32_t partsArrived = 0;
+		uint32_t coveredMask = 0;
 
         inline void update(const RenderState& rs, GpuResources& res, UpdateState& updateState) {
             // If leaf:
@@ -206,7 +210,7 @@ namespace gearth {
 			if (isSteadyLeaf()) {
 				sse = bb.computeSse(updateState.mvp, updateState.eye, updateState.tanHalfFovTimesHeight);
 
-				if (sse > sseOpenThresh or sse == kBoundingBoxContainsEye) {
+				if (sse > updateState.sseOpenThresh or sse == kBoundingBoxContainsEye) {
 					if (isTerminal()) {
 						logTrace2("cannot open a terminal node");
 						state = TileState::SteadyLeaf;
@@ -220,7 +224,7 @@ namespace gearth {
 								.action = LoadAction::OpenChildren
 								});
 					}
-				} else if ((sse >= 0 and sse < .7f) or sse == kBoundingBoxNotVisible) {
+				} else if ((sse >= 0 and sse < updateState.sseCloseThresh) or sse == kBoundingBoxNotVisible) {
 					if (isRoot()) {
 						logTrace2("cannot close a root");
 						state = TileState::SteadyLeaf;
@@ -247,7 +251,7 @@ namespace gearth {
 					sse = bb.computeSse(updateState.mvp, updateState.eye, updateState.tanHalfFovTimesHeight);
 
 					// WARNING: Why is this necessary? Is there a bug with sse computation?
-					if (sse > sseOpenThresh) {
+					if (sse > updateState.sseOpenThresh) {
 						logDebug("not ClosingToParent {} because parent sse is too high {:>.2f}", coord, sse);
 					} else {
 						logDebug("push CloseToParent request at {} (my sse {:.2f})", coord, sse);
@@ -273,6 +277,7 @@ namespace gearth {
                 assert(state == TileState::OpeningChildrenAsParent);
                 assert(resp.parentCoord == coord);
 				// Allocate children and load the data.
+				// This is one part of `resp.nparts` (usually one child): this tile keeps drawing until the last.
 
 				// int32_t seq;
 				// Tile* src;
@@ -280,18 +285,23 @@ namespace gearth {
 				// LoadAction action;
 				// std::vector<TileData> items;
 				// assert(resp.items.size() == 4);
-                logDebug("recv open {} children data for {}", resp.items.size(), resp.parentCoord);
-				nchildren = resp.items.size();
+                logDebug("recv open {} children data for {} (part {} of {})", resp.items.size(), resp.parentCoord, partsArrived + 1, resp.nparts);
 				for (int i=0; i<resp.items.size(); i++) {
-					assert(children[i] == nullptr);
+					assert(nchildren < 8 and children[nchildren] == nullptr);
 					auto childCoord = resp.items[i].coord;
-					children[i] = new Tile(childCoord, this, TileState::SteadyLeaf, bbMap.map[childCoord]);
-
-					children[i]->loadFrom(resp.items[i], res);
+					Tile* child = children[nchildren++] = new Tile(childCoord, this, TileState::SteadyLeaf, bbMap.map[childCoord]);
+					child->loadFrom(resp.items[i], res);
+					coveredMask |= 1u << (childCoord.s.back() - '0');
 				}
 
-				state = TileState::SteadyInterior;
-				unload(res);
+				if (++partsArrived == resp.nparts) {
+					partsArrived = 0;
+					coveredMask  = 0;
+					state = TileState::SteadyInterior;
+					unload(res);
+				} else {
+					for (auto& gpuTileData : gpuTileDatas) res.writeMeshOctantMask(gpuTileData.meshSlot, coveredMask);
+				}
 
             } else if (resp.action == LoadAction::CloseToParent) {
 
@@ -326,21 +336,56 @@ namespace gearth {
         }
 
 		inline void loadFrom(const TileData& tileData, GpuResources& res) {
-			gpuTileDatas.resize(tileData.dtd.meshes.size());
+			gpuTileDatas.clear();
+			gpuTileDatas.reserve(tileData.dtd.meshes.size());
 
 			for (uint32_t i=0; i<tileData.dtd.meshes.size(); i++) {
-				auto &gpuTileData = gpuTileDatas[i];
 				const auto& mesh = tileData.dtd.meshes[i];
-				createVbo_(gpuTileData.vbo, res.ao, (const uint8_t*)mesh.vert_buffer_cpu.data(), mesh.vert_buffer_cpu.size() * sizeof(RtUnpackedVertex));
+
+				// The loader only produces formats & sizes that have a pool (`GpuResources` checks the bucket layers at startup).
+				// A mesh without a texture still takes a layer.
+				int pool = res.findTexturePool(mesh.texFormat, mesh.texSize[1], mesh.texSize[0]);
+				bool haveTex = pool >= 0;
+				if (not haveTex) pool = 0;
+
+				// If its pool is full, leave the mesh out rather than throw: the tile draws with a hole until it is reloaded.
+				// The governor backs off as the fullest pool fills up (see `render`), so this should only happen in bursts.
+				if (not res.hasRoomFor(pool)) {
+					if (res.droppedMeshes++ % 1000 == 0)
+						spdlog::get("gearthRndr")->warn("texture pool {} ({}px) is full, dropped {} meshes so far", pool, res.texturePools[pool].size, res.droppedMeshes);
+					continue;
+				}
+
+				auto &gpuTileData = gpuTileDatas.emplace_back();
+				createVbo_(gpuTileData.vbo, res.ao, (const uint8_t*)mesh.vert_buffer_cpu.data(), mesh.vert_buffer_cpu.size() * sizeof(RtPackedVertex));
 				createIbo_(gpuTileData.ibo, res.ao, (const uint8_t*)mesh.ind_buffer_cpu.data(), mesh.ind_buffer_cpu.size() * sizeof(uint16_t));
 				gpuTileData.nindex = mesh.ind_buffer_cpu.size();
 
-                uint32_t textureArrayIndex = res.takeTileInd();
+                uint32_t textureArrayIndex = res.takeTileInd(pool);
 				// textureArrayIndex = 0;
+				gpuTileData.texturePool = pool;
 				gpuTileData.textureArrayIndex = textureArrayIndex;
-				assert(textureArrayIndex >= 0 and textureArrayIndex < MAX_TILES);
+				assert(textureArrayIndex >= 0 and textureArrayIndex < res.texturePools[pool].layers);
+
+				// The vertices are still packed, the shader takes them to globe coordinates with this.
+				constexpr double R1 = (6378137.0);
+				MeshShaderData msd;
+				for (int j=0; j<16; j++) msd.model[j] = (float)(j % 4 < 3 ? tileData.dtd.modelMat[j] / R1 : tileData.dtd.modelMat[j]);
+				msd.uvOffsetScale[0] = mesh.uvOffset[0];
+				msd.uvOffsetScale[1] = mesh.uvOffset[1];
+				msd.uvOffsetScale[2] = mesh.uvScale[0];
+				msd.uvOffsetScale[3] = mesh.uvScale[1];
+				msd.texIndex = textureArrayIndex;
+				msd.octantMask = 0;
+				gpuTileData.meshSlot = res.takeMeshSlot();
+				res.writeMeshData(gpuTileData.meshSlot, msd);
                 // logTrace("loadFrom() :: img shape {} {} {} :: vbo size {} ninds {}", tileData.img.rows, tileData.img.cols, tileData.img.channels(), tileData.vertexData.size(), gpuTileData.nindex);
-				uploadTex_(res.sharedTex, res.ao, textureArrayIndex, mesh.img_buffer_cpu.data(), mesh.img_buffer_cpu.size(), mesh.texSize[0], mesh.texSize[1], mesh.texSize[2]);
+				if (not haveTex) continue;
+				auto& tex = res.texturePools[pool].tex;
+				if (mesh.texFormat == RtTextureFormat::Dxt1)
+					uploadTexBlocks_(tex, res.ao, textureArrayIndex, mesh.img_buffer_cpu.data(), mesh.img_buffer_cpu.size(), mesh.texSize[1], mesh.texSize[0], 8);
+				else
+					uploadTex_(tex, res.ao, textureArrayIndex, mesh.img_buffer_cpu.data(), mesh.img_buffer_cpu.size(), mesh.texSize[1], mesh.texSize[0], mesh.texSize[2]);
 			}
 		}
 
@@ -351,8 +396,11 @@ namespace gearth {
 				assert(gpuTileData.textureArrayIndex >= 0);
 				gpuTileData.vbo = {};
 				gpuTileData.ibo = {};
-				res.returnTileInd(gpuTileData.textureArrayIndex);
+				res.returnTileInd(gpuTileData.texturePool, gpuTileData.textureArrayIndex);
+				res.returnMeshSlot(gpuTileData.meshSlot);
 				gpuTileData.textureArrayIndex = -1;
+				gpuTileData.texturePool = -1;
+				gpuTileData.meshSlot = -1;
 			}
 		}
 
@@ -375,34 +423,23 @@ namespace gearth {
 			return bb.terminal;
         }
 
-        inline void render(const RenderState& rs) {
+        // Collect the draws of all visible leaves, grouped by texture pool (and the children an opening tile has so far).
+        // The globe then sets each pool's bind group once and issues all of that pool's draws.
+        inline void gatherDraws(std::vector<std::vector<GpuTileData*>>& drawsByPool) {
             if (shouldDraw()) {
 				if (sse != kBoundingBoxNotVisible) {
 
-					// draw ...
-					// spdlog::get("gearthRndr")->trace("render ready leaf {} inds {}", coord, gpuTileData.nindex);
-
-					// rs.pass.setRenderPipeline(rndrPipe);
-					// rs.pass.setBindGroup(0, rs.appObjects.getSceneBindGroup());
-
 					for (uint32_t i=0; i<gpuTileDatas.size(); i++) {
-
-						// FIXME: Must set uvScaleOffset -- but VERY inefficient to do with a bind set with only one UBO shared for all tiles?
-						//        Probably should see if there is a wgsl uniform array I can access (like a texture array) and use one big UBO.
-						//        Otherwise have UBO per tile?
-						// gpuResources
-
 						auto &gpuTileData = gpuTileDatas[i];
-							rs.pass.setVertexBuffer(0, gpuTileData.vbo, 0, gpuTileData.vbo.getSize());
-							rs.pass.setIndexBuffer(gpuTileData.ibo, WGPUIndexFormat_Uint16, 0, gpuTileData.ibo.getSize());
-							rs.pass.drawIndexed(gpuTileData.nindex, 1, 0, 0, gpuTileData.textureArrayIndex);
+						drawsByPool[gpuTileData.texturePool].push_back(&gpuTileData);
 					}
+					for (int i = 0; i < nchildren; i++) children[i]->gatherDraws(drawsByPool);
 				} else {
 					logTrace("cull!");
 				}
 
             } else if (isInterior()) {
-                for (int i = 0; i < nchildren; i++) children[i]->render(rs);
+                for (int i = 0; i < nchildren; i++) children[i]->gatherDraws(drawsByPool);
             } else {
                 spdlog::get("gearthRndr")->warn("non shouldDraw/isInterior ?");
             }
@@ -433,9 +470,11 @@ namespace gearth {
         GearthGlobe(AppObjects& ao, const GlobeOptions& opts)
             : Globe(ao, opts)
             , gpuResources(ao, opts)
+            , governor(opts)
 		{
             // loader = std::make_unique<GenericGearthDataLoader>(opts);
-            loader = std::make_unique<DiskGearthDataLoader>(opts);
+            loader = std::make_unique<DiskGearthDataLoader>(opts, gpuResources.supportsDxt1());
+            drawsByPool.resize(gpuResources.texturePools.size());
 
             logger = spdlog::get("gearthRndr");
             if (logger == nullptr) {
@@ -457,6 +496,7 @@ namespace gearth {
 		}
 
         inline virtual void render(const RenderState& rs) override {
+			auto workStart = std::chrono::steady_clock::now();
 
 			// Temporary test of casting.
 			/*
@@ -495,12 +535,10 @@ namespace gearth {
 			if (gpuResources.castGpuResources.active()) {
 				rs.pass.setRenderPipeline(gpuResources.castPipelineAndLayout);
 				rs.pass.setBindGroup(0, rs.appObjects.getSceneBindGroup());
-				rs.pass.setBindGroup(1, gpuResources.sharedBindGroup);
 				rs.pass.setBindGroup(2, gpuResources.castGpuResources.bindGroup);
 			} else {
 				rs.pass.setRenderPipeline(gpuResources.mainPipelineAndLayout);
 				rs.pass.setBindGroup(0, rs.appObjects.getSceneBindGroup());
-				rs.pass.setBindGroup(1, gpuResources.sharedBindGroup);
 			}
 
 
@@ -511,6 +549,13 @@ namespace gearth {
 			updateState.tanHalfFovTimesHeight = rs.intrin.fy;
 
 			auto responses = loader->pullResponses();
+
+			// Thresholds for this frame, from how the last frames went. Residency is that of the fullest pool, so it backs off before any one runs out.
+			auto [residentLayers, poolLayers] = gpuResources.fullestPoolUsage();
+			const SseGovernor::State& gov = governor.update(lastWorkMs, residentLayers, poolLayers, loader->loadsInFlight());
+			updateState.sseOpenThresh  = gov.openThresh;
+			updateState.sseCloseThresh = gov.closeThresh;
+			if (debugLevel >= 1 and gov.frames % 60 == 0) logger->debug("governor: {}", governor.summary());
 			if (responses.size() and debugLevel >= 1)
 				logger->debug("recv {} data loader responses", responses.size());
             for (auto& resp : responses) {
@@ -529,10 +574,24 @@ namespace gearth {
 				print();
 
 			if (debugLevel >= 2) logger->info("|time| begin render");
-            for (auto tile : roots) { tile->render(rs); }
+			for (auto& draws : drawsByPool) draws.clear();
+            for (auto tile : roots) { tile->gatherDraws(drawsByPool); }
+
+			// Group 1 (the texture array) is set per pool.
+			for (int pool = 0; pool < drawsByPool.size(); pool++) {
+				if (drawsByPool[pool].empty()) continue;
+				rs.pass.setBindGroup(1, gpuResources.texturePools[pool].bindGroup);
+				for (auto gpuTileData : drawsByPool[pool]) {
+					rs.pass.setVertexBuffer(0, gpuTileData->vbo, 0, gpuTileData->vbo.getSize());
+					rs.pass.setIndexBuffer(gpuTileData->ibo, WGPUIndexFormat_Uint16, 0, gpuTileData->ibo.getSize());
+					rs.pass.drawIndexed(gpuTileData->nindex, 1, 0, 0, gpuTileData->meshSlot);
+				}
+			}
 			if (debugLevel >= 2) logger->info("|time| finish render");
 
             if (debugLevel >= 1 and bboxEntity) for (auto tile : roots) { tile->renderBb(rs, bboxEntity.get()); }
+
+			lastWorkMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - workStart).count();
         }
 
         inline void createAndWaitForRootsToLoad_() {
@@ -587,10 +646,15 @@ namespace gearth {
         GpuResources gpuResources;
 
         std::vector<Tile*> roots;
+        std::vector<std::vector<GpuTileData*>> drawsByPool; // reused every frame
 
 		std::unique_ptr<GenericGearthDataLoader> loader;
         std::shared_ptr<spdlog::logger> logger;
         std::shared_ptr<InefficientBboxEntity> bboxEntity;
+
+		// Adjusts the sse thresholds every frame. Public, for tuning.
+		SseGovernor governor;
+		float lastWorkMs = 0; // time spent in the last `render`
     };
 
 
@@ -18,6 +18,8 @@ namespace wg {
 			Buffer ibo;
 			Buffer vbo;
 			int32_t textureArrayIndex = -1;
+			int32_t texturePool = -1; // index into `GpuResources::texturePools`
+			int32_t meshSlot = -1;    // index into `GpuResources::meshDataBuffer`, passed as `instance_index`
 			uint32_t nindex = 0;
 		};
 
@@ -6,6 +6,8 @@
 
 #include "gearth.h"
 #include "decode/rt_decode.hpp"
+#include "util/mappedFile.h"
+#include "util/packFile.h"
 
 #include <opencv2/imgproc.hpp>
 #include "geo/conversions.h"
@@ -20,13 +22,21 @@ namespace gearth {
 
 
         // Note that obbMap is initialized on the calling thread synchronously
-        inline DiskGearthDataLoader(const GlobeOptions& opts)
-            : DiskDataLoader(opts, opts.getString("gearthPath") + "/webgpuGlobe.bb") {
+        // `keepDxt1` should be set iff the GPU can sample BC1 textures, see `decode_node_to_tile`.
+        inline DiskGearthDataLoader(const GlobeOptions& opts, bool keepDxt1)
+            : DiskDataLoader(opts, opts.getString("gearthPath") + "/webgpuGlobe.bb")
+            , keepDxt1(keepDxt1) {
 
 			root = opts.getString("gearthPath");
 			if (root.length() and root.back() == '/') root.pop_back();
 
+			// If the dataset was packed (see `util/makePackFile.cc`), read nodes from the pack instead of one file each.
+			if (nodePack.open(root + "/node.pack"))
+				fmt::print(" - [DiskGearthDataLoader] using '{}/node.pack' ({} nodes).\n", root, nodePack.entries().size());
+
 			colorMult = opts.getDouble("colorMult");
+			// Textures larger than this are decoded at a reduced scale (see `decodeJpegToRgba`).
+			maxTexEdge = (uint32_t)opts.getDouble("gearthMaxTextureSize", kTextureBucketSizes[kNumTextureBuckets-1]);
 			start();
 
         }
@@ -42,13 +52,33 @@ namespace gearth {
             // Set indices.
 
 			std::string path { fmt::format("{}/node/{}", root, c.s) };
-	std::ifstream ifs(path);
+	// Mapped rather than read, so the mesh & texture bytes are decoded straight from the page cache (see `RtNodeView`).
+	// With a pack, one `pread` into `packBuf` instead.
+	MappedFile file;
+	std::vector<uint8_t> packBuf;
+	const uint8_t* nodeData = nullptr;
+	size_t nodeSize = 0;
+	if (nodePack.isOpen()) {
+		if (not nodePack.read(c.s, packBuf) or packBuf.empty()) {
+			fmt::print(" - [#loadTile] node '{}' not in pack, skipping tile.\n", c.s);
+			return;
+		}
+		nodeData = packBuf.data();
+		nodeSize = packBuf.size();
+	} else {
+		if (not file.open(path)) {
+			fmt::print(" - [#loadTile] could not open '{}', skipping tile.\n", path);
+			return;
+		}
+		nodeData = file.data();
+		nodeSize = file.size();
+	}
 
 
 	// fmt::print(" - Decoding {}\n", fname);
 #warning "fixme: put this back to false and fix issue?"
 	// if (decode_node_to_tile(ifs, item.dtd, false)) {
-	if (decode_node_to_tile(ifs, item.dtd, true)) {
+	if (decode_node_to_tile(nodeData, nodeSize, item.dtd, true, keepDxt1, maxTexEdge)) {
 		fmt::print(" - [#loadTile] decode '{}' failed, skipping tile.\n", path);
 		// tile->loaded = true;
 		// return dtd.meshes.size();
@@ -194,7 +224,10 @@ namespace gearth {
 		// std::shared_ptr<GdalDataset> colorDset;
 		// std::shared_ptr<GdalDataset> dtedDset;
 		double colorMult = 1;
+		bool keepDxt1 = false;
+		uint32_t maxTexEdge = kTextureBucketSizes[kNumTextureBuckets-1];
 		std::string root;
+		PackFile nodePack;
     };
 
 }
@@ -7,6 +7,7 @@
 
 #include <wgpu/wgpu.h>
 #include <unistd.h>
+#include <cstddef>
 
 namespace wg {
     namespace gearth {
@@ -14,11 +15,8 @@ namespace wg {
         GpuResources::GpuResources(AppObjects& ao, const GlobeOptions& opts)
             : ao(ao) {
 
-            freeTileInds.resize(MAX_TILES);
-            for (int i = 0; i < MAX_TILES; i++) freeTileInds[i] = i;
-
             // ------------------------------------------------------------------------------------------------------------------------------------------
-            //     Texture & Sampler
+            //     Sampler & Texture Pools
             // ------------------------------------------------------------------------------------------------------------------------------------------
 
             sampler       = ao.device.create(WGPUSamplerDescriptor {
@@ -37,34 +35,100 @@ namespace wg {
                       .maxAnisotropy = 1,
             });
 
-            sharedTex     = ao.device.create(WGPUTextureDescriptor {
+            // One texture array per size bucket (see `kTextureBucketSizes`), per format. Nearly all tiles are 256px, so that bucket gets `MAX_TILES`.
+            // Without BC support every texture is RGBA8: the defaults come to ~370MB.
+            // With it, the BC1 arrays hold the (transcodable) bulk of the tiles in ~45MB, and the RGBA8 ones only the tiles that can not be
+            // kept as BC1 (JPEG only, or not exactly a bucket's size), so they get a quarter of the layers: ~140MB in all.
+            const std::vector<double> fullLayers = { 256, MAX_TILES, 64, 8 };
+            const std::vector<double> fewLayers  = { 64, MAX_TILES / 4, 16, 2 };
+            std::vector<double> rgbaLayers = opts.getDoubleVec("gearthTextureBucketLayers", supportsDxt1() ? fewLayers : fullLayers);
+            std::vector<double> dxt1Layers = opts.getDoubleVec("gearthDxt1TextureBucketLayers", fullLayers);
+            if (rgbaLayers.size() != kNumTextureBuckets or dxt1Layers.size() != kNumTextureBuckets)
+                throw std::runtime_error(fmt::format("gearthTextureBucketLayers and gearthDxt1TextureBucketLayers must have {} entries", kNumTextureBuckets));
+
+            // A bucket may only go without layers if the loader never makes textures of its size (see `gearthMaxTextureSize`):
+            // otherwise such a tile would have no pool to go in.
+            uint32_t maxTexEdge = (uint32_t)opts.getDouble("gearthMaxTextureSize", kTextureBucketSizes[kNumTextureBuckets-1]);
+            uint32_t largestUsed = textureBucketSize(maxTexEdge, maxTexEdge, maxTexEdge);
+            auto addPools = [&](RtTextureFormat format, WGPUTextureFormat gpuFormat, const std::vector<double>& bucketLayers, const char* optName) {
+                for (int i = 0; i < kNumTextureBuckets; i++) {
+                    uint32_t layers = std::min((uint32_t)bucketLayers[i], (uint32_t)MAX_TILES);
+                    if (layers == 0 and kTextureBucketSizes[i] <= largestUsed)
+                        throw std::runtime_error(fmt::format("{}: the {}px bucket needs layers (or lower gearthMaxTextureSize below it)", optName, kTextureBucketSizes[i]));
+                    if (layers > 0) addTexturePool(format, gpuFormat, kTextureBucketSizes[i], layers);
+                }
+            };
+            addPools(RtTextureFormat::Rgba8, WGPUTextureFormat_RGBA8Unorm, rgbaLayers, "gearthTextureBucketLayers");
+            // Only if the device was created with `TextureCompressionBC` will the loader keep textures as DXT1.
+            if (supportsDxt1()) addPools(RtTextureFormat::Dxt1, WGPUTextureFormat_BC1RGBAUnorm, dxt1Layers, "gearthDxt1TextureBucketLayers");
+
+            // ------------------------------------------------------------------------------------------------------------------------------------------
+            //     Per-mesh data
+            // ------------------------------------------------------------------------------------------------------------------------------------------
+
+            for (auto& pool : texturePools) meshSlots += pool.layers;
+            freeMeshSlots.resize(meshSlots);
+            for (int i = 0; i < meshSlots; i++) freeMeshSlots[i] = i;
+
+            meshDataBuffer = ao.device.create(WGPUBufferDescriptor {
+                    .nextInChain      = nullptr,
+                    .label            = "GearthMeshDataBuffer",
+                    .usage            = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Storage,
+                    .size             = meshSlots * sizeof(MeshShaderData),
+                    .mappedAtCreation = false,
+            });
+
+            createMainPipeline();
+            createCastPipeline();
+        }
+
+        void GpuResources::writeMeshData(int32_t slot, const MeshShaderData& data) {
+            assert(slot >= 0 and slot < meshSlots);
+            ao.queue.writeBuffer(meshDataBuffer, slot * sizeof(MeshShaderData), &data, sizeof(MeshShaderData));
+        }
+
+        void GpuResources::writeMeshOctantMask(int32_t slot, uint32_t mask) {
+            assert(slot >= 0 and slot < meshSlots);
+            ao.queue.writeBuffer(meshDataBuffer, slot * sizeof(MeshShaderData) + offsetof(MeshShaderData, octantMask), &mask, sizeof(mask));
+        }
+
+        void GpuResources::addTexturePool(RtTextureFormat format, WGPUTextureFormat gpuFormat, uint32_t size, uint32_t layers) {
+            TexturePool pool;
+            pool.format    = format;
+            pool.gpuFormat = gpuFormat;
+            pool.size      = size;
+            pool.layers    = layers;
+
+            pool.freeInds.resize(layers);
+            for (int i = 0; i < layers; i++) pool.freeInds[i] = i;
+
+            pool.tex     = ao.device.create(WGPUTextureDescriptor {
                     .nextInChain     = nullptr,
                     .label           = "GearthGlobeTextureArray",
                     .usage           = WGPUTextureUsage_CopyDst | WGPUTextureUsage_TextureBinding,
                     .dimension       = WGPUTextureDimension_2D,
-                    .size            = WGPUExtent3D { 256, 256, MAX_TILES },
-                    .format          = WGPUTextureFormat_RGBA8Unorm,
+                    .size            = WGPUExtent3D { size, size, layers },
+                    .format          = gpuFormat,
                     .mipLevelCount   = 1,
                     .sampleCount     = 1,
                     .viewFormatCount = 0,
                     .viewFormats     = 0
             });
 
-            sharedTexView = sharedTex.createView(WGPUTextureViewDescriptor {
+            pool.texView = pool.tex.createView(WGPUTextureViewDescriptor {
                 .nextInChain = nullptr,
                 .label       = "GearthRenderer_sharedTexView",
-                .format      = WGPUTextureFormat_RGBA8Unorm,
+                .format      = gpuFormat,
                 // .dimension       = WGPUTextureViewDimension_2D,
                 .dimension       = WGPUTextureViewDimension_2DArray,
                 .baseMipLevel    = 0,
                 .mipLevelCount   = 1,
                 .baseArrayLayer  = 0,
-                .arrayLayerCount = MAX_TILES,
+                .arrayLayerCount = layers,
                 .aspect          = WGPUTextureAspect_All,
             });
 
-            createMainPipeline();
-            createCastPipeline();
+            texturePools.push_back(std::move(pool));
         }
 
         void GpuResources::createMainPipeline() {
@@ -74,7 +138,7 @@ namespace wg {
             //     BindGroupLayout & BindGroup
             // ------------------------------------------------------------------------------------------------------------------------------------------
 
-            WGPUBindGroupLayoutEntry sharedTexLayoutEntries[2] = {
+            WGPUBindGroupLayoutEntry sharedTexLayoutEntries[3] = {
                 {
                  .nextInChain    = nullptr,
                  .binding        = 0,
@@ -96,25 +160,46 @@ namespace wg {
                  .texture        = { .nextInChain = nullptr, .sampleType = WGPUTextureSampleType_Undefined },
                  .storageTexture = { .nextInChain = nullptr, .access = WGPUStorageTextureAccess_Undefined },
                  },
+                {
+                 .nextInChain    = nullptr,
+                 .binding        = 2,
+                 .visibility     = WGPUShaderStage_Vertex,
+                 .buffer         = WGPUBufferBindingLayout { .nextInChain      = nullptr,
+                 .type             = WGPUBufferBindingType_ReadOnlyStorage,
+                 .hasDynamicOffset = false,
+                 .minBindingSize   = 0 },
+                 .sampler        = { .nextInChain = nullptr, .type = WGPUSamplerBindingType_Undefined },
+                 .texture        = { .nextInChain = nullptr, .sampleType = WGPUTextureSampleType_Undefined },
+                 .storageTexture = { .nextInChain = nullptr, .access = WGPUStorageTextureAccess_Undefined },
+                 },
             };
             sharedBindGroupLayout              = ao.device.create(WGPUBindGroupLayoutDescriptor {
-                             .nextInChain = nullptr, .label = "GearthRendererSharedBGL", .entryCount = 2, .entries = sharedTexLayoutEntries });
-
-            WGPUBindGroupEntry groupEntries[2] = {
-                { .nextInChain = nullptr,
-                 .binding     = 0,
-                 .buffer      = 0,
-                 .offset      = 0,
-                 .size        = 0,
-                 .sampler     = nullptr,
-                 .textureView = sharedTexView                                                                                    },
-                { .nextInChain = nullptr, .binding = 1, .buffer = 0, .offset = 0, .size = 0, .sampler = sampler, .textureView = 0 },
-            };
-            sharedBindGroup = ao.device.create(WGPUBindGroupDescriptor { .nextInChain = nullptr,
-                                                                         .label       = "GearthRendererSharedBG",
-                                                                         .layout      = sharedBindGroupLayout,
-                                                                         .entryCount  = 2,
-                                                                         .entries     = groupEntries });
+                             .nextInChain = nullptr, .label = "GearthRendererSharedBGL", .entryCount = 3, .entries = sharedTexLayoutEntries });
+
+            for (auto& pool : texturePools) {
+                WGPUBindGroupEntry groupEntries[3] = {
+                    { .nextInChain = nullptr,
+                     .binding     = 0,
+                     .buffer      = 0,
+                     .offset      = 0,
+                     .size        = 0,
+                     .sampler     = nullptr,
+                     .textureView = pool.texView                                                                                     },
+                    { .nextInChain = nullptr, .binding = 1, .buffer = 0, .offset = 0, .size = 0, .sampler = sampler, .textureView = 0 },
+                    { .nextInChain = nullptr,
+                     .binding     = 2,
+                     .buffer      = meshDataBuffer,
+                     .offset      = 0,
+                     .size        = meshSlots * sizeof(MeshShaderData),
+                     .sampler     = nullptr,
+                     .textureView = nullptr },
+                };
+                pool.bindGroup = ao.device.create(WGPUBindGroupDescriptor { .nextInChain = nullptr,
+                                                                            .label       = "GearthRendererSharedBG",
+                                                                            .layout      = sharedBindGroupLayout,
+                                                                            .entryCount  = 3,
+                                                                            .entries     = groupEntries });
+            }
 
             // ------------------------------------------------------------------------------------------------------------------------------------------
             //     Shader
@@ -137,25 +222,26 @@ namespace wg {
                      .bindGroupLayouts     = bgls,
             });
 
+            // `RtPackedVertex`: xyz + octant as u8, uv as u16, normal + extra as u8.
             WGPUVertexAttribute attributes[3] = {
                 WGPUVertexAttribute {
-                                     .format         = WGPUVertexFormat_Float32x4,
-                                     .offset         = 0 * sizeof(float),
+                                     .format         = WGPUVertexFormat_Uint8x4,
+                                     .offset         = offsetof(RtPackedVertex, x),
                                      .shaderLocation = 0,
                                      },
                 WGPUVertexAttribute {
-                                     .format         = WGPUVertexFormat_Float32x2,
-                                     .offset         = 4 * sizeof(float),
+                                     .format         = WGPUVertexFormat_Uint16x2,
+                                     .offset         = offsetof(RtPackedVertex, u),
                                      .shaderLocation = 1,
                                      },
                 WGPUVertexAttribute {
-                                     .format         = WGPUVertexFormat_Float32x4,
-                                     .offset         = 6 * sizeof(float),
+                                     .format         = WGPUVertexFormat_Unorm8x4,
+                                     .offset         = offsetof(RtPackedVertex, nx),
                                      .shaderLocation = 2,
                                      },
             };
             WGPUVertexBufferLayout vbl {
-                .arrayStride    = (4 + 2 + 4) * sizeof(float),
+                .arrayStride    = sizeof(RtPackedVertex),
                 .stepMode       = WGPUVertexStepMode_Vertex,
                 .attributeCount = 3,
                 .attributes     = attributes,
@@ -218,25 +304,26 @@ namespace wg {
                      .bindGroupLayouts     = bgls,
             });
 
+            // `RtPackedVertex`: xyz + octant as u8, uv as u16, normal + extra as u8.
             WGPUVertexAttribute attributes[3] = {
                 WGPUVertexAttribute {
-                                     .format         = WGPUVertexFormat_Float32x4,
-                                     .offset         = 0 * sizeof(float),
+                                     .format         = WGPUVertexFormat_Uint8x4,
+                                     .offset         = offsetof(RtPackedVertex, x),
                                      .shaderLocation = 0,
                                      },
                 WGPUVertexAttribute {
-                                     .format         = WGPUVertexFormat_Float32x2,
-                                     .offset         = 4 * sizeof(float),
+                                     .format         = WGPUVertexFormat_Uint16x2,
+                                     .offset         = offsetof(RtPackedVertex, u),
                                      .shaderLocation = 1,
                                      },
                 WGPUVertexAttribute {
-                                     .format         = WGPUVertexFormat_Float32x4,
-                                     .offset         = 6 * sizeof(float),
+                                     .format         = WGPUVertexFormat_Unorm8x4,
+                                     .offset         = offsetof(RtPackedVertex, nx),
                                      .shaderLocation = 2,
                                      },
             };
             WGPUVertexBufferLayout vbl {
-                .arrayStride    = (4 + 2 + 4) * sizeof(float),
+                .arrayStride    = sizeof(RtPackedVertex),
                 .stepMode       = WGPUVertexStepMode_Vertex,
                 .attributeCount = 3,
                 .attributes     = attributes,
@@ -8,18 +8,62 @@
 namespace wg {
 namespace gearth {
 
-	struct ExtraTileData {
-		float uvScaleOffset[4];
+	// Per-mesh data read by the vertex shader from a storage buffer, indexed by `instance_index` (the mesh's "slot").
+	// Must match `MeshData` in `shader.hpp` and `shader_cast.hpp`.
+	// The vertices are the raw `RtPackedVertex`es, so `model` takes them straight to (unit-radius) globe coordinates.
+	struct MeshShaderData {
+		float model[16]; // column major: diag(1/R1) * globeFromMesh
+		float uvOffsetScale[4];
+		uint32_t texIndex; // layer in the mesh's texture pool
+		uint32_t octantMask; // bit i set: the vertices of octant i (`RtPackedVertex::w`) are not drawn, see `Tile::coveredMask`
+		uint32_t pad[2];
+	};
+	static_assert(sizeof(MeshShaderData) == 96);
+
+
+	// A texture array that tiles take layers from, plus the bind group to draw with it.
+	// There is one pool per (texture format, size bucket) the loader can hand us (see `RtTextureFormat` and `kTextureBucketSizes`),
+	// and the tile remembers which pool its layer came from. Draws are grouped by pool so each bind group is set once per frame.
+	struct TexturePool {
+		RtTextureFormat format;
+		WGPUTextureFormat gpuFormat;
+		uint32_t size;   // width and height of each layer
+		uint32_t layers;
+
+		Texture tex;
+		TextureView texView;
+		BindGroup bindGroup; // Created along with the main pipeline, since it needs the layout.
+
+		std::vector<int32_t> freeInds;
+
+		inline int32_t take() {
+			if (freeInds.size() == 0) {
+				throw NoTilesAvailableExecption {};
+			} else {
+				int32_t out = freeInds.back();
+				freeInds.pop_back();
+				return out;
+			}
+		}
+
+		inline void give(int32_t ind) {
+			freeInds.push_back(ind);
+			assert(freeInds.size() <= layers);
+		}
 	};
 
 
     struct GpuResources {
-        Texture sharedTex;
-        TextureView sharedTexView;
+        std::vector<TexturePool> texturePools;
 
-        Sampler sampler;
+        // One `MeshShaderData` per slot. There are as many slots as there are texture layers in all pools,
+        // since every drawn mesh also holds a layer.
+        Buffer meshDataBuffer;
+        uint32_t meshSlots = 0;
+        std::vector<int32_t> freeMeshSlots;
+        uint64_t droppedMeshes = 0; // meshes that were not loaded because their pool was full, see `Tile::loadFrom`
 
-        std::vector<int32_t> freeTileInds;
+        Sampler sampler;
 
 		// ---------------------------------------------------------------------------------------------------
 		// Main Pipeline
@@ -28,8 +72,8 @@ namespace gearth {
 
 		// Used with main pipeline (for rendering tiles with reference textures)
         // "shared" because the same texture is used for all tiles -- by way of array layers / subresources.
+        // The layout is shared by the bind groups of all `texturePools`.
         BindGroupLayout sharedBindGroupLayout;
-        BindGroup sharedBindGroup;
 
 		RenderPipelineWithLayout mainPipelineAndLayout;
 		void createMainPipeline();
@@ -53,20 +97,56 @@ namespace gearth {
 
         GpuResources(AppObjects& ao, const GlobeOptions& opts);
 
-        inline int32_t takeTileInd() {
-            if (freeTileInds.size() == 0) {
-                throw NoTilesAvailableExecption {};
-            } else {
-                int32_t out = freeTileInds.back();
-                freeTileInds.pop_back();
-                return out;
+        void addTexturePool(RtTextureFormat format, WGPUTextureFormat gpuFormat, uint32_t size, uint32_t layers);
+        inline bool supportsDxt1() const {
+            return ao.textureCompressionBC;
+        }
+
+        // Returns -1 if there is no pool for this format & size.
+        inline int findTexturePool(RtTextureFormat format, uint32_t w, uint32_t h) const {
+            for (int i = 0; i < texturePools.size(); i++)
+                if (texturePools[i].format == format and texturePools[i].size == w and texturePools[i].size == h) return i;
+            return -1;
+        }
+
+        // Whether a mesh textured from `pool` can be loaded now: it needs a layer of the pool and a mesh slot.
+        inline bool hasRoomFor(int pool) const {
+            return texturePools[pool].freeInds.size() > 0 and freeMeshSlots.size() > 0;
+        }
+
+        // Used and total layers of the fullest pool. That is what runs out first, not the sum over all pools (most tiles share one bucket).
+        inline std::pair<int, int> fullestPoolUsage() const {
+            std::pair<int, int> out { 0, 0 };
+            for (const auto& pool : texturePools) {
+                int used = pool.layers - (int)pool.freeInds.size();
+                if (out.second == 0 or (int64_t)used * out.second > (int64_t)out.first * pool.layers) out = { used, (int)pool.layers };
             }
+            return out;
         }
 
-        inline void returnTileInd(int32_t ind) {
-			freeTileInds.push_back(ind);
-			assert(freeTileInds.size() <= MAX_TILES);
-		}
+        inline int32_t takeTileInd(int pool) {
+            return texturePools[pool].take();
+        }
+
+        inline void returnTileInd(int pool, int32_t ind) {
+            texturePools[pool].give(ind);
+        }
+
+        inline int32_t takeMeshSlot() {
+            if (freeMeshSlots.size() == 0) throw NoTilesAvailableExecption {};
+            int32_t out = freeMeshSlots.back();
+            freeMeshSlots.pop_back();
+            return out;
+        }
+
+        inline void returnMeshSlot(int32_t slot) {
+            freeMeshSlots.push_back(slot);
+            assert(freeMeshSlots.size() <= meshSlots);
+        }
+
+        void writeMeshData(int32_t slot, const MeshShaderData& data);
+        // Just the `octantMask` of a slot.
+        void writeMeshOctantMask(int32_t slot, uint32_t mask);
 
     };
 
@@ -25,11 +25,20 @@ var<uniform> scd: SceneCameraData;
 @group(1) @binding(0) var sharedTex: texture_2d_array<f32>;
 @group(1) @binding(1) var sharedSampler: sampler;
 
+// Must match `MeshShaderData` in `resources.h`.
+struct MeshData {
+	model: mat4x4<f32>,
+	uvOffsetScale: vec4f,
+	texIndex: u32,
+	octantMask: u32,
+}
+@group(1) @binding(2) var<storage, read> meshDatas: array<MeshData>;
+
 
 struct VertexInput {
 	@builtin(instance_index) instance_index: u32,
-    @location(0) position: vec4<f32>,
-    @location(1) uv: vec2<f32>,
+    @location(0) position: vec4<u32>, // xyz + octant
+    @location(1) uv: vec2<u32>,
     @location(2) normal: vec4<f32>,
     // @location(3) extra: f32,
 };
@@ -42,20 +51,25 @@ struct VertexOutput {
 };
 
 //
-// NOTE: This uses the trick of encoding the tile's texture array index as `instance_index`.
+// NOTE: This uses the trick of encoding the mesh's slot in `meshDatas` as `instance_index`.
 //
 
 @vertex
 fn vs_main(vi: VertexInput) -> VertexOutput {
 	var vo : VertexOutput;
 
-	var p = scd.mvp * vec4(vi.position.xyz, 1.);
+	let md = meshDatas[vi.instance_index];
+	let pos = md.model * vec4(vec3f(vi.position.xyz), 1.);
+
+	var p = scd.mvp * vec4(pos.xyz, 1.);
 	vo.position = p;
+	// Octants whose child has arrived while this tile opens draw nothing: all their vertices go to the same point.
+	if (((md.octantMask >> vi.position.w) & 1u) != 0u) { vo.position = vec4f(0.); }
 
 	vo.color = scd.colorMult;
-	vo.uv = vi.uv;
+	vo.uv = (vec2f(vi.uv) + md.uvOffsetScale.xy) * md.uvOffsetScale.zw;
 
-	vo.tex_index = vi.instance_index;
+	vo.tex_index = md.texIndex;
 
 	return vo;
 }
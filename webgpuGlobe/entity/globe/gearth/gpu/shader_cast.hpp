@@ -33,6 +33,15 @@ var<uniform> scd: SceneCameraData;
 @group(1) @binding(0) var sharedTex: texture_2d_array<f32>;
 @group(1) @binding(1) var sharedSampler: sampler;
 
+// Must match `MeshShaderData` in `resources.h`.
+struct MeshData {
+	model: mat4x4<f32>,
+	uvOffsetScale: vec4f,
+	texIndex: u32,
+	octantMask: u32,
+}
+@group(1) @binding(2) var<storage, read> meshDatas: array<MeshData>;
+
 @group(2) @binding(0) var castTex1: texture_2d<f32>;
 @group(2) @binding(1) var castTex2: texture_2d<f32>;
 @group(2) @binding(2) var castSampler: sampler;
@@ -41,8 +50,8 @@ var<uniform> scd: SceneCameraData;
 
 struct VertexInput {
 	@builtin(instance_index) instance_index: u32,
-    @location(0) position: vec4<f32>,
-    @location(1) uv: vec2<f32>,
+    @location(0) position: vec4<u32>, // xyz + octant
+    @location(1) uv: vec2<u32>,
     @location(2) normal: vec4<f32>,
 };
 
@@ -59,15 +68,20 @@ struct VertexOutput {
 fn vs_main(vi: VertexInput) -> VertexOutput {
 	var vo : VertexOutput;
 
-	var p = scd.mvp * vec4(vi.position.xyz, 1.);
+	let md = meshDatas[vi.instance_index];
+	let pos = md.model * vec4(vec3f(vi.position.xyz), 1.);
+
+	var p = scd.mvp * vec4(pos.xyz, 1.);
 	vo.position = p;
+	// Covered octants, as in `shader.hpp`.
+	if (((md.octantMask >> vi.position.w) & 1u) != 0u) { vo.position = vec4f(0.); }
 
 	vo.color = scd.colorMult;
-	vo.uv_main = vi.uv;
-	vo.main_tex_index = vi.instance_index;
+	vo.uv_main = (vec2f(vi.uv) + md.uvOffsetScale.xy) * md.uvOffsetScale.zw;
+	vo.main_tex_index = md.texIndex;
 
 	if ((castData.mask & 1) > 0) {
-		var castA_4 = (castData.mvp1 * vec4(vi.position.xyz,1.));
+		var castA_4 = (castData.mvp1 * vec4(pos.xyz,1.));
 		var castA_3 = castA_4.xyz / castA_4.w;
 		vo.uv_cast1 = castA_3.xy * vec2f(.5, -.5) + .5;
 		if (castA_3.z < 0.000000001) {vo.uv_cast1 = vec2f(0.);}
@@ -76,7 +90,7 @@ fn vs_main(vi: VertexInput) -> VertexOutput {
 	}
 
 	if ((castData.mask & 2) > 0) {
-		var castA_4 = (castData.mvp2 * vec4(vi.position.xyz,1.));
+		var castA_4 = (castData.mvp2 * vec4(pos.xyz,1.));
 		var castA_3 = castA_4.xyz / castA_4.w;
 		vo.uv_cast2 = castA_3.xy * vec2f(.5, -.5) + .5;
 		if (castA_3.z < 0.000000001) {vo.uv_cast2 = vec2f(0.);}
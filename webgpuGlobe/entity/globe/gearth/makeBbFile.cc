@@ -8,10 +8,17 @@
 #include "entity/entity.h"
 
 #include "util/align3d.hpp"
+#include "util/packFile.h"
+#include "util/parallel.h"
 
 #include <sys/stat.h>
 #include <dirent.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <unordered_map>
+
 #include "decode/rt_convert.hpp"
 #include "rocktree.pb.h"
 namespace rtpb = ::geo_globetrotter_proto_rocktree;
@@ -121,137 +128,269 @@ namespace {
 
 	}
 
-    void make_bb_map(const std::string& outPath, const std::string& rootDir, const GlobeOptions& gopts) {
-        std::vector<GearthBoundingBoxMap::Item> items;
-		spdlog::get("wg")->warn("making bb file '{}', this may take a while...", outPath);
-
-		int ntotal = 0;
-		int nmissingNode = 0;
-		int ngood = 0;
-		int nbadObb = 0;
+	using BbItem = GearthBoundingBoxMap::Item;
+
+	//
+	// Everything one bulk file contributes to the bb file. Kept per bulk (rather than per node file) so that it can be
+	// cached: see `BulkCache`.
+	// `items` has every node of the bulk with a valid obb, whether or not its node file exists. That is filtered at the end,
+	// so that adding node files later does not invalidate the cache.
+	//
+	struct BulkResult {
+		std::string name;
+		uint64_t sig[2] = {0, 0};
+		std::vector<BbItem> items;
+		uint32_t ntotal  = 0;
+		uint32_t nbadObb = 0;
+		bool ok          = false;
+		bool fromCache   = false;
+	};
 
-		// `file_exist` may be slow, so instead build hashset of existing node files upfront.
-		std::unordered_set<std::string> nodeFiles;
-		auto nodeFilesVec = list_dir(fmt::format("{}/node", rootDir));
-		for (auto nodeFile : nodeFilesVec) {
-			std::string nkey = nodeFile.substr(nodeFile.rfind("/")+1);
-			// fmt::print("key: {} from {}\n", nkey, nodeFile);
-			nodeFiles.insert(nkey);
+	// Something that changes whenever the bulk's bytes do: size & mtime of the file, or size & offset of the pack entry
+	// (a rewritten entry is appended, so it moves).
+	bool bulk_signature(const std::string& bulkPath, const PackFile* pack, uint64_t sig[2]) {
+		if (pack) {
+			const PackFile::Entry* e = pack->find(bulkPath);
+			if (e == nullptr) return false;
+			sig[0] = e->size;
+			sig[1] = e->offset;
+			return true;
 		}
-		fmt::print("listed {} / {} node files\n", nodeFiles.size(), nodeFilesVec.size());
-
-		auto bulks = list_dir(fmt::format("{}/bulk", rootDir));
-		for (int i=0; i<bulks.size(); i++) {
-		// for (const auto& bulkPath : bulks) {
-			const auto &bulkPath = bulks[i];
-			if (i % 2500 == 0)
-				fmt::print("on bulk {} / {}\n", i, bulks.size());
-
-			std::ifstream ifs(bulkPath, std::ios_base::binary);
+		struct stat buf;
+		if (stat(bulkPath.c_str(), &buf) != 0) return false;
+		sig[0] = buf.st_size;
+		sig[1] = (uint64_t)buf.st_mtim.tv_sec * 1'000'000'000ull + buf.st_mtim.tv_nsec;
+		return true;
+	}
 
-			rtpb::BulkMetadata bulk;
-			if (!bulk.ParseFromIstream(&ifs)) {
-				fmt::print(" - [#decode_node_to_tile] ERROR: failed to parse bulk from istream '{}'!\n", bulkPath);
-				continue;
+	bool parse_bulk(const uint8_t* data, size_t len, BulkResult& out) {
+		rtpb::BulkMetadata bulk;
+		if (!bulk.ParseFromArray(data, len)) return false;
+
+		assert(bulk.head_node_center().size() == 3);
+		Vector3d headNodeCenter = Eigen::Map<const Vector3d>{ &bulk.head_node_center()[0] };
+		assert(bulk.meters_per_texel().size() >= 1);
+		const float* metersPerTexel = &bulk.meters_per_texel()[0];
+		const std::string& headNodePath = bulk.head_node_key().path();
+
+		for (int ni=0; ni<bulk.node_metadata().size(); ni++) {
+			const auto& nodeMeta = bulk.node_metadata()[ni];
+			out.ntotal++;
+
+			// Bulk stores prefix of full node key, node meta stores postfix of that prefix in this bespoke binary int.
+			// Decode that and concat here to get full octree coordinate.
+			uint32_t pathAndFlags = nodeMeta.path_and_flags();
+			uint32_t rlevel = 1 + (pathAndFlags & 3);
+			pathAndFlags >>= 2;
+			std::string rpath;
+			for (uint32_t i=0; i<rlevel; i++) {
+				rpath += '0' + (pathAndFlags & 7);
+				pathAndFlags >>= 3;
 			}
 
-			assert(bulk.head_node_center().size() == 3);
-			Vector3d headNodeCenter = Eigen::Map<const Vector3d>{ &bulk.head_node_center()[0] };
-			// fmt::print("headNodeCenter: {}\n", headNodeCenter.transpose());
-			assert(bulk.meters_per_texel().size() >= 1);
-			const float* metersPerTexel = &bulk.meters_per_texel()[0];
-			std::string headNodePath = bulk.head_node_key().path();
-
-			// fmt::print("{} vs {}\n", bulkPath, headNodePath);
-
-			for (int ni=0; ni<bulk.node_metadata().size(); ni++) {
-				const auto nodeMeta = bulk.node_metadata()[ni];
-				ntotal++;
-
-				// Bulk stores prefix of full node key, node meta stores postfix of that prefix in this bespoke binary int.
-				// Decode that and concat here to get full octree coordinate.
-				uint32_t pathAndFlags = nodeMeta.path_and_flags();
-				uint32_t rlevel = 1 + (pathAndFlags & 3);
-				pathAndFlags >>= 2;
-				std::string rpath;
-				for (uint32_t i=0; i<rlevel; i++) {
-					rpath += '0' + (pathAndFlags & 7);
-					pathAndFlags >>= 3;
-				}
-				uint32_t flags = pathAndFlags;
-
-				std::string key = fmt::format("{}{}", headNodePath, rpath);
+			std::string key = fmt::format("{}{}", headNodePath, rpath);
 
-				// if (!file_exists(fmt::format("{}/node/{}", rootDir, key))) {
-				if (nodeFiles.find(key) == nodeFiles.end()) {
-					// fmt::print("missing node file '{}'\n", fmt::format("{}/node/{}", rootDir, key));
-					nmissingNode++;
-					continue;
-				}
-
-				if (auto pobb_ = decode_obb(key, nodeMeta, headNodeCenter, metersPerTexel[rlevel-1]); pobb_.has_value()) {
-					ngood++;
-					float geoErrorOnLevelUnit = metersPerTexel[rlevel];
-					if (nodeMeta.has_meters_per_texel()) {
-						geoErrorOnLevelUnit = nodeMeta.has_meters_per_texel();
-					}
+			if (auto pobb_ = decode_obb(key, nodeMeta, headNodeCenter, metersPerTexel[rlevel-1]); pobb_.has_value()) {
+				out.items.push_back(BbItem {
+					OctreeCoordinate { key },
+					*pobb_,
+				});
+			} else out.nbadObb++;
+		}
 
-					items.push_back(GearthBoundingBoxMap::Item {
-						OctreeCoordinate { key },
-						*pobb_,
-					});
-				} else nbadObb++;
+		out.ok = true;
+		return true;
+	}
 
+	//
+	// The per-bulk results of the last run, at `<bbPath>.bulks`, so that a rebuild only re-parses the bulks that changed.
+	//     "WGBBBLK1"
+	//     per bulk: { u16 nameLen, char name[nameLen], u64 sig[2], u32 ntotal, u32 nbadObb, u32 nitems, Item items[nitems] }
+	// A truncated or malformed file just loads as many bulks as it can.
+	//
+	constexpr char kBulkCacheMagic[8] = { 'W','G','B','B','B','L','K','1' };
+
+	struct BulkCache {
+		std::unordered_map<std::string, BulkResult> map;
+
+		inline void load(const std::string& path) {
+			std::ifstream ifs(path, std::ios_base::binary);
+			char magic[8];
+			if (!ifs.read(magic, 8) or memcmp(magic, kBulkCacheMagic, 8) != 0) return;
+			ifs.seekg(0, std::ios_base::end);
+			const uint64_t fileSize = ifs.tellg();
+			ifs.seekg(8);
+
+			while (true) {
+				BulkResult r;
+				uint16_t nameLen;
+				uint32_t nitems;
+				if (!ifs.read((char*)&nameLen, sizeof(nameLen))) break;
+				r.name.resize(nameLen);
+				if (!ifs.read(r.name.data(), nameLen)) break;
+				if (!ifs.read((char*)r.sig, sizeof(r.sig))) break;
+				if (!ifs.read((char*)&r.ntotal, 4) or !ifs.read((char*)&r.nbadObb, 4) or !ifs.read((char*)&nitems, 4)) break;
+				// Don't trust `nitems` with an allocation before knowing that the file even has that many.
+				if ((uint64_t)nitems * sizeof(BbItem) > fileSize - (uint64_t)ifs.tellg()) break;
+				r.items.resize(nitems);
+				if (!ifs.read((char*)r.items.data(), nitems * sizeof(BbItem))) break;
+				r.ok = true;
+				std::string name = r.name;
+				map[name] = std::move(r);
 			}
-
 		}
 
-		fmt::print("make_bb_map(ntotal={}, nmissingNode={}, nbadObb={}, ngood={})\n",
-				ntotal, nmissingNode, nbadObb, ngood);
-
-		// exit(1);
-
-        std::ofstream ofs(outPath, std::ios_base::binary);
-        for (const auto& item : items) {
-			ofs.write((const char*)&item, sizeof(GearthBoundingBoxMap::Item));
+		inline static bool write(const std::string& path, const std::vector<BulkResult>& results) {
+			std::string tmpPath = path + ".tmp";
+			{
+				std::ofstream ofs(tmpPath, std::ios_base::binary);
+				ofs.write(kBulkCacheMagic, 8);
+				for (const auto& r : results) {
+					if (!r.ok) continue;
+					uint16_t nameLen = r.name.length();
+					uint32_t nitems  = r.items.size();
+					ofs.write((const char*)&nameLen, sizeof(nameLen));
+					ofs.write(r.name.data(), nameLen);
+					ofs.write((const char*)r.sig, sizeof(r.sig));
+					ofs.write((const char*)&r.ntotal, 4);
+					ofs.write((const char*)&r.nbadObb, 4);
+					ofs.write((const char*)&nitems, 4);
+					ofs.write((const char*)r.items.data(), nitems * sizeof(BbItem));
+				}
+				if (!ofs.good()) return false;
+			}
+			return rename(tmpPath.c_str(), path.c_str()) == 0;
 		}
-        size_t len = ofs.tellp();
-        SPDLOG_INFO("[make_bb_map] wrote '{}', {} entries, {:>5.2f}MB, {}B / item", outPath, items.size(), static_cast<double>(len) / (1 << 20), len/items.size());
-
-		{
-
+	};
 
-		}
+    void make_bb_map(const std::string& outPath, const std::string& rootDir, const GlobeOptions& gopts) {
+		spdlog::get("wg")->warn("making bb file '{}', this may take a while...", outPath);
 
-					/*
-                    // TODO: Map points into ECEF. Then use DLT to find matrix that aligns them.
-                    Matrix<float, S * S, 3> pts = getEcefPointsOfTile(tileTlbr, elevDset);
+		int nthreads = (int)gopts.getDouble("gearthBbThreads", defaultThreadCount());
 
-					Vector3f mid = pts.array().colwise().mean();
+		// If the dataset was packed (see `util/makePackFile.cc`), the keys come from the pack indices, and there is no directory listing at all.
+		PackFile nodePack, bulkPack;
+		bool packed = nodePack.open(fmt::format("{}/node.pack", rootDir)) and bulkPack.open(fmt::format("{}/bulk.pack", rootDir));
+		if (packed) fmt::print("using node.pack & bulk.pack\n");
 
-					Matrix3f R = getSphericalLtp(mid);
+		// `file_exist` may be slow, so instead build hashset of existing node files upfront.
+		std::unordered_set<std::string> nodeFiles;
+		if (packed) {
+			for (const auto& e : nodePack.entries()) nodeFiles.insert(e.key);
+		} else {
+			auto nodeFilesVec = list_dir(fmt::format("{}/node", rootDir));
+			for (auto nodeFile : nodeFilesVec) {
+				std::string nkey = nodeFile.substr(nodeFile.rfind("/")+1);
+				nodeFiles.insert(nkey);
+			}
+		}
+		fmt::print("listed {} node files\n", nodeFiles.size());
+
+		std::vector<std::string> bulks;
+		if (packed) {
+			for (const auto& e : bulkPack.entries()) bulks.push_back(e.key);
+		} else {
+			bulks = list_dir(fmt::format("{}/bulk", rootDir));
+			std::sort(bulks.begin(), bulks.end());
+		}
 
-					pts = pts * R;
+		std::string cachePath = outPath + ".bulks";
+		BulkCache cache;
+		cache.load(cachePath);
+		fmt::print("listed {} bulks, {} in cache '{}', using {} threads\n", bulks.size(), cache.map.size(), cachePath, nthreads);
 
-                    Vector3d lo                 = pts.array().colwise().minCoeff().cast<double>();
-                    Vector3d hi                 = pts.array().colwise().maxCoeff().cast<double>();
+		// Every bulk is independent: parse them all in parallel, each into its own slot.
+		std::vector<BulkResult> results(bulks.size());
+		std::vector<std::vector<uint8_t>> bulkBufs(std::max(nthreads, 1));
+		std::atomic<size_t> ndone = 0, nbytes = 0, ncached = 0;
+		auto st = std::chrono::high_resolution_clock::now();
 
-                    Matrix<double, 4, 3> fourPts;
-                    fourPts << lo(0), lo(1), lo(2), hi(0), lo(1), lo(2), lo(0), hi(1), lo(2), lo(0), lo(1), hi(2);
+		parallelFor(bulks.size(), nthreads, [&](size_t i, int t) {
+			const auto &bulkPath = bulks[i];
+			BulkResult& r = results[i];
+			r.name = bulkPath;
+
+			bool haveSig = bulk_signature(bulkPath, packed ? &bulkPack : nullptr, r.sig);
+			if (auto it = cache.map.find(bulkPath); haveSig and it != cache.map.end() and it->second.sig[0] == r.sig[0] and it->second.sig[1] == r.sig[1]) {
+				r.items     = it->second.items;
+				r.ntotal    = it->second.ntotal;
+				r.nbadObb   = it->second.nbadObb;
+				r.ok        = true;
+				r.fromCache = true;
+				ncached++;
+			} else {
+				auto& bulkBuf = bulkBufs[t];
+				bool read = false;
+				if (packed) {
+					read = bulkPack.read(bulkPath, bulkBuf);
+				} else {
+					std::ifstream ifs(bulkPath, std::ios_base::binary | std::ios_base::ate);
+					if (ifs) {
+						bulkBuf.resize(ifs.tellg());
+						ifs.seekg(0);
+						read = (bool)ifs.read((char*)bulkBuf.data(), bulkBuf.size());
+					}
+				}
 
+				if (not read or not parse_bulk(bulkBuf.data(), bulkBuf.size(), r)) {
+					fmt::print(" - [make_bb_map] ERROR: failed to read/parse bulk '{}'!\n", bulkPath);
+					r.items.clear();
+					r.ok = false;
+				} else {
+					nbytes += bulkBuf.size();
+				}
+				// Do not cache a bulk whose signature is unknown: it would never match anyway.
+				if (not haveSig) r.sig[0] = r.sig[1] = 0;
+			}
 
-                    SolvedTransform T = align_box_dlt(fourPts);
+			size_t n = ++ndone;
+			if (n % 2500 == 0 or n == bulks.size()) {
+				double secs = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - st).count();
+				fmt::print("on bulk {} / {} ({} cached, {:.0f} bulks/s, {:.1f}MB/s parsed)\n", n, bulks.size(), ncached.load(), n / secs, nbytes.load() / secs / (1 << 20));
+			}
+		});
+
+		// Merge, dropping nodes without a node file, then sort by key so that the output does not depend on scheduling.
+		int ntotal = 0, nmissingNode = 0, ngood = 0, nbadObb = 0, nbadBulk = 0;
+		size_t nitems = 0;
+		for (const auto& r : results) nitems += r.items.size();
+		std::vector<BbItem> items;
+		items.reserve(nitems);
+		for (const auto& r : results) {
+			if (not r.ok) nbadBulk++;
+			ntotal  += r.ntotal;
+			nbadObb += r.nbadObb;
+			for (const auto& item : r.items) {
+				if (nodeFiles.find(std::string(item.coord.key, item.coord.keyLen)) == nodeFiles.end()) {
+					nmissingNode++;
+					continue;
+				}
+				items.push_back(item);
+			}
+		}
+		ngood = items.size();
+		std::sort(items.begin(), items.end(), [](const BbItem& a, const BbItem& b) {
+			return std::string_view(a.coord.key, a.coord.keyLen) < std::string_view(b.coord.key, b.coord.keyLen);
+		});
 
-					T.t = R.cast<double>() * T.t;
-					T.q = Quaterniond { R.cast<double>() * T.q };
+		double secs = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - st).count();
+		fmt::print("make_bb_map(ntotal={}, nmissingNode={}, nbadObb={}, nbadBulk={}, ngood={}, ncached={}, {:.1f}s)\n",
+				ntotal, nmissingNode, nbadObb, nbadBulk, ngood, ncached.load(), secs);
 
+		// Written to a temporary first, so that an interrupted rebuild does not leave a truncated bb file behind.
+		{
+			std::string tmpPath = outPath + ".tmp";
+			std::ofstream ofs(tmpPath, std::ios_base::binary);
+			ofs.write((const char*)items.data(), items.size() * sizeof(BbItem));
+			size_t len = ofs.tellp();
+			ofs.close();
+			if (!ofs.good() or rename(tmpPath.c_str(), outPath.c_str()) != 0)
+				throw std::runtime_error(fmt::format("failed to write bb file '{}'", outPath));
+			SPDLOG_INFO("[make_bb_map] wrote '{}', {} entries, {:>5.2f}MB, {}B / item", outPath, items.size(), static_cast<double>(len) / (1 << 20), items.size() ? len/items.size() : 0);
+		}
 
-                    items.push_back(GearthBoundingBoxMap::Item {
-                        OctreeCoordinate { wmTileLevel, y, x },
-                        PackedOrientedBoundingBox { T.t.cast<float>(), T.q.cast<float>().normalized(), T.s.cast<float>(),
-                                            geoErrorOnLevelUnit }
-                    });
-					*/
+		if (!BulkCache::write(cachePath, results))
+			SPDLOG_WARN("[make_bb_map] failed to write bulk cache '{}'", cachePath);
     }
 
 }
@@ -265,7 +404,8 @@ namespace gearth {
 #else
         std::string bbPath = rootDir + "/webgpuGlobe.bb";
 
-        if (file_exists(bbPath)) {
+        // `gearthRebuildBb=1` remakes it anyway, e.g. after more data was downloaded. Only the new or changed bulks are parsed.
+        if (file_exists(bbPath) and gopts.getDouble("gearthRebuildBb", 0) == 0) {
             SPDLOG_INFO("not making bb file, '{}' already exists", bbPath);
             return;
         }
@@ -276,4 +416,3 @@ namespace gearth {
 
 }
 }
-
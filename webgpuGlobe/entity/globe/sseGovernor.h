@@ -0,0 +1,124 @@
+#pragma once
+
+#include "webgpuGlobe/util/options.h"
+
+#include <spdlog/fmt/fmt.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+
+namespace wg {
+
+	//
+	// Picks the screen space error thresholds that tiles open and close at, once per frame, so that a globe stays within
+	// its budgets: work time, resident tiles (the GPU slots) and loads in flight.
+	//
+	// The work time is what the globe itself spends in `render` (uploads, traversal, encoding the draws), measured by the
+	// globe. Not the interval between frames: that includes waiting on vsync / present, so it would sit at the refresh
+	// period whatever the globe does, and hold the thresholds at one end of their range.
+	//
+	// Any budget over its high mark coarsens (raises the thresholds) a step per frame. All of them under their low marks
+	// refines (lowers them), more slowly. In between the thresholds hold, and work time is smoothed first, so that they
+	// do not oscillate. The close threshold keeps its ratio to the open one, which is the hysteresis between the two.
+	//
+	// With `sseGovernor=0` the thresholds stay at `sseOpen` and `sseOpen * sseCloseRatio` (4 and .7 by default, as before).
+	//
+	struct SseGovernor {
+
+		struct Config {
+			bool enabled         = true;
+			float baseOpen       = 4.f;  // `sseOpen`
+			float closeRatio     = .175f; // `sseCloseRatio`: close = open * this
+			float minOpen        = 2.f;  // `sseMin` (default half of `sseOpen`): at most this fine ...
+			float maxOpen        = 32.f; // `sseMax` (default 8x `sseOpen`): ... or this coarse
+			float targetWorkMs   = 8.f;  // `sseTargetWorkMs`
+			float maxResident    = .85f; // `sseMaxResident`: fraction of the tile slots
+			int maxLoads         = 24;   // `sseMaxLoads`: requests in flight
+			float lowMark        = .7f;  // fraction of each budget below which it has room to refine
+			float coarsenStep    = .04f; // relative change per frame
+			float refineStep     = .01f;
+			float workSmoothing  = .1f;  // weight of the newest work time
+		};
+
+		// Everything the controller knows, for tuning (the globes log `summary()` at debugLevel >= 1).
+		struct State {
+			float openThresh  = 4.f;
+			float closeThresh = .7f;
+			float workMs      = 0; // smoothed
+			int resident      = 0;
+			int capacity      = 0;
+			int loads         = 0;
+			// Each budget's use over its limit: over 1 coarsens, all under `lowMark` refines.
+			float workPressure = 0, residentPressure = 0, loadPressure = 0;
+			int direction       = 0; // +1 coarsening, -1 refining, 0 holding
+			uint64_t frames     = 0;
+		};
+
+		inline SseGovernor() {
+			reset();
+		}
+
+		inline explicit SseGovernor(const GlobeOptions& opts) {
+			config.enabled       = opts.getDouble("sseGovernor", 1) != 0;
+			config.baseOpen      = opts.getDouble("sseOpen", config.baseOpen);
+			config.closeRatio    = opts.getDouble("sseCloseRatio", config.closeRatio);
+			config.minOpen       = std::min<float>(opts.getDouble("sseMin", config.baseOpen * .5), config.baseOpen);
+			config.maxOpen       = std::max<float>(opts.getDouble("sseMax", config.baseOpen * 8), config.baseOpen);
+			config.targetWorkMs  = opts.getDouble("sseTargetWorkMs", config.targetWorkMs);
+			config.maxResident   = opts.getDouble("sseMaxResident", config.maxResident);
+			config.maxLoads      = opts.getDouble("sseMaxLoads", config.maxLoads);
+			reset();
+		}
+
+		inline void reset() {
+			st             = State {};
+			st.openThresh  = config.baseOpen;
+			st.closeThresh = config.baseOpen * config.closeRatio;
+		}
+
+		// Once per frame, with the globe's work time of the last one. Returns the thresholds to traverse with.
+		inline const State& update(float workMs, int resident, int capacity, int loads) {
+			st.frames++;
+			st.workMs   = st.frames == 1 ? workMs : st.workMs + (workMs - st.workMs) * config.workSmoothing;
+			st.resident = resident;
+			st.capacity = capacity;
+			st.loads    = loads;
+			if (not config.enabled) return st;
+
+			st.workPressure     = st.workMs / config.targetWorkMs;
+			st.residentPressure = capacity > 0 ? resident / (capacity * config.maxResident) : 0;
+			st.loadPressure     = (float)loads / std::max(config.maxLoads, 1);
+
+			float worst = std::max({ st.workPressure, st.residentPressure, st.loadPressure });
+			if (worst > 1) {
+				st.direction  = 1;
+				st.openThresh = st.openThresh * (1 + config.coarsenStep);
+			} else if (worst < config.lowMark) {
+				st.direction  = -1;
+				st.openThresh = st.openThresh / (1 + config.refineStep);
+			} else {
+				st.direction = 0;
+			}
+			st.openThresh  = std::clamp(st.openThresh, config.minOpen, config.maxOpen);
+			st.closeThresh = st.openThresh * config.closeRatio;
+			return st;
+		}
+
+		inline const State& state() const {
+			return st;
+		}
+
+		inline std::string summary() const {
+			return fmt::format("sse open {:.2f} close {:.2f} (dir {:+d}) | work {:.1f}ms ({:.2f}) tiles {}/{} ({:.2f}) loads {} ({:.2f})", st.openThresh,
+							   st.closeThresh, st.direction, st.workMs, st.workPressure, st.resident, st.capacity, st.residentPressure, st.loads,
+							   st.loadPressure);
+		}
+
+		Config config;
+
+		private:
+		State st;
+	};
+
+}
@@ -0,0 +1,121 @@
+#include "tiff.h"
+#include "tileBuilder.hpp"
+#include "tileCache.hpp"
+
+#include "util/options.h"
+#include "util/packFile.h"
+#include "util/parallel.h"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+
+//
+// Bakes every tile of a tiff dataset into the tile cache `<tiffPath>.tiles` (see `tileCache.hpp`),
+// so that `DiskTiffDataLoader` never has to touch GDAL for them.
+//
+// Takes the same `key=value` options as the app:
+//     tiffPath, dtedPath, colorMult, tiffTerrainMode, tiffGridSize
+// plus
+//     bakeThreads=N    worker threads (default: one per core)
+//     bakeOverwrite=1  start over, rather than add to an existing cache
+//
+// It is resumable: tiles already in the cache are skipped, so after an interruption (or failed reads) just run it again.
+// Every tile already in the cache must have been baked with the same options and source rasters (see `TiffBakeParams`),
+// otherwise it refuses to add to it.
+//
+
+namespace wg {
+namespace tiff {
+    void maybe_make_tiff_bb_file(const std::string& tiffPath, const GlobeOptions& gopts);
+}
+}
+
+using namespace wg;
+using namespace wg::tiff;
+
+int main(int argc, const char** argv) {
+	GlobeOptions opts = parseArgs(argv, argc);
+
+	std::string tiffPath  = opts.getString("tiffPath");
+	std::string cachePath = tileCachePath(tiffPath);
+	int nthreads          = (int)opts.getDouble("bakeThreads", defaultThreadCount());
+	bool overwrite        = opts.getDouble("bakeOverwrite", 0) != 0;
+
+	maybe_make_tiff_bb_file(tiffPath, opts);
+	TiffBoundingBoxMap bbMap(tiffPath + ".bb", opts);
+
+	// The builder leases GDAL handles per tile (see `GdalDatasetPool`), so one is enough for all threads.
+	TiffTileBuilder builder(opts);
+	const TiffBakeParams params = tiffBakeParams(builder.terrainMode, builder.gridSize, builder.colorMult, builder.adaptiveErrorScale, builder.colorPath, builder.dtedPath);
+
+	// Skip what is already baked. But a cache baked (even in part) with other options or sources would be useless to add to.
+	PackFile existing;
+	if (not overwrite and existing.open(cachePath)) {
+		std::vector<uint8_t> hdr;
+		size_t nstale = 0;
+		for (const auto& e : existing.entries())
+			if (not existing.readPrefix(e, sizeof(TiffBakedTileHeader), hdr) or not bakedTileMatches(hdr.data(), hdr.size(), params)) nstale++;
+		if (nstale > 0) {
+			SPDLOG_ERROR("{} of the {} tiles in '{}' were baked with other tiffTerrainMode / tiffGridSize / colorMult / tiffAdaptiveErrorScale or source files. Delete it or pass bakeOverwrite=1.",
+						 nstale, existing.entries().size(), cachePath);
+			return 1;
+		}
+	}
+
+	std::vector<std::pair<QuadtreeCoordinate, PackedOrientedBoundingBox>> todo;
+	for (const auto& it : bbMap.map) {
+		if (existing.isOpen() and existing.find(tileCacheKey(it.first))) continue;
+		todo.push_back({ it.first, it.second.packed });
+	}
+	// Coarse levels first, then row major: deterministic, and neighbouring tiles read neighbouring parts of the rasters.
+	std::sort(todo.begin(), todo.end(), [](const auto& a, const auto& b) {
+		if (a.first.z() != b.first.z()) return a.first.z() < b.first.z();
+		if (a.first.y() != b.first.y()) return a.first.y() < b.first.y();
+		return a.first.x() < b.first.x();
+	});
+	SPDLOG_INFO("[bakeTiles] {} tiles in bb file, {} already baked, {} to go, {} threads", bbMap.map.size(), bbMap.map.size() - todo.size(), todo.size(), nthreads);
+	existing.close();
+
+	PackFileWriter writer;
+	if (not writer.open(cachePath, not overwrite)) {
+		SPDLOG_ERROR("could not open '{}' for writing", cachePath);
+		return 1;
+	}
+
+	std::mutex writeMtx;
+	std::atomic<size_t> ndone = 0, nfailed = 0, nbytes = 0;
+	auto st = std::chrono::high_resolution_clock::now();
+
+	parallelFor(todo.size(), nthreads, [&](size_t i, int) {
+		const auto& [coord, obb] = todo[i];
+
+		// A tile that failed to read is left out of the cache (and counted as failed), so that the next run retries it.
+		TileData item;
+		if (builder.build(item, coord, &obb)) {
+			std::vector<uint8_t> blob;
+			encodeBakedTile(item, params, blob);
+
+			{
+				std::lock_guard<std::mutex> lck(writeMtx);
+				if (not writer.add(tileCacheKey(coord), blob.data(), blob.size())) nfailed++;
+			}
+			nbytes += blob.size();
+		} else {
+			SPDLOG_WARN("[bakeTiles] GDAL failed to read tile {}, not baking it", tileCacheKey(coord));
+			nfailed++;
+		}
+
+		size_t n = ++ndone;
+		if (n % 1000 == 0 or n == todo.size()) {
+			double secs = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - st).count();
+			SPDLOG_INFO("[bakeTiles] {} / {} ({:.1f} tiles/s, {:.1f}MB)", n, todo.size(), n / secs, nbytes.load() / double(1 << 20));
+		}
+	});
+
+	writer.close();
+	SPDLOG_INFO("[bakeTiles] done, wrote '{}' ({} failed)", cachePath, nfailed.load());
+	return nfailed == 0 ? 0 : 1;
+}
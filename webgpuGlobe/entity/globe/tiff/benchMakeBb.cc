@@ -0,0 +1,136 @@
+#include "tiff.h"
+
+#include "util/gdalDataset.h"
+#include "util/options.h"
+#include "util/parallel.h"
+
+#include <fmt/core.h>
+
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+//
+// Times the tiff bb file builder (`make_bb_map` in `makeBbFile.cc`) with 1, 2, 4, ... threads,
+// on a synthetic GeoTIFF pair it writes first, and checks that every thread count writes the same bytes.
+//
+//     benchMakeBb <outDir> [sizePx=16384] [maxThreads=ncores]
+//
+// Both tiffs cover the same ~156km square in EPSG:3857 and are tiled. The color is `sizePx` square (~10m/pixel at the default),
+// the DTED a quarter of that.
+//
+
+namespace wg {
+namespace tiff {
+    void make_tiff_bb_file(const std::string& bbPath, const std::string& tiffPath, const GlobeOptions& gopts);
+}
+}
+
+using namespace wg;
+
+namespace {
+
+	// 3857 WKT, so that this does not depend on the proj database being found.
+	constexpr const char* kWebMercatorWkt =
+		"PROJCS[\"WGS 84 / Pseudo-Mercator\",GEOGCS[\"WGS 84\",DATUM[\"WGS_1984\",SPHEROID[\"WGS 84\",6378137,298.257223563]],"
+		"PRIMEM[\"Greenwich\",0],UNIT[\"degree\",0.0174532925199433]],PROJECTION[\"Mercator_1SP\"],PARAMETER[\"central_meridian\",0],"
+		"PARAMETER[\"scale_factor\",1],PARAMETER[\"false_easting\",0],PARAMETER[\"false_northing\",0],UNIT[\"metre\",1],"
+		"EXTENSION[\"PROJ4\",\"+proj=merc +a=6378137 +b=6378137 +lat_ts=0 +lon_0=0 +x_0=0 +y_0=0 +k=1 +units=m +nadgrids=@null +wktext +no_defs\"],"
+		"AUTHORITY[\"EPSG\",\"3857\"]]";
+
+	// Somewhere around 38N 77W.
+	constexpr double kOriginX = -8571600, kOriginY = 4579400;
+	constexpr double kExtent = 9.55 * 16384;
+
+	bool write_synthetic_tiff(const std::string& path, int size, int nbands, GDALDataType type) {
+		GDALAllRegister();
+		GDALDriver* drv = GetGDALDriverManager()->GetDriverByName("GTiff");
+		if (drv == nullptr) return false;
+
+		char** createOpts = nullptr;
+		createOpts = CSLSetNameValue(createOpts, "TILED", "YES");
+		GDALDataset* dset = drv->Create(path.c_str(), size, size, nbands, type, createOpts);
+		CSLDestroy(createOpts);
+		if (dset == nullptr) return false;
+
+		// The extent is fixed, so the DTED covers the color exactly, and `sizePx` only changes the resolution.
+		double pix = kExtent / size;
+		double gt[6] = { kOriginX, pix, 0, kOriginY, 0, -pix };
+		dset->SetGeoTransform(gt);
+		dset->SetProjection(kWebMercatorWkt);
+
+		// Row by row: some smooth hills for the DTED, a gradient for the color.
+		int eleSize = type == GDT_Int16 ? 2 : 1;
+		std::vector<uint8_t> row(size * eleSize);
+		bool ok = true;
+		for (int b = 0; b < nbands and ok; b++) {
+			for (int y = 0; y < size and ok; y++) {
+				for (int x = 0; x < size; x++) {
+					if (type == GDT_Int16)
+						((int16_t*)row.data())[x] = (int16_t)(800 + 600 * std::sin(x * 12.0 / size) * std::cos(y * 9.0 / size));
+					else
+						row[x] = (uint8_t)((x + y * (b + 1)) & 255);
+				}
+				ok = dset->GetRasterBand(b + 1)->RasterIO(GF_Write, 0, y, size, 1, row.data(), size, 1, type, 0, 0) == CE_None;
+			}
+		}
+
+		GDALClose(dset);
+		return ok;
+	}
+
+	std::vector<char> read_all(const std::string& path) {
+		std::ifstream ifs(path, std::ios_base::binary);
+		return std::vector<char>(std::istreambuf_iterator<char>(ifs), {});
+	}
+
+}
+
+int main(int argc, char** argv) {
+	if (argc < 2) {
+		fmt::print("Usage: {} <outDir> [sizePx=16384] [maxThreads=ncores]\n", argv[0]);
+		return 1;
+	}
+
+	std::string outDir = argv[1];
+	int size           = argc > 2 ? std::atoi(argv[2]) : 16384;
+	int maxThreads     = argc > 3 ? std::atoi(argv[3]) : defaultThreadCount();
+
+	std::string colorPath = outDir + "/benchMakeBb.color.tif";
+	std::string dtedPath  = outDir + "/benchMakeBb.dted.tif";
+
+	fmt::print("writing synthetic tiffs ({0}x{0} color, {1}x{1} dted) to '{2}'\n", size, size / 4, outDir);
+	if (not write_synthetic_tiff(colorPath, size, 3, GDT_Byte) or not write_synthetic_tiff(dtedPath, size / 4, 1, GDT_Int16)) {
+		fmt::print("failed to write synthetic tiffs\n");
+		return 1;
+	}
+
+	GlobeOptions opts;
+	opts.opts["dtedPath"] = dtedPath;
+
+	std::vector<char> reference;
+	double secs1 = 0;
+	bool allSame = true;
+
+	for (int nthreads = 1; nthreads <= maxThreads; nthreads = nthreads == maxThreads ? maxThreads + 1 : std::min(nthreads * 2, maxThreads)) {
+		std::string bbPath = fmt::format("{}/benchMakeBb.{}.bb", outDir, nthreads);
+		opts.opts["tiffBbThreads"] = (double)nthreads;
+
+		auto st = std::chrono::high_resolution_clock::now();
+		tiff::make_tiff_bb_file(bbPath, colorPath, opts);
+		double secs = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - st).count();
+
+		std::vector<char> bytes = read_all(bbPath);
+		size_t nitems = bytes.size() / sizeof(tiff::TiffBoundingBoxMap::Item);
+		if (nthreads == 1) reference = bytes, secs1 = secs;
+		bool same = bytes == reference;
+		allSame &= same;
+
+		fmt::print("threads {:>3d}: {:>8.3f}s {:>10.0f} tiles/s  speedup {:>5.2f}x  {}\n", nthreads, secs, nitems / secs, secs1 / secs,
+				   same ? "(same output)" : "(OUTPUT DIFFERS)");
+	}
+
+	return allSame ? 0 : 1;
+}
@@ -7,6 +7,7 @@
 
 #include <wgpu/wgpu.h>
 #include <unistd.h>
+#include <cstddef>
 
 namespace wg {
     namespace tiff {
@@ -17,6 +18,10 @@ namespace wg {
             freeTileInds.resize(MAX_TILES);
             for (int i = 0; i < MAX_TILES; i++) freeTileInds[i] = i;
 
+            terrainMode = parseTiffTerrainMode(opts.getString("tiffTerrainMode", "mesh"));
+            gridSize    = tiffGridSizeOption(opts, terrainMode);
+            if (gridSize < 2 or gridSize > 256) throw std::runtime_error("tiffGridSize must be in [2, 256] (indices are uint16)");
+
             // ------------------------------------------------------------------------------------------------------------------------------------------
             //     Texture & Sampler
             // ------------------------------------------------------------------------------------------------------------------------------------------
@@ -63,17 +68,99 @@ namespace wg {
                 .aspect          = WGPUTextureAspect_All,
             });
 
+            // Only heightmap mode reads it, the others bind a single texel per tile.
+            const uint32_t heightTexSize = terrainMode == TiffTerrainMode::Heightmap ? gridSize : 1;
+            heightTex     = ao.device.create(WGPUTextureDescriptor {
+                    .nextInChain     = nullptr,
+                    .label           = "TiffGlobeHeightArray",
+                    .usage           = WGPUTextureUsage_CopyDst | WGPUTextureUsage_TextureBinding,
+                    .dimension       = WGPUTextureDimension_2D,
+                    .size            = WGPUExtent3D { heightTexSize, heightTexSize, MAX_TILES },
+                    .format          = WGPUTextureFormat_R32Float,
+                    .mipLevelCount   = 1,
+                    .sampleCount     = 1,
+                    .viewFormatCount = 0,
+                    .viewFormats     = 0
+            });
+
+            heightTexView = heightTex.createView(WGPUTextureViewDescriptor {
+                .nextInChain     = nullptr,
+                .label           = "TiffRenderer_heightTexView",
+                .format          = WGPUTextureFormat_R32Float,
+                .dimension       = WGPUTextureViewDimension_2DArray,
+                .baseMipLevel    = 0,
+                .mipLevelCount   = 1,
+                .baseArrayLayer  = 0,
+                .arrayLayerCount = MAX_TILES,
+                .aspect          = WGPUTextureAspect_All,
+            });
+
+            // ------------------------------------------------------------------------------------------------------------------------------------------
+            //     Per-tile data & shared grid indices
+            // ------------------------------------------------------------------------------------------------------------------------------------------
+
+            tileDataBuffer = ao.device.create(WGPUBufferDescriptor {
+                    .nextInChain      = nullptr,
+                    .label            = "TiffTileDataBuffer",
+                    .usage            = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Storage,
+                    .size             = MAX_TILES * sizeof(TileShaderData),
+                    .mappedAtCreation = false,
+            });
+            coveredMasks.assign(MAX_TILES, 0);
+
+            const uint32_t E = gridSize;
+            std::vector<uint16_t> inds;
+            inds.reserve((E-1)*(E-1)*3*2);
+            for (uint16_t y=0; y < E-1; y++) {
+                for (uint16_t x=0; x < E-1; x++) {
+                    uint16_t a = (y  ) * E + (x  );
+                    uint16_t b = (y  ) * E + (x+1);
+                    uint16_t c = (y+1) * E + (x+1);
+                    uint16_t d = (y+1) * E + (x  );
+
+                    inds.push_back(a);
+                    inds.push_back(b);
+                    inds.push_back(c);
+
+                    inds.push_back(c);
+                    inds.push_back(d);
+                    inds.push_back(a);
+                }
+            }
+            createIbo_(gridIbo, ao, (const uint8_t*)inds.data(), inds.size() * sizeof(uint16_t));
+            gridIndexCount = inds.size();
+
             createMainPipeline();
             createCastPipeline();
         }
 
+        std::string GpuResources::assembleShader(const char* body) const {
+            std::string src = shaderPrelude;
+            src += terrainMode == TiffTerrainMode::Heightmap ? shaderVertexFetchHeightmap : shaderVertexFetchMesh;
+            src += body;
+            return src;
+        }
+
+        void GpuResources::writeTileData(int32_t ind, const TileShaderData& data) {
+            assert(ind >= 0 and ind < MAX_TILES);
+            ao.queue.writeBuffer(tileDataBuffer, ind * sizeof(TileShaderData), &data, sizeof(TileShaderData));
+            coveredMasks[ind] = data.coveredMask;
+        }
+
+        void GpuResources::writeTileCoveredMask(int32_t ind, uint32_t mask) {
+            assert(ind >= 0 and ind < MAX_TILES);
+            if (coveredMasks[ind] == mask) return;
+            ao.queue.writeBuffer(tileDataBuffer, ind * sizeof(TileShaderData) + offsetof(TileShaderData, coveredMask), &mask, sizeof(mask));
+            coveredMasks[ind] = mask;
+        }
+
         void GpuResources::createMainPipeline() {
 
             // ------------------------------------------------------------------------------------------------------------------------------------------
             //     BindGroupLayout & BindGroup
             // ------------------------------------------------------------------------------------------------------------------------------------------
 
-            WGPUBindGroupLayoutEntry sharedTexLayoutEntries[2] = {
+            WGPUBindGroupLayoutEntry sharedTexLayoutEntries[4] = {
                 {
                  .nextInChain    = nullptr,
                  .binding        = 0,
@@ -95,11 +182,35 @@ namespace wg {
                  .texture        = { .nextInChain = nullptr, .sampleType = WGPUTextureSampleType_Undefined },
                  .storageTexture = { .nextInChain = nullptr, .access = WGPUStorageTextureAccess_Undefined },
                  },
+                {
+                 .nextInChain    = nullptr,
+                 .binding        = 2,
+                 .visibility     = WGPUShaderStage_Vertex,
+                 .buffer         = WGPUBufferBindingLayout { .nextInChain      = nullptr,
+                 .type             = WGPUBufferBindingType_ReadOnlyStorage,
+                 .hasDynamicOffset = false,
+                 .minBindingSize   = 0 },
+                 .sampler        = { .nextInChain = nullptr, .type = WGPUSamplerBindingType_Undefined },
+                 .texture        = { .nextInChain = nullptr, .sampleType = WGPUTextureSampleType_Undefined },
+                 .storageTexture = { .nextInChain = nullptr, .access = WGPUStorageTextureAccess_Undefined },
+                 },
+                {
+                 .nextInChain    = nullptr,
+                 .binding        = 3,
+                 .visibility     = WGPUShaderStage_Vertex,
+                 .buffer         = WGPUBufferBindingLayout { .nextInChain = nullptr, .type = WGPUBufferBindingType_Undefined },
+                 .sampler        = { .nextInChain = nullptr, .type = WGPUSamplerBindingType_Undefined },
+                 .texture        = { .nextInChain   = nullptr,
+                 .sampleType    = WGPUTextureSampleType_UnfilterableFloat,
+                 .viewDimension = WGPUTextureViewDimension_2DArray,
+                 .multisampled  = false },
+                 .storageTexture = { .nextInChain = nullptr, .access = WGPUStorageTextureAccess_Undefined },
+                 },
             };
             sharedBindGroupLayout              = ao.device.create(WGPUBindGroupLayoutDescriptor {
-                             .nextInChain = nullptr, .label = "TiffRendererSharedBGL", .entryCount = 2, .entries = sharedTexLayoutEntries });
+                             .nextInChain = nullptr, .label = "TiffRendererSharedBGL", .entryCount = 4, .entries = sharedTexLayoutEntries });
 
-            WGPUBindGroupEntry groupEntries[2] = {
+            WGPUBindGroupEntry groupEntries[4] = {
                 { .nextInChain = nullptr,
                  .binding     = 0,
                  .buffer      = 0,
@@ -108,18 +219,26 @@ namespace wg {
                  .sampler     = nullptr,
                  .textureView = sharedTexView                                                                                    },
                 { .nextInChain = nullptr, .binding = 1, .buffer = 0, .offset = 0, .size = 0, .sampler = sampler, .textureView = 0 },
+                { .nextInChain = nullptr,
+                 .binding     = 2,
+                 .buffer      = tileDataBuffer,
+                 .offset      = 0,
+                 .size        = MAX_TILES * sizeof(TileShaderData),
+                 .sampler     = nullptr,
+                 .textureView = nullptr },
+                { .nextInChain = nullptr, .binding = 3, .buffer = 0, .offset = 0, .size = 0, .sampler = nullptr, .textureView = heightTexView },
             };
             sharedBindGroup = ao.device.create(WGPUBindGroupDescriptor { .nextInChain = nullptr,
                                                                          .label       = "TiffRendererSharedBG",
                                                                          .layout      = sharedBindGroupLayout,
-                                                                         .entryCount  = 2,
+                                                                         .entryCount  = 4,
                                                                          .entries     = groupEntries });
 
             // ------------------------------------------------------------------------------------------------------------------------------------------
             //     Shader
             // ------------------------------------------------------------------------------------------------------------------------------------------
 
-            ShaderModule shader { create_shader(ao.device, shaderSource, "tiffRendererShader") };
+            ShaderModule shader { create_shader(ao.device, assembleShader(shaderSource).c_str(), "tiffRendererShader") };
 
             // ------------------------------------------------------------------------------------------------------------------------------------------
             //     RenderPipeline & Layout
@@ -136,30 +255,27 @@ namespace wg {
                      .bindGroupLayouts     = bgls,
             });
 
-            WGPUVertexAttribute attributes[3] = {
+            // `TiffPackedVertex`
+            WGPUVertexAttribute attributes[2] = {
                 WGPUVertexAttribute {
-                                     .format         = WGPUVertexFormat_Float32x3,
-                                     .offset         = 0 * sizeof(float),
+                                     .format         = WGPUVertexFormat_Snorm16x4,
+                                     .offset         = offsetof(TiffPackedVertex, x),
                                      .shaderLocation = 0,
                                      },
                 WGPUVertexAttribute {
-                                     .format         = WGPUVertexFormat_Float32x2,
-                                     .offset         = 3 * sizeof(float),
+                                     .format         = WGPUVertexFormat_Unorm16x2,
+                                     .offset         = offsetof(TiffPackedVertex, u),
                                      .shaderLocation = 1,
                                      },
-                WGPUVertexAttribute {
-                                     .format         = WGPUVertexFormat_Float32x3,
-                                     .offset         = 5 * sizeof(float),
-                                     .shaderLocation = 2,
-                                     },
             };
             WGPUVertexBufferLayout vbl {
-                .arrayStride    = (3 + 2 + 3) * sizeof(float),
+                .arrayStride    = sizeof(TiffPackedVertex),
                 .stepMode       = WGPUVertexStepMode_Vertex,
-                .attributeCount = 3,
+                .attributeCount = 2,
                 .attributes     = attributes,
             };
-            auto vertexState       = WGPUVertexState_Default(shader, vbl);
+            // In heightmap mode there is no vertex buffer at all.
+            auto vertexState       = terrainMode == TiffTerrainMode::Heightmap ? WGPUVertexState_Default(shader) : WGPUVertexState_Default(shader, vbl);
 
             auto primState         = WGPUPrimitiveState_Default();
             auto multisampleState  = WGPUMultisampleState_Default();
@@ -187,7 +303,7 @@ namespace wg {
             //     Shader
             // ------------------------------------------------------------------------------------------------------------------------------------------
 
-            ShaderModule shader { create_shader(ao.device, shaderSourceCast, "tiffRendererCastShader") };
+            ShaderModule shader { create_shader(ao.device, assembleShader(shaderSourceCast).c_str(), "tiffRendererCastShader") };
 
             // ------------------------------------------------------------------------------------------------------------------------------------------
             //     BindGroupLayout
@@ -212,30 +328,27 @@ namespace wg {
                      .bindGroupLayouts     = bgls,
             });
 
-            WGPUVertexAttribute attributes[3] = {
+            // `TiffPackedVertex`
+            WGPUVertexAttribute attributes[2] = {
                 WGPUVertexAttribute {
-                                     .format         = WGPUVertexFormat_Float32x3,
-                                     .offset         = 0 * sizeof(float),
+                                     .format         = WGPUVertexFormat_Snorm16x4,
+                                     .offset         = offsetof(TiffPackedVertex, x),
                                      .shaderLocation = 0,
                                      },
                 WGPUVertexAttribute {
-                                     .format         = WGPUVertexFormat_Float32x2,
-                                     .offset         = 3 * sizeof(float),
+                                     .format         = WGPUVertexFormat_Unorm16x2,
+                                     .offset         = offsetof(TiffPackedVertex, u),
                                      .shaderLocation = 1,
                                      },
-                WGPUVertexAttribute {
-                                     .format         = WGPUVertexFormat_Float32x3,
-                                     .offset         = 5 * sizeof(float),
-                                     .shaderLocation = 2,
-                                     },
             };
             WGPUVertexBufferLayout vbl {
-                .arrayStride    = (3 + 2 + 3) * sizeof(float),
+                .arrayStride    = sizeof(TiffPackedVertex),
                 .stepMode       = WGPUVertexStepMode_Vertex,
-                .attributeCount = 3,
+                .attributeCount = 2,
                 .attributes     = attributes,
             };
-            auto vertexState       = WGPUVertexState_Default(shader, vbl);
+            // In heightmap mode there is no vertex buffer at all.
+            auto vertexState       = terrainMode == TiffTerrainMode::Heightmap ? WGPUVertexState_Default(shader) : WGPUVertexState_Default(shader, vbl);
 
             auto primState         = WGPUPrimitiveState_Default();
             auto multisampleState  = WGPUMultisampleState_Default();
@@ -8,15 +8,44 @@
 namespace wg {
 namespace tiff {
 
+	// Per-tile data read by the vertex shader from a storage buffer, indexed by the tile's texture array index (`instance_index`).
+	// Must match `TileData` in `shader.hpp` and `shader_cast.hpp`.
+	struct TileShaderData {
+		float model[16];  // see `TileData::model`, mesh mode only
+		float tlbrUwm[4]; // see `TileData::tlbrUwm`, heightmap mode only
+		// Heightmap mode only: cos and sin of the longitude of the middle of `tlbrUwm`, and exp(pi * its y), in double.
+		// The vertex shader converts relative to them (see `shaderVertexFetchHeightmap`).
+		float centerTrig[4];
+		// While the tile is opening: bit q set if the children of uv quadrant q have arrived and draw in its place,
+		// q = (u >= .5) | (v < .5) << 1 (the bit of a child coordinate is `(x & 1) | (y & 1) << 1`). See `Tile::coveredMask`.
+		uint32_t coveredMask;
+		uint32_t pad[3];
+	};
+	static_assert(sizeof(TileShaderData) == 112);
 
     struct GpuResources {
         Texture sharedTex;
         TextureView sharedTexView;
 
+        // R32Float, `gridSize` x `gridSize` x `MAX_TILES`. Only written to in heightmap mode, but always bound (1 x 1 in the other modes).
+        Texture heightTex;
+        TextureView heightTexView;
+
+        // See `TiffTerrainMode`.
+        TiffTerrainMode terrainMode = TiffTerrainMode::Mesh;
+        uint32_t gridSize = kDefaultTileGridSize;
+
         Sampler sampler;
 
         std::vector<int32_t> freeTileInds;
 
+        // `MAX_TILES` entries of `TileShaderData`.
+        Buffer tileDataBuffer;
+
+        // All tiles are the same `gridSize` x `gridSize` grid, so they share one index buffer. (Except in adaptive mode, where each tile has its own)
+        Buffer gridIbo;
+        uint32_t gridIndexCount = 0;
+
 		// ---------------------------------------------------------------------------------------------------
 		// Main Pipeline
 		// Created in ctor.
@@ -49,6 +78,9 @@ namespace tiff {
 
         GpuResources(AppObjects& ao, const GlobeOptions& opts);
 
+        // What each `tileDataBuffer` entry's `coveredMask` is, so that only changes are written.
+        std::vector<uint32_t> coveredMasks;
+
         inline int32_t takeTileInd() {
             if (freeTileInds.size() == 0) {
                 throw NoTilesAvailableExecption {};
@@ -64,6 +96,13 @@ namespace tiff {
 			assert(freeTileInds.size() <= MAX_TILES);
 		}
 
+        void writeTileData(int32_t ind, const TileShaderData& data);
+        // Just the `coveredMask` of a tile's entry, if it changed.
+        void writeTileCoveredMask(int32_t ind, uint32_t mask);
+
+        // Prelude + the vertex fetch part for `terrainMode` + `body`, see `shader.hpp`.
+        std::string assembleShader(const char* body) const;
+
     };
 
 }
@@ -1,6 +1,14 @@
 #pragma once
 namespace {
-    static const char* shaderSource = R"(
+
+	//
+	// The tiff shaders are assembled from three parts (see `GpuResources::createMainPipeline`):
+	//     shaderPrelude + (shaderVertexFetchMesh | shaderVertexFetchHeightmap) + (shaderSource | shaderSourceCast)
+	// The vertex fetch part defines `VertexInput` and `fetchVertex`, which yields the ECEF position, uv and texture index
+	// of a vertex, either from the tile's vertex buffer or from its height texture layer.
+	//
+
+    static const char* shaderPrelude = R"(
 
 struct SceneCameraData {
 	mvp: mat4x4<f32>,
@@ -24,36 +32,150 @@ var<uniform> scd: SceneCameraData;
 @group(1) @binding(0) var sharedTex: texture_2d_array<f32>;
 @group(1) @binding(1) var sharedSampler: sampler;
 
+// Must match `TileShaderData` in `resources.h`.
+struct TileData {
+	model: mat4x4<f32>,
+	tlbrUwm: vec4f,
+	centerTrig: vec4f,
+	coveredMask: u32,
+	pad0: u32,
+	pad1: u32,
+	pad2: u32,
+}
+@group(1) @binding(2) var<storage, read> tileDatas: array<TileData>;
+@group(1) @binding(3) var heightTex: texture_2d_array<f32>;
+
+struct TileVertex {
+	pos: vec3f,
+	uv: vec2f,
+	tex_index: u32,
+}
+
+// While a tile opens, its children draw over the quadrants they have arrived for: the tile skips those.
+// The bits are as in `TileShaderData::coveredMask`.
+fn quadrantCovered(mask: u32, uv: vec2f) -> bool {
+	let q = select(0u, 1u, uv.x >= .5) | select(0u, 2u, uv.y < .5);
+	return ((mask >> q) & 1u) != 0u;
+}
+
+)";
+
+	//
+	// NOTE: Both of these use the trick of encoding the tile's texture array index as `instance_index`.
+	//
+
+    static const char* shaderVertexFetchMesh = R"(
 
 struct VertexInput {
 	@builtin(instance_index) instance_index: u32,
-    @location(0) position: vec3<f32>,
+    @location(0) position: vec4<f32>, // quantized to the tile's frame
     @location(1) uv: vec2<f32>,
-    @location(2) normal: vec3<f32>,
 };
 
+fn fetchVertex(vi: VertexInput) -> TileVertex {
+	var tv : TileVertex;
+	tv.pos = (tileDatas[vi.instance_index].model * vec4(vi.position.xyz, 1.)).xyz;
+	tv.uv = vi.uv;
+	tv.tex_index = vi.instance_index;
+	return tv;
+}
+
+)";
+
+	// There is no vertex buffer: `vertex_index` is the position in the shared grid, which is displaced by the height texture.
+	// The height layer has one texel per grid vertex, rows going north to south (like the color texture).
+    static const char* shaderVertexFetchHeightmap = R"(
+
+struct VertexInput {
+	@builtin(instance_index) instance_index: u32,
+	@builtin(vertex_index) vertex_index: u32,
+};
+
+const PI = 3.141592653589793;
+const WebMercatorScale = 20037508.342789248;
+const e2 = 0.00669437999014133;
+const b2_over_a2 = 0.9933056200098587;
+
+// sin and cos of a small angle, by their series: good to 4e-6 for |d| < 1.6 (every level but 0), and to f32 rounding
+// from level 2 down. The builtins are only promised to 2^-11, which is kilometers on the ground.
+fn sincos_small(d: f32) -> vec2f {
+	let d2 = d * d;
+	let s = d * (1. - d2 / 6. * (1. - d2 / 20. * (1. - d2 / 42. * (1. - d2 / 72.))));
+	let c = 1. - d2 / 2. * (1. - d2 / 12. * (1. - d2 / 30. * (1. - d2 / 56. * (1. - d2 / 90.))));
+	return vec2f(s, c);
+}
+
+// `unit_wm_to_ecef` of `geo/conversions.cc`, relative to the tile's center: `d` is the offset from it, in unit WM,
+// and `center` is the tile's `centerTrig`. No trig of absolute angles is done in f32:
+//     longitude: angle addition, with the center's cos & sin from the CPU and the offset's from `sincos_small`
+//     latitude : only its sin & cos are needed, which follow from t = exp(y pi) = center.z * exp(dy pi) (as in `conversionsSimd.cc`)
+// The result is in units of the semi-major axis.
+fn unit_wm_to_ecef_rtc(d: vec2f, alt_uwm: f32, center: vec4f) -> vec3f {
+	var sc = sincos_small(d.x * PI);
+	if (abs(d.x * PI) >= 1.6) { sc = vec2f(sin(d.x * PI), cos(d.x * PI)); } // (level 0, where that is fine)
+	let cos_lamb = center.x * sc.y - center.y * sc.x;
+	let sin_lamb = center.y * sc.y + center.x * sc.x;
+
+	let t = center.z * exp(d.y * PI);
+	let t2 = t * t;
+	let inv = 1. / (t2 + 1.);
+	let sin_phi = (t2 - 1.) * inv;
+	let cos_phi = 2. * t * inv;
+
+	let alt = alt_uwm * PI;
+	let n_phi = 1. / sqrt(1. - e2 * sin_phi * sin_phi);
+	return vec3f(
+		(n_phi + alt) * cos_phi * cos_lamb,
+		(n_phi + alt) * cos_phi * sin_lamb,
+		(b2_over_a2 * n_phi + alt) * sin_phi);
+}
+
+fn fetchVertex(vi: VertexInput) -> TileVertex {
+	let G = textureDimensions(heightTex).x;
+	let x = vi.vertex_index % G;
+	let y = vi.vertex_index / G;
+	let t = vec2f(f32(x), f32(y)) / f32(G - 1);
+
+	let td = tileDatas[vi.instance_index];
+	let tlbr = td.tlbrUwm;
+	let h = textureLoad(heightTex, vec2u(x, y), vi.instance_index, 0).r;
+
+	// The offset from the tile's center (y goes north to south).
+	let d = vec2f((t.x - .5) * (tlbr.z - tlbr.x), (.5 - t.y) * (tlbr.w - tlbr.y));
+
+	var tv : TileVertex;
+	tv.pos = unit_wm_to_ecef_rtc(d, h / WebMercatorScale, td.centerTrig);
+	tv.uv = t;
+	tv.tex_index = vi.instance_index;
+	return tv;
+}
+
+)";
+
+    static const char* shaderSource = R"(
+
 struct VertexOutput {
     @builtin(position) position: vec4<f32>,
     @location(0) color: vec4<f32>,
     @location(1) uv: vec2<f32>,
     @location(2) @interpolate(flat) tex_index: u32,
+    @location(3) @interpolate(flat) covered: u32,
 };
 
-//
-// NOTE: This uses the trick of encoding the tile's texture array index as `instance_index`.
-//
-
 @vertex
 fn vs_main(vi: VertexInput) -> VertexOutput {
 	var vo : VertexOutput;
 
-	var p = scd.mvp * vec4(vi.position, 1.);
+	let tv = fetchVertex(vi);
+
+	var p = scd.mvp * vec4(tv.pos, 1.);
 	vo.position = p;
 
 	vo.color = scd.colorMult;
-	vo.uv = vi.uv;
+	vo.uv = tv.uv;
 
-	vo.tex_index = vi.instance_index;
+	vo.tex_index = tv.tex_index;
+	vo.covered = tileDatas[tv.tex_index].coveredMask;
 
 	return vo;
 }
@@ -66,6 +188,8 @@ fn fs_main(vo: VertexOutput) -> @location(0) vec4<f32> {
 
 	let color = vo.color * texColor;
 
+	if (quadrantCovered(vo.covered, uv)) { discard; }
+
 	return color;
 }
 
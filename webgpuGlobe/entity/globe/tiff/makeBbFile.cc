@@ -1,6 +1,7 @@
 #include "tiff.h"
 
 #include "util/gdalDataset.h"
+#include "util/gdalDatasetPool.h"
 
 #include "geo/conversions.h"
 #include "geo/earth.hpp"
@@ -8,6 +9,12 @@
 #include "entity/entity.h"
 
 #include "util/align3d.hpp"
+#include "util/parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
 
 #include <sys/stat.h>
 
@@ -64,19 +71,62 @@ namespace {
             }
         }
 
-        unit_wm_to_ecef(out.data(), S * S, out.data(), 3);
+        unit_wm_to_ecef_batch(out.data(), S * S, out.data(), 3);
         return out;
     }
 
+    // One level of the tree: the tiles in [x0,x1) x [y0,y1) of WM tile level `z`.
+    struct LevelRange {
+        uint32_t z;
+        Vector4i tlbr;
+        float geoErrorOnLevelUnit;
+        size_t firstItem; // index of the level's first tile in the output
+    };
+
+    TiffBoundingBoxMap::Item make_tile_item(uint32_t wmTileLevel, uint32_t y, uint32_t x, float geoErrorOnLevelUnit, GdalDataset& elevDset) {
+        double WmDiameter = Earth::WebMercatorScale * 2;
+
+        Vector4d tileTlbr {
+            (static_cast<double>(x) / (1 << wmTileLevel) - .5) * WmDiameter,
+            (static_cast<double>(y) / (1 << wmTileLevel) - .5) * WmDiameter,
+            (static_cast<double>(x + 1) / (1 << wmTileLevel) - .5) * WmDiameter,
+            (static_cast<double>(y + 1) / (1 << wmTileLevel) - .5) * WmDiameter,
+        };
+
+        Matrix<float, S * S, 3> pts = getEcefPointsOfTile(tileTlbr, elevDset);
+
+        Vector3f mid = pts.array().colwise().mean();
+
+        Matrix3f R = getSphericalLtp(mid);
+
+        pts = pts * R;
+
+        Vector3d lo                 = pts.array().colwise().minCoeff().cast<double>();
+        Vector3d hi                 = pts.array().colwise().maxCoeff().cast<double>();
+
+        Matrix<double, 4, 3> fourPts;
+        fourPts << lo(0), lo(1), lo(2), hi(0), lo(1), lo(2), lo(0), hi(1), lo(2), lo(0), lo(1), hi(2);
+
+        SolvedTransform T = align_box_dlt(fourPts);
+
+        T.t = R.cast<double>() * T.t;
+        T.q = Quaterniond { R.cast<double>() * T.q };
+
+        return TiffBoundingBoxMap::Item {
+            QuadtreeCoordinate { wmTileLevel, y, x },
+            PackedOrientedBoundingBox { T.t.cast<float>(), T.q.cast<float>().normalized(), T.s.cast<float>(),
+                                geoErrorOnLevelUnit }
+        };
+    }
+
     void make_bb_map(const std::string& outPath, const std::string& colorPath, const GlobeOptions& gopts) {
-        std::vector<TiffBoundingBoxMap::Item> items;
+        int nthreads = (int)gopts.getDouble("tiffBbThreads", defaultThreadCount());
+        configureGdalCache(gopts);
 
         GdalDataset colorDset(colorPath);
         Vector4d dsetTlbr    = colorDset.getWmTlbrOfDataset();
         double dsetPixelSize = ((dsetTlbr(2) - dsetTlbr(0)) / colorDset.w);
 
-        GdalDataset elevDset(gopts.getString("dtedPath"));
-
         // double WmDiameter    = 6.371e6 * M_PI * 2;
         double WmDiameter    = Earth::WebMercatorScale * 2;
         double wmLevelDouble = std::log2(WmDiameter / dsetPixelSize);
@@ -91,7 +141,9 @@ namespace {
 
         int tilesOnLastLevel = -1;
 
-        // Generate tree.
+        // Generate tree. First just the tile ranges of each level, which is cheap, then the boxes, which is not.
+        std::vector<LevelRange> levels;
+        size_t ntiles = 0;
         while (true) {
             int tilesOnLevel = 0;
 
@@ -125,59 +177,12 @@ namespace {
 				break;
             }
 
-			/*
-            if (tilesOnLevel <= 32) {
-                SPDLOG_WARN("[make_bb_map] stopping for testing...");
-				break;
-            }
-			*/
-
             float geoErrorOnLevelMeters = (1/(M_PI*2*2)) * Earth::R1 / (1 << wmTileLevel); // TODO:
 			geoErrorOnLevelMeters *= .5f;
             float geoErrorOnLevelUnit = geoErrorOnLevelMeters / Earth::R1;
 
-            for (uint32_t y = levelTlbr(1); y < levelTlbr(3); y++) {
-                for (uint32_t x = levelTlbr(0); x < levelTlbr(2); x++) {
-
-                    Vector4d tileTlbr {
-                        (static_cast<double>(x) / (1 << wmTileLevel) - .5) * WmDiameter,
-                        (static_cast<double>(y) / (1 << wmTileLevel) - .5) * WmDiameter,
-                        (static_cast<double>(x + 1) / (1 << wmTileLevel) - .5) * WmDiameter,
-                        (static_cast<double>(y + 1) / (1 << wmTileLevel) - .5) * WmDiameter,
-                    };
-                    // SPDLOG_INFO("[make_bb_map] tile: {}", tileTlbr.transpose());
-
-                    // TODO: Map points into ECEF. Then use DLT to find matrix that aligns them.
-                    Matrix<float, S * S, 3> pts = getEcefPointsOfTile(tileTlbr, elevDset);
-
-					Vector3f mid = pts.array().colwise().mean();
-
-					Matrix3f R = getSphericalLtp(mid);
-
-					pts = pts * R;
-
-                    Vector3d lo                 = pts.array().colwise().minCoeff().cast<double>();
-                    Vector3d hi                 = pts.array().colwise().maxCoeff().cast<double>();
-
-                    Matrix<double, 4, 3> fourPts;
-                    fourPts << lo(0), lo(1), lo(2), hi(0), lo(1), lo(2), lo(0), hi(1), lo(2), lo(0), lo(1), hi(2);
-
-
-                    SolvedTransform T = align_box_dlt(fourPts);
-
-					T.t = R.cast<double>() * T.t;
-					T.q = Quaterniond { R.cast<double>() * T.q };
-
-					// spdlog::get("wg")->info("from T.e:\n{}", T.s.transpose());
-					// throw std::runtime_error("stop");
-
-                    items.push_back(TiffBoundingBoxMap::Item {
-                        QuadtreeCoordinate { wmTileLevel, y, x },
-                        PackedOrientedBoundingBox { T.t.cast<float>(), T.q.cast<float>().normalized(), T.s.cast<float>(),
-                                            geoErrorOnLevelUnit }
-                    });
-                }
-            }
+            levels.push_back(LevelRange { wmTileLevel, levelTlbr, geoErrorOnLevelUnit, ntiles });
+            ntiles += tilesOnLevel;
 
             if (wmTileLevel <= 0) {
                 SPDLOG_DEBUG("[make_bb_map] stopping on pix level {}, too low", wmLevel);
@@ -187,12 +192,45 @@ namespace {
             wmLevel--;
         }
 
+        // Each tile does a GDAL read of the DTED and a small DLT solve, independent of every other tile.
+        // A `GdalDataset` must not be shared across threads, so every tile leases a handle from the pool.
+        // Every tile has a fixed slot in `items` (level by level, row major), so the file is the same whatever the thread count.
+        std::vector<TiffBoundingBoxMap::Item> items(ntiles);
+        std::string dtedPath = gopts.getString("dtedPath");
+        GdalDatasetPool::shared().acquire(dtedPath); // fail early on a bad path
+
+        SPDLOG_INFO("[make_bb_map] {} tiles on {} levels, using {} threads", fmt::group_digits(ntiles), levels.size(), std::max(nthreads, 1));
+        auto st = std::chrono::high_resolution_clock::now();
+        std::atomic<size_t> ndone = 0;
+        size_t logEvery = std::max<size_t>(ntiles / 20, 1000);
+
+        parallelFor(ntiles, nthreads, [&](size_t i, int) {
+            // The level holding tile i: the last one starting at or before it.
+            auto lvl = std::upper_bound(levels.begin(), levels.end(), i, [](size_t i, const LevelRange& l) { return i < l.firstItem; }) - 1;
+            uint32_t w = lvl->tlbr(2) - lvl->tlbr(0);
+            uint32_t j = i - lvl->firstItem;
+            uint32_t y = lvl->tlbr(1) + j / w;
+            uint32_t x = lvl->tlbr(0) + j % w;
+
+            auto elevDset = GdalDatasetPool::shared().acquire(dtedPath);
+            items[i] = make_tile_item(lvl->z, y, x, lvl->geoErrorOnLevelUnit, *elevDset);
+
+            size_t n = ++ndone;
+            if (n % logEvery == 0) {
+                double secs = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - st).count();
+                SPDLOG_INFO("[make_bb_map] {} / {} tiles ({:.0f} tiles/s)", n, ntiles, n / secs);
+            }
+        });
+
+        double secs = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - st).count();
+        SPDLOG_INFO("[make_bb_map] made {} boxes in {:.2f}s ({:.0f} tiles/s)", ntiles, secs, ntiles / std::max(secs, 1e-9));
+
         std::ofstream ofs(outPath, std::ios_base::binary);
         for (const auto& item : items) {
 			ofs.write((const char*)&item, sizeof(TiffBoundingBoxMap::Item));
 		}
         size_t len = ofs.tellp();
-        SPDLOG_INFO("[make_bb_map] wrote '{}', {} entries, {:>5.2f}MB, {}B / item", outPath, items.size(), static_cast<double>(len) / (1 << 20), len/items.size());
+        SPDLOG_INFO("[make_bb_map] wrote '{}', {} entries, {:>5.2f}MB, {}B / item", outPath, items.size(), static_cast<double>(len) / (1 << 20), items.size() ? len/items.size() : 0);
     }
 
 }
@@ -215,5 +253,9 @@ namespace tiff {
 #endif
     }
 
+    void make_tiff_bb_file(const std::string& bbPath, const std::string& tiffPath, const GlobeOptions& gopts) {
+        make_bb_map(bbPath, tiffPath, gopts);
+    }
+
 }
 }
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace wg {
+namespace tiff {
+
+	//
+	// Right-triangulated irregular network (RTIN) over a `G` x `G` grid, `G = 2^k + 1`, as in mapbox's "martini".
+	//
+	// The grid is split into two right triangles, and each triangle recursively into two by its hypotenuse's midpoint,
+	// down to triangles spanning one grid cell. A triangle's error is how far the true point at its hypotenuse's
+	// midpoint is from the middle of the hypotenuse, maxed with its children's errors: so cutting the recursion wherever
+	// that error is small enough gives a crack-free mesh (within the tile) that is everywhere within the bound.
+	//
+	// Unlike martini, which measures the error of heights, the error here is measured between 3d positions:
+	// so flat but large (low zoom) tiles still get split to follow the curvature of the earth.
+	//
+	// The points on the tile's border have infinite error, so the border is always fully split: each tile picks its
+	// interior from its own errors, but neighbouring tiles share every border vertex, so they meet without T-junctions.
+	//
+	// Grid point (x, y) is `y * G + x`.
+	//
+	struct Rtin {
+
+		inline Rtin() {}
+
+		inline explicit Rtin(uint32_t G) : gridSize(G) {
+			const uint32_t tileSize     = G - 1;
+			const uint32_t numSmallest  = tileSize * tileSize;
+			const uint32_t numTriangles = numSmallest * 2 - 2;
+			lastLevelIndex              = numTriangles - numSmallest;
+
+			// Each triangle's hypotenuse (a, b), for all triangles of the implicit binary tree, in breadth first order.
+			// (The third corner is implied by the two.)
+			coords.resize(numTriangles * 4);
+			for (uint32_t i = 0; i < numTriangles; i++) {
+				uint32_t id = i + 2;
+				uint32_t ax = 0, ay = 0, bx = 0, by = 0, cx = 0, cy = 0;
+				if (id & 1) bx = by = cx = tileSize;
+				else ax = ay = cy = tileSize;
+				while ((id >>= 1) > 1) {
+					uint32_t mx = (ax + bx) >> 1, my = (ay + by) >> 1;
+					if (id & 1) bx = ax, by = ay, ax = cx, ay = cy;
+					else ax = bx, ay = by, bx = cx, by = cy;
+					cx = mx, cy = my;
+				}
+				coords[i * 4 + 0] = ax, coords[i * 4 + 1] = ay, coords[i * 4 + 2] = bx, coords[i * 4 + 3] = by;
+			}
+		}
+
+		// True for `2^k + 1` in [3, 129]: 129^2 points is the most that uint16 indices can address.
+		static inline bool validGridSize(uint32_t G) {
+			return G >= 3 and G <= 129 and ((G - 1) & (G - 2)) == 0;
+		}
+
+		// `xyz` is `G * G` rows of 3 floats. Writes `G * G` errors (in the same units), keyed by grid point.
+		inline void computeErrors(const float* xyz, float* errors) const {
+			const uint32_t G = gridSize;
+			std::fill(errors, errors + G * G, 0.f);
+
+			// Children before parents: walk the tree backwards.
+			for (int64_t i = (int64_t)coords.size() / 4 - 1; i >= 0; i--) {
+				const uint32_t ax = coords[i * 4 + 0], ay = coords[i * 4 + 1], bx = coords[i * 4 + 2], by = coords[i * 4 + 3];
+				const uint32_t mx = (ax + bx) >> 1, my = (ay + by) >> 1;
+				const uint32_t cx = mx + my - ay, cy = my + ax - mx;
+
+				const float* pa = xyz + (ay * G + ax) * 3;
+				const float* pb = xyz + (by * G + bx) * 3;
+				const float* pm = xyz + (my * G + mx) * 3;
+				float dx = (pa[0] + pb[0]) * .5f - pm[0];
+				float dy = (pa[1] + pb[1]) * .5f - pm[1];
+				float dz = (pa[2] + pb[2]) * .5f - pm[2];
+
+				float& e = errors[my * G + mx];
+				e        = std::max(e, std::sqrt(dx * dx + dy * dy + dz * dz));
+				if (mx == 0 or my == 0 or mx == G - 1 or my == G - 1) e = std::numeric_limits<float>::infinity();
+
+				if (i < lastLevelIndex) {
+					float left  = errors[((ay + cy) >> 1) * G + ((ax + cx) >> 1)];
+					float right = errors[((by + cy) >> 1) * G + ((bx + cx) >> 1)];
+					e           = std::max({ e, left, right });
+				}
+			}
+		}
+
+		// Appends the triangles of the coarsest mesh within `maxError` to `tris`, as grid point indices.
+		// Triangles wind like `GpuResources::gridIbo`'s: (0,0) -> (1,0) -> (1,1).
+		inline void extract(const float* errors, float maxError, std::vector<uint32_t>& tris) const {
+			const uint32_t m = gridSize - 1;
+			extract_(errors, maxError, tris, 0, 0, m, m, m, 0);
+			extract_(errors, maxError, tris, m, m, 0, 0, 0, m);
+		}
+
+		uint32_t gridSize = 0;
+
+		private:
+		inline void extract_(const float* errors, float maxError, std::vector<uint32_t>& tris,
+				uint32_t ax, uint32_t ay, uint32_t bx, uint32_t by, uint32_t cx, uint32_t cy) const {
+			const uint32_t mx = (ax + bx) >> 1, my = (ay + by) >> 1;
+			const uint32_t G  = gridSize;
+
+			if ((ax > cx ? ax - cx : cx - ax) + (ay > cy ? ay - cy : cy - ay) > 1 and errors[my * G + mx] > maxError) {
+				extract_(errors, maxError, tris, cx, cy, ax, ay, mx, my);
+				extract_(errors, maxError, tris, bx, by, cx, cy, mx, my);
+				return;
+			}
+
+			int64_t cross = ((int64_t)bx - ax) * ((int64_t)cy - ay) - ((int64_t)by - ay) * ((int64_t)cx - ax);
+			tris.push_back(ay * G + ax);
+			if (cross > 0) {
+				tris.push_back(by * G + bx);
+				tris.push_back(cy * G + cx);
+			} else {
+				tris.push_back(cy * G + cx);
+				tris.push_back(by * G + bx);
+			}
+		}
+
+		std::vector<uint16_t> coords;
+		int64_t lastLevelIndex = 0;
+	};
+
+}
+}
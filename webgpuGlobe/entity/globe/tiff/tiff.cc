@@ -6,6 +6,7 @@
 #include "tiff_dataloader.hpp"
 
 #include "gpu/resources.h"
+#include "entity/globe/sseGovernor.h"
 
 #include "util/gdalDataset.h"
 #include "util/fmtEigen.h"
@@ -15,6 +16,8 @@
 #include <opencv2/core.hpp>
 #include <opencv2/imgproc.hpp>
 
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <mutex>
 #include <thread>
@@ -163,6 +166,116 @@ namespace tiff {
 
 	// struct DataLoader;
 
+	// What traversal needs from the render thread each frame: the camera, from the `RenderState`, and the thresholds.
+	struct CameraSnapshot {
+		Matrix4f mvp;
+		Vector3f eye;
+		float tanHalfFovTimesHeight;
+		float sseOpenThresh, sseCloseThresh;
+	};
+
+	// A loader response whose data is on the GPU already (see `TiffGlobe::uploadResponses_`),
+	// for the update thread to apply to the tree.
+	struct UploadedResponse {
+		Tile* src;
+		LoadAction action;
+		QuadtreeCoordinate parentCoord;
+		std::vector<QuadtreeCoordinate> coords;
+		std::vector<GpuTileData> gpu;
+		int32_t nparts = 1; // see `LoadDataResponse::nparts`
+	};
+
+	// A leaf to draw. The buffers are not owned: the tile's `GpuTileData` is, and it outlives every list that has it
+	// (see `DrawList::graveyard`).
+	struct DrawItem {
+		WGPUBuffer vbo = nullptr, ibo = nullptr;
+		uint64_t vboSize = 0, iboSize = 0;
+		uint32_t indexCount = 0;
+		int32_t textureArrayIndex = -1;
+		uint32_t coveredMask = 0; // see `Tile::coveredMask`
+	};
+
+	// Everything `TiffGlobe::render` encodes, made by the update thread and not changed once published.
+	struct DrawList {
+		std::vector<DrawItem> items;
+		std::vector<UnpackedOrientedBoundingBox> bbs; // debugLevel >= 1 only
+
+		// The GPU data of the tiles unloaded while making this list: the previous list may still draw it,
+		// so the render thread frees it (and returns the texture indices) only once this list replaces that one.
+		std::vector<GpuTileData> graveyard;
+	};
+
+	//
+	// Hands `DrawList`s from the update thread to the render thread. Three lists go around: the one being drawn,
+	// the newest published one, and the one being made. The lists (and their capacity) are swapped, never copied.
+	// If the render thread has not taken a list by the time the next one is published, that list is dropped,
+	// but its graveyard is carried over.
+	//
+	struct DrawListExchange {
+
+		// Update thread. `list` gets back a list to reuse, with no graveyard.
+		inline void publish(DrawList& list) {
+			std::lock_guard<std::mutex> lck(mtx);
+			if (fresh) {
+				for (auto& g : back.graveyard) list.graveyard.push_back(std::move(g));
+			}
+			std::swap(back, list);
+			list.graveyard.clear();
+			fresh = true;
+		}
+
+		// Render thread. Swaps the newest list into `front`, if there is one since the last call.
+		inline bool take(DrawList& front) {
+			std::lock_guard<std::mutex> lck(mtx);
+			if (not fresh) return false;
+			std::swap(front, back);
+			fresh = false;
+			return true;
+		}
+
+		private:
+		std::mutex mtx;
+		DrawList back;
+		bool fresh = false;
+	};
+
+	// Put a tile's data on the GPU. Render thread only, like all WebGPU calls here.
+	inline GpuTileData uploadTileData(const TileData& tileData, GpuResources& res) {
+		GpuTileData gpuTileData;
+		uint32_t textureArrayIndex = res.takeTileInd();
+		// textureArrayIndex = 0;
+		gpuTileData.textureArrayIndex = textureArrayIndex;
+		assert(textureArrayIndex >= 0 and textureArrayIndex < MAX_TILES);
+		logTrace("uploadTileData() :: img shape {} {} {} :: nverts {} nheights {}", tileData.img.rows, tileData.img.cols, tileData.img.channels(), tileData.vertices.size(), tileData.heights.size());
+
+		TileShaderData tsd {};
+		if (res.terrainMode == TiffTerrainMode::Heightmap) {
+			assert(tileData.heights.size() == res.gridSize * res.gridSize);
+			memcpy(tsd.tlbrUwm, tileData.tlbrUwm, sizeof(tsd.tlbrUwm));
+			// (From the same floats the shader has, so that it and the neighbouring tiles agree on the edges)
+			double x0 = .5 * ((double)tileData.tlbrUwm[0] + tileData.tlbrUwm[2]);
+			double y0 = .5 * ((double)tileData.tlbrUwm[1] + tileData.tlbrUwm[3]);
+			tsd.centerTrig[0] = (float)std::cos(x0 * M_PI);
+			tsd.centerTrig[1] = (float)std::sin(x0 * M_PI);
+			tsd.centerTrig[2] = (float)std::exp(y0 * M_PI);
+			tsd.centerTrig[3] = 0;
+			// R32Float: 4 bytes per texel.
+			uploadTex_(res.heightTex, res.ao, textureArrayIndex, (const uint8_t*)tileData.heights.data(), tileData.heights.size() * sizeof(float), res.gridSize, res.gridSize, sizeof(float));
+		} else {
+			createVbo_(gpuTileData.vbo, res.ao, (const uint8_t*)tileData.vertices.data(), tileData.vertices.size() * sizeof(TiffPackedVertex));
+			gpuTileData.vboSize = gpuTileData.vbo.getSize();
+			memcpy(tsd.model, tileData.model, sizeof(tsd.model));
+			if (res.terrainMode == TiffTerrainMode::Adaptive) {
+				createIbo_(gpuTileData.ibo, res.ao, (const uint8_t*)tileData.indices.data(), tileData.indices.size() * sizeof(uint16_t));
+				gpuTileData.iboSize    = gpuTileData.ibo.getSize();
+				gpuTileData.indexCount = tileData.indices.size();
+			}
+		}
+		res.writeTileData(textureArrayIndex, tsd);
+		uploadTex_(res.sharedTex, res.ao, textureArrayIndex, tileData.img.data(), tileData.img.total() * tileData.img.elemSize(), tileData.img.cols, tileData.img.rows, tileData.img.channels());
+		return gpuTileData;
+	}
+
     struct Tile {
 
         inline Tile(const QuadtreeCoordinate& coord, Tile* parent, TileState state, const UnpackedOrientedBoundingBox& bb)
@@ -188,9 +301,15 @@ namespace tiff {
 
         GpuTileData gpuTileData;
 
-		const float sseOpenThresh = 4.f;
+		// While `OpeningChildrenAsParent`: the loader answers each tile of the open on its own (see `DiskDataLoader::pushRequests`).
+		// A uv quadrant is covered once all the tiles under it have arrived: they draw, and this tile skips it (see `quadrantCovered`
+		// in `shader.hpp`) until the rest arrive.
+		std::array<uint8_t, 4> partsLeft = { 0 }; // per quadrant
+		int32_t partsArrived             = 0;
+		uint32_t coveredMask             = 0;
 
-        inline void update(const RenderState& rs, GpuResources& res, UpdateState& updateState) {
+        // Update thread (see `TiffGlobe::updateStep_`).
+        inline void update(UpdateState& updateState) {
             // If leaf:
             //    compute sse
             //    if   sse < closeThresh: goto SteadyLeafWantsToClose
@@ -205,21 +324,28 @@ namespace tiff {
 			if (isSteadyLeaf()) {
 				sse = bb.computeSse(updateState.mvp, updateState.eye, updateState.tanHalfFovTimesHeight);
 
-				if (sse > sseOpenThresh or sse == kBoundingBoxContainsEye) {
+				if (sse > updateState.sseOpenThresh or sse == kBoundingBoxContainsEye) {
 					if (isTerminal()) {
 						logTrace2("cannot open a terminal node");
 						state = TileState::SteadyLeaf;
 					} else {
 						state = TileState::OpeningChildrenAsParent;
 						logTrace2("push OpenChildren request at {} from sse {:>.2f}", coord, sse);
-						updateState.requests.push_back(LoadDataRequest{
+						LoadDataRequest req {
 								.src = this,
 								.seq = updateState.seq++,
 								.parentCoord = coord,
 								.action = LoadAction::OpenChildren
-								});
+								};
+						// (Just the children with `maxSkipLevels=0`)
+						refinementCut(coord, updateState.maxSkipLevels, updateState, req.coords);
+						partsLeft    = { 0 };
+						partsArrived = 0;
+						coveredMask  = 0;
+						for (const auto& c : req.coords) partsLeft[quadrantOf(c)]++;
+						updateState.requests.push_back(std::move(req));
 					}
-				} else if ((sse >= 0 and sse < .7f) or sse == kBoundingBoxNotVisible) {
+				} else if ((sse >= 0 and sse < updateState.sseCloseThresh) or sse == kBoundingBoxNotVisible) {
 					if (isRoot()) {
 						logTrace2("cannot close a root");
 						state = TileState::SteadyLeaf;
@@ -235,7 +361,7 @@ namespace tiff {
 			else if (state == TileState::SteadyInterior) {
 				assert(nchildren > 0);
 
-				for (int i=0; i<nchildren; i++) children[i]->update(rs, res, updateState);
+				for (int i=0; i<nchildren; i++) children[i]->update(updateState);
 
 				bool allChildrenWantClose = true;
 				// for (auto& c : children) if (c->state != TileState::SteadyLeafWantsToClose) allChildrenWantClose = false;
@@ -246,7 +372,7 @@ namespace tiff {
 					sse = bb.computeSse(updateState.mvp, updateState.eye, updateState.tanHalfFovTimesHeight);
 
 					// WARNING: Why is this necessary? Is there a bug with sse computation?
-					if (sse > sseOpenThresh) {
+					if (sse > updateState.sseOpenThresh) {
 						logDebug("not ClosingToParent {} because parent sse is too high {:>.2f}", coord, sse);
 					} else {
 						logDebug("push CloseToParent request at {} (my sse {:.2f})", coord, sse);
@@ -267,30 +393,79 @@ namespace tiff {
 
         }
 
-        inline void recvOpenLoadedData(LoadDataResponse&& resp, GpuResources& res, TiffBoundingBoxMap& bbMap) {
+        //
+        // Skip-level refinement: the tiles to load in place of this one when it opens. Its children -- but where a child's
+        // sse says that it would open as soon as it arrived, its children instead, and so on, at most `skip` levels below
+        // the children. So zooming in fast does not load (and wait for) every level on the way down.
+        // The skipped levels get tiles without data: interior tiles are never drawn, and only load if they become
+        // leaves again (see `CloseToParent`). Until they arrive, this tile keeps drawing in their place (see `coveredMask`).
+        // The coordinates come out in the order `findOrMakeDescendant` makes children in, like the loader's.
+        //
+        inline void refinementCut(const QuadtreeCoordinate& c, int skip, UpdateState& updateState, std::vector<QuadtreeCoordinate>& out) const {
+			TiffBoundingBoxMap& bbMap = *updateState.boundingBoxMap;
+			for (uint32_t i = 0; i < QuadtreeCoordinate::MaxChildren; i++) {
+				QuadtreeCoordinate cc = c.child(i);
+				auto it = bbMap.find(cc);
+				if (it == bbMap.end()) continue;
+
+				bool open = false;
+				if (skip > 0 and not it->second.terminal) {
+					UnpackedOrientedBoundingBox childBb = it->second; // (`computeSse` is not const)
+					float childSse = childBb.computeSse(updateState.mvp, updateState.eye, updateState.tanHalfFovTimesHeight);
+					open = childSse > updateState.sseOpenThresh or childSse == kBoundingBoxContainsEye;
+				}
+				if (open) refinementCut(cc, skip - 1, updateState, out);
+				else out.push_back(cc);
+			}
+		}
+
+		// The uv quadrant of this tile that `c` (a descendant) is in: the bit of `TileShaderData::coveredMask`.
+		inline uint32_t quadrantOf(const QuadtreeCoordinate& c) const {
+			assert(c.z() > coord.z());
+			uint32_t shift = c.z() - coord.z() - 1;
+			return ((c.x() >> shift) & 1) | (((c.y() >> shift) & 1) << 1);
+		}
+
+		// The tile at `c` below this one, made if need be, along with the ones in between (as data-less interior tiles).
+		inline Tile* findOrMakeDescendant(const QuadtreeCoordinate& c, TiffBoundingBoxMap& bbMap) {
+			assert(c.z() > coord.z());
+			Tile* p = c.z() == coord.z() + 1 ? this : findOrMakeDescendant(c.parent(), bbMap);
+			for (int i=0; i<p->nchildren; i++)
+				if (p->children[i]->coord == c) return p->children[i];
+
+			assert(p->nchildren < 4);
+			Tile* t = new Tile(c, p, TileState::SteadyLeaf, bbMap.find(c)->second);
+			p->children[p->nchildren++] = t;
+			if (p != this) p->state = TileState::SteadyInterior;
+			return t;
+		}
+
+        // Update thread. The unloaded GPU data goes to `graveyard`, for the render thread to free (see `DrawList`).
+        inline void recvOpenLoadedData(UploadedResponse&& resp, TiffBoundingBoxMap& bbMap, std::vector<GpuTileData>& graveyard) {
             if (resp.action == LoadAction::OpenChildren) {
                 assert(state == TileState::OpeningChildrenAsParent);
                 assert(resp.parentCoord == coord);
-				// Allocate children and load the data.
-
-				// int32_t seq;
-				// Tile* src;
-				// QuadtreeCoordinate parentCoord;
-				// LoadAction action;
-				// std::vector<TileData> items;
-				// assert(resp.items.size() == 4);
-                logDebug("recv open {} children data for {}", resp.items.size(), resp.parentCoord);
-				nchildren = resp.items.size();
-				for (int i=0; i<resp.items.size(); i++) {
-					assert(children[i] == nullptr);
-					auto childCoord = resp.items[i].coord;
-					children[i] = new Tile(childCoord, this, TileState::SteadyLeaf, bbMap.map[childCoord]);
-
-					children[i]->loadFrom(resp.items[i], res);
+				// Allocate children, with their data uploaded already.
+				// (Or deeper descendants, see `refinementCut`: then also the tiles in between, without data)
+				// This is one part of `resp.nparts`: the others may come in later frames. Until the last, this tile
+				// stays a leaf, and draws the quadrants whose tiles have not all arrived.
+
+                logDebug("recv open {} children data for {} (part {} of {})", resp.coords.size(), resp.parentCoord, partsArrived + 1, resp.nparts);
+				for (int i=0; i<resp.coords.size(); i++) {
+					Tile* tile = findOrMakeDescendant(resp.coords[i], bbMap);
+					tile->gpuTileData = std::move(resp.gpu[i]);
+
+					uint32_t q = quadrantOf(resp.coords[i]);
+					assert(partsLeft[q] > 0);
+					if (--partsLeft[q] == 0) coveredMask |= 1u << q;
 				}
 
-				state = TileState::SteadyInterior;
-				unload(res);
+				if (++partsArrived == resp.nparts) {
+					partsArrived = 0;
+					coveredMask  = 0;
+					state = TileState::SteadyInterior;
+					retire(graveyard);
+				}
 
             } else if (resp.action == LoadAction::CloseToParent) {
 
@@ -298,16 +473,16 @@ namespace tiff {
 				assert(nchildren > 0);
 				assert(state == TileState::OpeningAsParent);
 				for (int i=0; i<nchildren; i++) assert(children[i]->state == TileState::ClosingToParent);
-				assert(resp.items.size() == 1);
+				assert(resp.gpu.size() == 1);
 
 				for (int i=0; i<nchildren; i++) {
-					children[i]->unload(res);
+					children[i]->retire(graveyard);
 					delete children[i];
 					children[i] = nullptr;
 				}
 				nchildren = 0;
 
-				loadFrom(resp.items[0], res);
+				gpuTileData = std::move(resp.gpu[0]);
                 logTrace("load parent to close children {}", resp.parentCoord);
 				state = TileState::SteadyLeaf;
 
@@ -315,35 +490,18 @@ namespace tiff {
 
                 logDebug("root recvOpenLoadedData (for {})", resp.parentCoord);
 
-                assert(resp.items.size() == 1);
-                auto& tileData  = resp.items[0];
-
-				loadFrom(tileData, res);
+                assert(resp.gpu.size() == 1);
+				gpuTileData = std::move(resp.gpu[0]);
 
 				state = TileState::SteadyLeaf;
             }
         }
 
-		inline void loadFrom(const TileData& tileData, GpuResources& res) {
-				createVbo_(gpuTileData.vbo, res.ao, tileData.vertexData);
-				createIbo_(gpuTileData.ibo, res.ao, (const uint8_t*)tileData.indices.data(), tileData.indices.size() * sizeof(uint16_t));
-				gpuTileData.nindex = tileData.indices.size();
-
-                uint32_t textureArrayIndex = res.takeTileInd();
-				// textureArrayIndex = 0;
-				gpuTileData.textureArrayIndex = textureArrayIndex;
-				assert(textureArrayIndex >= 0 and textureArrayIndex < MAX_TILES);
-                logTrace("loadFrom() :: img shape {} {} {} :: vbo size {} ninds {}", tileData.img.rows, tileData.img.cols, tileData.img.channels(), tileData.vertexData.size(), gpuTileData.nindex);
-				uploadTex_(res.sharedTex, res.ao, textureArrayIndex, tileData.img.data(), tileData.img.total() * tileData.img.elemSize(), tileData.img.cols, tileData.img.rows, tileData.img.channels());
-		}
-
-		inline void unload(GpuResources& res) {
-            logTrace("unload() {}", coord);
+		inline void retire(std::vector<GpuTileData>& graveyard) {
+            logTrace("retire() {}", coord);
 			assert(gpuTileData.textureArrayIndex >= 0);
-			gpuTileData.vbo = {};
-			gpuTileData.ibo = {};
-			res.returnTileInd(gpuTileData.textureArrayIndex);
-			gpuTileData.textureArrayIndex = -1;
+			graveyard.push_back(std::move(gpuTileData));
+			gpuTileData = GpuTileData{};
 		}
 
         inline bool shouldDraw() const {
@@ -365,39 +523,36 @@ namespace tiff {
 			return bb.terminal;
         }
 
-        inline void render(const RenderState& rs) {
+        // Update thread: append the visible leaves (and their boxes, if `withBbs`).
+        // An opening tile also appends the children that have arrived, for the quadrants they cover.
+        inline void collect(DrawList& list, bool withBbs) const {
             if (shouldDraw()) {
 				if (sse != kBoundingBoxNotVisible) {
-
-					// draw ...
-					// spdlog::get("tiffRndr")->trace("render ready leaf {} inds {}", coord, gpuTileData.nindex);
-
-					// rs.pass.setRenderPipeline(rndrPipe);
-					// rs.pass.setBindGroup(0, rs.appObjects.getSceneBindGroup());
-					rs.pass.setVertexBuffer(0, gpuTileData.vbo, 0, gpuTileData.vbo.getSize());
-					rs.pass.setIndexBuffer(gpuTileData.ibo, WGPUIndexFormat_Uint16, 0, gpuTileData.ibo.getSize());
-					// rs.pass.drawIndexed(gpuTileData.nindex);
-					rs.pass.drawIndexed(gpuTileData.nindex, 1, 0, 0, gpuTileData.textureArrayIndex);
+					list.items.push_back(DrawItem{
+							.vbo = gpuTileData.vbo.ptr,
+							.ibo = gpuTileData.ibo.ptr,
+							.vboSize = gpuTileData.vboSize,
+							.iboSize = gpuTileData.iboSize,
+							.indexCount = gpuTileData.indexCount,
+							.textureArrayIndex = gpuTileData.textureArrayIndex,
+							.coveredMask = coveredMask });
+					if (withBbs) list.bbs.push_back(bb);
+
+					if (coveredMask) {
+						for (int i = 0; i < nchildren; i++)
+							if (coveredMask & (1u << quadrantOf(children[i]->coord))) children[i]->collect(list, withBbs);
+					}
 				} else {
 					logTrace("cull!");
 				}
 
             } else if (isInterior()) {
-                for (int i = 0; i < nchildren; i++) children[i]->render(rs);
+                for (int i = 0; i < nchildren; i++) children[i]->collect(list, withBbs);
             } else {
                 spdlog::get("tiffRndr")->warn("non shouldDraw/isInterior ?");
             }
         }
 
-        inline void renderBb(const RenderState& rs, InefficientBboxEntity* bboxEntity) {
-            if (shouldDraw()) {
-				bboxEntity->set(bb);
-				bboxEntity->render(rs);
-			} else {
-				for (int i=0; i<nchildren; i++) children[i]->renderBb(rs, bboxEntity);
-			}
-		}
-
 		inline int print(int depth=0) {
 			std::string space = "";
 			for (int i=0; i<depth; i++) space += "        ";
@@ -414,6 +569,7 @@ namespace tiff {
         TiffGlobe(AppObjects& ao, const GlobeOptions& opts)
             : Globe(ao, opts)
             , gpuResources(ao, opts)
+            , governor(opts)
 		{
             // loader = std::make_unique<GenericTiffDataLoader>(opts);
             loader = std::make_unique<DiskTiffDataLoader>(opts);
@@ -425,9 +581,22 @@ namespace tiff {
 
 			bboxEntity = std::make_shared<InefficientBboxEntity>(ao);
             createAndWaitForRootsToLoad_();
+
+			// Traversal (sse, state changes, requests) runs on its own thread, off the render thread,
+			// unless `tiffUpdateThread=0`: then `render` does it inline as before, which is handy for debugging.
+			// How many levels below its children a tile may open straight to, when zooming fast (see `Tile::refinementCut`).
+			maxSkipLevels = std::max(0, (int)opts.getDouble("tiffMaxSkipLevels", 2));
+
+			if (opts.getDouble("tiffUpdateThread", 1) != 0) updateThread = std::thread(&TiffGlobe::updateLoop_, this);
         }
 
         ~TiffGlobe() {
+			{
+				std::lock_guard<std::mutex> lck(inbox.mtx);
+				inbox.stop = true;
+			}
+			inbox.cv.notify_one();
+			if (updateThread.joinable()) updateThread.join();
             for (auto root : roots) delete root;
         }
 
@@ -438,6 +607,7 @@ namespace tiff {
 		}
 
         inline virtual void render(const RenderState& rs) override {
+			auto workStart = std::chrono::steady_clock::now();
 
 			// Temporary test of casting.
 			/*
@@ -485,23 +655,109 @@ namespace tiff {
 			}
 
 
-			// Not needed if RenderState actually contains all of this data.
-			UpdateState updateState;
-			updateState.mvp = Map<const Matrix4f> { rs.camData.mvp };
-			updateState.eye = Map<const Vector3f> { rs.camData.eye };
-			updateState.tanHalfFovTimesHeight = rs.intrin.fy;
+			CameraSnapshot cam;
+			cam.mvp = Map<const Matrix4f> { rs.camData.mvp };
+			cam.eye = Map<const Vector3f> { rs.camData.eye };
+			cam.tanHalfFovTimesHeight = rs.intrin.fy;
+
+			std::vector<UploadedResponse> uploaded = uploadResponses_();
+
+			// Thresholds for this frame's traversal, from how the last frames went.
+			const SseGovernor::State& gov = governor.update(lastWorkMs, MAX_TILES - (int)gpuResources.freeTileInds.size(), MAX_TILES, loader->loadsInFlight());
+			cam.sseOpenThresh  = gov.openThresh;
+			cam.sseCloseThresh = gov.closeThresh;
+			if (debugLevel >= 1 and gov.frames % 60 == 0) logger->debug("governor: {}", governor.summary());
+
+			if (updateThread.joinable()) {
+				// Hand the update thread the newest camera and the uploads. It works at its own pace: if it is slow,
+				// this frame draws the last list it published.
+				{
+					std::lock_guard<std::mutex> lck(inbox.mtx);
+					inbox.camera = cam;
+					inbox.cameraSeq++;
+					for (auto& up : uploaded) inbox.uploaded.push_back(std::move(up));
+				}
+				inbox.cv.notify_one();
+			} else {
+				updateStep_(cam, uploaded);
+			}
+
+			// Now the tiles unloaded while making the new list are not drawn by anything: free them.
+			if (drawLists.take(drawList)) freeGraveyard_(drawList.graveyard);
+
+			if (debugLevel >= 2) logger->info("|time| begin render");
+            // All tiles use the same grid indices. (Adaptive mode: every tile has its own, and none of them needs `gridIbo` back)
+            rs.pass.setIndexBuffer(gpuResources.gridIbo, WGPUIndexFormat_Uint16, 0, gpuResources.gridIbo.getSize());
+			for (const DrawItem& item : drawList.items) {
+				// No vbo in heightmap mode.
+				if (item.vbo) rs.pass.setVertexBuffer(0, item.vbo, 0, item.vboSize);
+				gpuResources.writeTileCoveredMask(item.textureArrayIndex, item.coveredMask);
+				if (item.ibo) {
+					rs.pass.setIndexBuffer(item.ibo, WGPUIndexFormat_Uint16, 0, item.iboSize);
+					rs.pass.drawIndexed(item.indexCount, 1, 0, 0, item.textureArrayIndex);
+				} else {
+					rs.pass.drawIndexed(gpuResources.gridIndexCount, 1, 0, 0, item.textureArrayIndex);
+				}
+			}
+			if (debugLevel >= 2) logger->info("|time| finish render");
+
+            if (debugLevel >= 1 and bboxEntity) {
+				for (const auto& bb : drawList.bbs) {
+					bboxEntity->set(bb);
+					bboxEntity->render(rs);
+				}
+			}
+
+			lastWorkMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - workStart).count();
+        }
 
+		// Render thread: upload what the loader has finished, and give it its buffers back.
+		inline std::vector<UploadedResponse> uploadResponses_() {
 			auto responses = loader->pullResponses();
-			if (responses.size() and debugLevel >= 1)
-				logger->debug("recv {} data loader responses", responses.size());
+			if (responses.size() and debugLevel >= 1) {
+				LoaderAllocStats st = loader->allocStats();
+				logger->debug("recv {} data loader responses (items created {} reused {} recycled {}, buffer growths {})", responses.size(),
+							  st.itemsCreated, st.itemsReused, st.itemsRecycled, st.bufferGrowths);
+			}
+
+			std::vector<UploadedResponse> uploaded;
+			uploaded.reserve(responses.size());
             for (auto& resp : responses) {
-				Tile* src = reinterpret_cast<Tile*>(resp.src);
-				src->recvOpenLoadedData(std::move(resp), gpuResources, loader->boundingBoxMap);
+				UploadedResponse up { reinterpret_cast<Tile*>(resp.src), resp.action, resp.parentCoord, {}, {}, resp.nparts };
+				for (const auto& item : resp.items) {
+					up.coords.push_back(item.coord);
+					up.gpu.push_back(uploadTileData(item, gpuResources));
+				}
+				uploaded.push_back(std::move(up));
+				// Uploaded: the loader can have the buffers back.
+				loader->recycle(std::move(resp));
+			}
+			return uploaded;
+		}
+
+		inline void freeGraveyard_(std::vector<GpuTileData>& graveyard) {
+			for (auto& g : graveyard) gpuResources.returnTileInd(g.textureArrayIndex);
+			graveyard.clear();
+		}
+
+		// Update thread (or render thread, without one): apply the uploads, traverse, request, and publish a new draw list.
+		inline void updateStep_(const CameraSnapshot& cam, std::vector<UploadedResponse>& uploaded) {
+			for (auto& up : uploaded) {
+				Tile* src = up.src;
+				src->recvOpenLoadedData(std::move(up), loader->boundingBoxMap, nextDrawList.graveyard);
 			}
 
-			
+			UpdateState updateState;
+			updateState.maxSkipLevels  = maxSkipLevels;
+			updateState.boundingBoxMap = &loader->boundingBoxMap;
+			updateState.mvp = cam.mvp;
+			updateState.eye = cam.eye;
+			updateState.tanHalfFovTimesHeight = cam.tanHalfFovTimesHeight;
+			updateState.sseOpenThresh  = cam.sseOpenThresh;
+			updateState.sseCloseThresh = cam.sseCloseThresh;
+
 			if (debugLevel >= 2) logger->info("|time| begin update");
-            for (auto tile : roots) { tile->update(rs, gpuResources, updateState); }
+            for (auto tile : roots) { tile->update(updateState); }
 			if (debugLevel >= 2) logger->info("|time| finish update");
 
 			if (updateState.requests.size()) loader->pushRequests(std::move(updateState.requests));
@@ -509,12 +765,42 @@ namespace tiff {
 			if (debugLevel >= 3)
 				print();
 
-			if (debugLevel >= 2) logger->info("|time| begin render");
-            for (auto tile : roots) { tile->render(rs); }
-			if (debugLevel >= 2) logger->info("|time| finish render");
+			publishDrawList_();
+		}
 
-            if (debugLevel >= 1 and bboxEntity) for (auto tile : roots) { tile->renderBb(rs, bboxEntity.get()); }
-        }
+		inline void publishDrawList_() {
+			nextDrawList.items.clear();
+			nextDrawList.bbs.clear();
+            for (auto tile : roots) { tile->collect(nextDrawList, debugLevel >= 1); }
+			drawLists.publish(nextDrawList);
+		}
+
+		inline void updateLoop_() {
+			CameraSnapshot lastCam;
+			uint64_t lastCameraSeq = 0;
+			std::vector<UploadedResponse> uploaded;
+			while (true) {
+				CameraSnapshot cam;
+				uint64_t cameraSeq;
+				{
+					std::unique_lock<std::mutex> lck(inbox.mtx);
+					inbox.cv.wait(lck, [&]() { return inbox.stop or inbox.cameraSeq != lastCameraSeq or inbox.uploaded.size(); });
+					if (inbox.stop) break;
+					// Only the newest camera matters: the frames in between are skipped.
+					cam       = inbox.camera;
+					cameraSeq = inbox.cameraSeq;
+					std::swap(uploaded, inbox.uploaded);
+				}
+
+				// Nothing can change if neither the camera (nor the thresholds) nor the tree did.
+				bool moved = lastCameraSeq == 0 or cam.mvp != lastCam.mvp or cam.eye != lastCam.eye or cam.sseOpenThresh != lastCam.sseOpenThresh
+							 or cam.sseCloseThresh != lastCam.sseCloseThresh;
+				if (moved or uploaded.size()) updateStep_(cam, uploaded);
+				lastCam       = cam;
+				lastCameraSeq = cameraSeq;
+				uploaded.clear();
+			}
+		}
 
         inline void createAndWaitForRootsToLoad_() {
             auto rootCoordinates = loader->getRootCoordinates();
@@ -548,10 +834,15 @@ namespace tiff {
             }
 
             for (auto& resp : responses) {
-				auto src = reinterpret_cast<Tile*>(resp.src);
-				src->recvOpenLoadedData(std::move(resp), gpuResources, loader->boundingBoxMap);
+				UploadedResponse up { reinterpret_cast<Tile*>(resp.src), resp.action, resp.parentCoord, { resp.items[0].coord }, {} };
+				up.gpu.push_back(uploadTileData(resp.items[0], gpuResources));
+				up.src->recvOpenLoadedData(std::move(up), loader->boundingBoxMap, nextDrawList.graveyard);
+				loader->recycle(std::move(resp));
 			}
 
+			// Something to draw until the first update.
+			publishDrawList_();
+
             logger->info("createAndWaitForRootsToLoad_ is done.");
         }
 
@@ -572,6 +863,27 @@ namespace tiff {
 		std::unique_ptr<GenericTiffDataLoader> loader;
         std::shared_ptr<spdlog::logger> logger;
         std::shared_ptr<InefficientBboxEntity> bboxEntity;
+
+		// The update thread's inputs, from the render thread.
+		struct {
+			std::mutex mtx;
+			std::condition_variable cv;
+			CameraSnapshot camera;
+			uint64_t cameraSeq = 0;
+			std::vector<UploadedResponse> uploaded;
+			bool stop = false;
+		} inbox;
+
+		int maxSkipLevels = 2;
+
+		// Adjusts the sse thresholds every frame (render thread). Public, for tuning.
+		SseGovernor governor;
+		float lastWorkMs = 0; // time spent in the last `render` (so without the update thread's traversal)
+
+		DrawListExchange drawLists;
+		DrawList drawList;     // render thread: the one being drawn
+		DrawList nextDrawList; // update thread: the one being made
+		std::thread updateThread;
     };
 
 
@@ -6,6 +6,9 @@
 // #include <opencv2/core.hpp>
 #include "webgpuGlobe/util/image.h"
 
+#include <stdexcept>
+#include <string>
+
 
 namespace wg {
 
@@ -13,11 +16,47 @@ namespace wg {
 
 		constexpr static int32_t MAX_TILES = 1024;
 
+		// Every tile is a `gridSize` x `gridSize` grid of vertices, all sharing one index buffer (see `GpuResources::gridIbo`).
+		// Set by the `tiffGridSize` option.
+		constexpr static uint32_t kDefaultTileGridSize = 8;
+
+		// In adaptive mode `tiffGridSize` is the height sample grid the mesh is picked from, so it defaults to more.
+		constexpr static uint32_t kDefaultAdaptiveGridSize = 65;
+
+		// How the terrain of a tile gets to the GPU, set by the `tiffTerrainMode` option ("mesh", "heightmap" or "adaptive").
+		//     Mesh     : the loader converts the grid to ECEF and uploads a vertex buffer per tile.
+		//     Heightmap: the loader uploads only the elevation as a layer of `GpuResources::heightTex`,
+		//                and the vertex shader displaces the shared grid and converts to ECEF itself.
+		//     Adaptive : like mesh, but from a finer grid the loader keeps only the triangles needed to stay within
+		//                `tiffAdaptiveErrorScale` times the tile's geometric error (see `rtin.hpp`), and uploads an
+		//                index buffer per tile too. Flat tiles get a handful of triangles, rough ones many.
+		enum class TiffTerrainMode { Mesh, Heightmap, Adaptive };
+
+		inline TiffTerrainMode parseTiffTerrainMode(const std::string& s) {
+			if (s == "mesh") return TiffTerrainMode::Mesh;
+			if (s == "heightmap") return TiffTerrainMode::Heightmap;
+			if (s == "adaptive") return TiffTerrainMode::Adaptive;
+			throw std::runtime_error("tiffTerrainMode must be 'mesh', 'heightmap' or 'adaptive', got '" + s + "'");
+		}
+
+		// The `tiffGridSize` option, with the default for `mode`.
+		inline uint32_t tiffGridSizeOption(const GlobeOptions& opts, TiffTerrainMode mode) {
+			return (uint32_t)opts.getDouble("tiffGridSize", mode == TiffTerrainMode::Adaptive ? kDefaultAdaptiveGridSize : kDefaultTileGridSize);
+		}
+
+		// Position is quantized to [-1, 1] within the tile's frame (see `TileData::model`), uv is [0, 1].
+		struct __attribute__((packed)) TiffPackedVertex {
+			int16_t x,y,z,w;
+			uint16_t u,v;
+		};
+		static_assert(sizeof(TiffPackedVertex) == 12);
+
 		struct GpuTileData {
-			Buffer ibo;
 			Buffer vbo;
+			Buffer ibo; // adaptive mode only, the others draw `GpuResources::gridIbo`
+			uint64_t vboSize = 0, iboSize = 0; // (so that draw lists can be made without calling into WebGPU)
+			uint32_t indexCount = 0;
 			int32_t textureArrayIndex = -1;
-			uint32_t nindex = 0;
 		};
 
 		struct TileData {
@@ -25,8 +64,14 @@ namespace wg {
 			// cv::Mat img;
 			Image img;
 
-			std::vector<uint8_t> vertexData;
-			std::vector<uint16_t> indices;
+			// Mesh & adaptive mode.
+			std::vector<TiffPackedVertex> vertices;
+			std::vector<uint16_t> indices; // adaptive mode only
+			alignas(16) float model[16]; // column major, takes the quantized positions to (unit) ECEF.
+
+			// Heightmap mode: elevation in meters, gridSize x gridSize, rows north to south.
+			std::vector<float> heights;
+			float tlbrUwm[4];
 
 			// Non gpu data, but feedback from DataLoader none-the-less
 			bool terminal = false;
@@ -0,0 +1,257 @@
+#pragma once
+
+#include "../globe.h"
+#include "util/gdalDatasetPool.h"
+#include "util/elevationPyramid.h"
+#include "util/colorKernels.h"
+#include "tiff.h"
+#include "rtin.hpp"
+
+#include "geo/conversions.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <memory>
+
+
+namespace wg {
+namespace tiff {
+
+	// Per thread buffers for `TiffTileBuilder::build` (and the loader's baked tile reads), kept from tile to tile so that
+	// they are allocated once per thread rather than once per tile.
+	struct TiffTileScratch {
+		cv::Mat color, elev;
+		Matrix<float, Dynamic, 3, RowMajor> positions, local;
+		std::vector<uint8_t> cacheBuf;
+		// Adaptive mode.
+		std::vector<float> errors;
+		std::vector<uint32_t> tris;
+		std::vector<int32_t> vertexOfGridPoint;
+	};
+
+	//
+	// Builds a tile's GPU-ready data from the color & elevation GDAL datasets.
+	// This is what `DiskTiffDataLoader` does when a tile is not in the baked cache, and what `bakeTiles` does offline.
+	//
+	// `build` may be called from many threads at once: each call leases its own dataset handles from `GdalDatasetPool::shared()`.
+	// It writes into the item's existing buffers, so an item recycled from `TileDataPool` costs no allocation.
+	//
+	struct TiffTileBuilder {
+
+		inline TiffTileBuilder(const GlobeOptions& opts) {
+			colorPath = opts.getString("tiffPath");
+			dtedPath  = opts.getString("dtedPath");
+			configureGdalCache(opts);
+			// Open one handle of each now, so that a bad path fails here rather than on the first tile.
+			GdalDatasetPool::shared().acquire(colorPath);
+			GdalDatasetPool::shared().acquire(dtedPath);
+			// Heights come from the mmapped pyramid (`<dtedPath>.pyr`, made on first use) rather than a GDAL read per tile.
+			// `tiffElevPyramid=0` goes back to GDAL.
+			if (opts.getDouble("tiffElevPyramid", 1) != 0) {
+				elevPyr = std::make_shared<ElevationPyramid>();
+				if (not elevPyr->openOrBuild(dtedPath)) {
+					SPDLOG_WARN("could not open or build the elevation pyramid of '{}', reading heights with GDAL", dtedPath);
+					elevPyr = nullptr;
+				}
+			}
+			colorMult = opts.getDouble("colorMult");
+			// Must agree with `GpuResources`, which reads the same options.
+			terrainMode = parseTiffTerrainMode(opts.getString("tiffTerrainMode", "mesh"));
+			gridSize    = tiffGridSizeOption(opts, terrainMode);
+			if (terrainMode == TiffTerrainMode::Adaptive) {
+				if (not Rtin::validGridSize(gridSize)) throw std::runtime_error("in adaptive mode, tiffGridSize must be 2^k+1 in [3, 129]");
+				rtin = Rtin(gridSize);
+				adaptiveErrorScale = opts.getDouble("tiffAdaptiveErrorScale", .5);
+			}
+		}
+
+		// Set img.
+		// Set vertices & model (mesh mode), the same and indices (adaptive mode) or heights & tlbrUwm (heightmap mode).
+		// (In mesh & heightmap mode, the indices are the same for every tile, see `GpuResources::gridIbo`)
+		// `obb` is the tile's box from the bb file, if it has one: the vertices are quantized in its frame.
+		// Returns false if GDAL failed to read the color or the elevation: `item` is still filled in, but not with the tile's data.
+		inline bool build(TileData& item, const QuadtreeCoordinate& c, const PackedOrientedBoundingBox* obb) {
+			bool ok = true;
+
+			Vector4d tlbrWm = c.getWmTlbr();
+
+			auto colorDset = GdalDatasetPool::shared().acquire(colorPath);
+
+			const uint32_t E = gridSize;
+			TiffTileScratch& tmp = scratch();
+
+
+			// The color as GDAL gives it (1 or 3 bands).
+			cv::Mat& mat0 = tmp.color;
+			cv::Mat& dtedMat = tmp.elev;
+			createMat(mat0, 256,256, colorDset->nbands == 1 ? CV_8UC1 : CV_8UC3);
+			colorDset->getWm(tlbrWm, mat0, &ok);
+			// Done with GDAL, let other threads have the handle.
+			colorDset.release();
+
+			// Gray/RGB -> RGBA, with `colorMult`, in one pass straight into the tile's image. See `util/colorKernels.h`.
+			item.img.allocate(256,256,4);
+			color_to_rgba(mat0.data, mat0.channels(), 256*256, (float)colorMult, item.img.data());
+
+			// dtedMat.create(E,E, CV_16UC1);
+			createMat(dtedMat, E,E, CV_32FC1);
+
+
+			Vector4d elevTlbrWm { tlbrWm };
+			// adapt to gdal raster model FIXME: improve this?
+			double ww = elevTlbrWm(2) - elevTlbrWm(0), hh = elevTlbrWm(3) - elevTlbrWm(1);
+			elevTlbrWm(2) += (ww) / (E);
+			elevTlbrWm(3) += (hh) / (E);
+			// elevTlbrWm(0) -= (ww) / (E);
+			// elevTlbrWm(1) -= (hh) / (E);
+			if (elevPyr) {
+				elevPyr->sampleWm(elevTlbrWm, dtedMat);
+			} else {
+				GdalDatasetPool::shared().acquire(dtedPath)->getWm(elevTlbrWm, dtedMat, &ok);
+			}
+
+			const float* elevData = (const float*) dtedMat.data;
+			// const int16_t* elevData = (const int16_t*) dtedMat.data;
+
+			Vector4d tlbrUwm   = tlbrWm.array() / Earth::WebMercatorScale;
+
+			if (terrainMode == TiffTerrainMode::Heightmap) {
+				// The vertex shader does the rest.
+				item.heights.resize(E*E);
+				for (uint32_t i=0; i<E*E; i++) item.heights[i] = elevData[i] < -1000 ? 0 : elevData[i];
+				for (int i=0; i<4; i++) item.tlbrUwm[i] = (float)tlbrUwm(i);
+				return ok;
+			}
+
+			auto& positions = tmp.positions;
+			resizeMat(positions, E * E);
+			for (uint16_t y=0; y < E; y++) {
+				for (uint16_t x=0; x < E; x++) {
+
+					float xx_ = static_cast<float>(x) / static_cast<float>(E - 1);
+					float yy_ = static_cast<float>(y) / static_cast<float>(E - 1);
+
+					// Inset, may be helpful for debugging.
+					// xx_ = xx_ * .9f + .05f, yy_ = yy_ * .9f + .05f;
+
+					float xx  = (1 - xx_) * tlbrUwm(0) + xx_ * tlbrUwm(2);
+					float yy  = (1 - yy_) * tlbrUwm(1) + yy_ * tlbrUwm(3);
+					// float zz_   = (elevData[y*dtedMat.cols + x]);
+					float zz_   = (elevData[(E-y-1)*dtedMat.cols + x]);
+					if (zz_ < -1000) zz_ = 0;
+					float zz = zz_ / Earth::WebMercatorScale;
+
+					int32_t ii = ((E - 1 - y) * E) + x;
+					// int32_t ii = (y * E) + x;
+					positions.row(ii) << xx, yy, zz;
+				}
+			}
+
+			unit_wm_to_ecef_batch(positions.data(), E * E, positions.data(), 3);
+			// spdlog::get("tiffRndr")->info("mapped ECEF coords:\n{}", positions);
+
+			// Quantize the positions to int16 in the frame of the tile's OBB.
+			// The OBB's center and extents are only approximately those of the vertices, so re-fit the box along its axes first.
+			Matrix3f R = Matrix3f::Identity();
+			Vector3f p0 = positions.colwise().mean().transpose();
+			if (obb) {
+				PackedOrientedBoundingBox box = *obb; // (the accessors are not const)
+				R  = box.q().toRotationMatrix();
+				p0 = box.p();
+			}
+
+			auto& local = tmp.local;
+			resizeMat(local, E * E);
+			// (A lazy product: a GEMM would evaluate the lhs into a temporary.)
+			local.noalias() = (positions.rowwise() - p0.transpose()).lazyProduct(R);
+			Vector3f lo = local.colwise().minCoeff().transpose();
+			Vector3f hi = local.colwise().maxCoeff().transpose();
+			Vector3f mid = (lo + hi) * .5f;
+			Vector3f half = ((hi - lo) * .5f).cwiseMax(1e-12f);
+
+			// Grid point i (at column x, row y) as a vertex.
+			auto quantize = [&](uint32_t i) {
+				uint32_t x = i % E, y = i / E;
+				Vector3f q = (local.row(i).transpose() - mid).cwiseQuotient(half);
+				TiffPackedVertex vert;
+				vert.x = static_cast<int16_t>(std::round(std::clamp(q(0), -1.f, 1.f) * 32767.f));
+				vert.y = static_cast<int16_t>(std::round(std::clamp(q(1), -1.f, 1.f) * 32767.f));
+				vert.z = static_cast<int16_t>(std::round(std::clamp(q(2), -1.f, 1.f) * 32767.f));
+				vert.w = 0;
+				vert.u = static_cast<uint16_t>((x * 65535u) / (E - 1));
+				vert.v = static_cast<uint16_t>((y * 65535u) / (E - 1));
+				return vert;
+			};
+
+			if (terrainMode == TiffTerrainMode::Adaptive) {
+				// Triangulate within the error bound, then number the grid points the triangles use as the tile's vertices.
+				// The bound is in the same units as the positions (unit ECEF), like the bb file's geometric error.
+				float geoError = obb ? obb->geoError : levelGeoError(c.z());
+				tmp.errors.resize(E*E);
+				rtin.computeErrors(positions.data(), tmp.errors.data());
+				tmp.tris.clear();
+				rtin.extract(tmp.errors.data(), geoError * adaptiveErrorScale, tmp.tris);
+
+				tmp.vertexOfGridPoint.assign(E*E, -1);
+				item.vertices.clear();
+				item.indices.clear();
+				for (uint32_t i : tmp.tris) {
+					if (tmp.vertexOfGridPoint[i] < 0) {
+						tmp.vertexOfGridPoint[i] = item.vertices.size();
+						item.vertices.push_back(quantize(i));
+					}
+					item.indices.push_back(tmp.vertexOfGridPoint[i]);
+				}
+			} else {
+				item.vertices.resize(E*E);
+				for (uint32_t i=0; i < E*E; i++) item.vertices[i] = quantize(i);
+			}
+
+			// model = [R * diag(half) | p0 + R * mid]
+			Map<Matrix4f> model { item.model };
+			model.setIdentity();
+			model.topLeftCorner<3,3>() = R * half.asDiagonal();
+			model.topRightCorner<3,1>() = p0 + R * mid;
+			return ok;
+		}
+
+
+		// The geometric error `makeBbFile.cc` gives the tiles of a level, in units of the semi-major axis.
+		// (Only for tiles without an entry in the bb file.)
+		static inline float levelGeoError(uint32_t level) {
+			return (1 / (M_PI * 2 * 2)) / (1 << level) * .5;
+		}
+
+		static inline TiffTileScratch& scratch() {
+			static thread_local TiffTileScratch s;
+			return s;
+		}
+
+		// Scratch buffers that had to be (re)allocated: once per thread, then it stays put.
+		std::atomic<uint64_t> bufferGrowths { 0 };
+
+		private:
+		template <class M> inline void resizeMat(M& m, Index rows) {
+			if (m.rows() != rows) bufferGrowths++;
+			m.resize(rows, 3);
+		}
+		inline void createMat(cv::Mat& m, int rows, int cols, int type) {
+			const void* before = m.data;
+			m.create(rows, cols, type);
+			if (m.data != before) bufferGrowths++;
+		}
+
+		public:
+		std::string colorPath;
+		std::string dtedPath;
+		std::shared_ptr<ElevationPyramid> elevPyr;
+		double colorMult = 1;
+		TiffTerrainMode terrainMode = TiffTerrainMode::Mesh;
+		uint32_t gridSize = kDefaultTileGridSize;
+		Rtin rtin;
+		float adaptiveErrorScale = .5;
+	};
+
+}
+}
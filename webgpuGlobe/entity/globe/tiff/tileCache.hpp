@@ -0,0 +1,189 @@
+#pragma once
+
+#include "tiff.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include <fmt/core.h>
+
+namespace wg {
+namespace tiff {
+
+	//
+	// The baked tile cache: every tile's final data, exactly what `TiffTileBuilder::build` would produce,
+	// in a `PackFile` at `<tiffPath>.tiles` (next to the `.bb` file). Made offline by `bakeTiles`.
+	// A cached tile costs the loader one `pread` and a few memcpys, instead of two GDAL `RasterIO`s and the mesh build.
+	//
+	// One blob per tile, keyed by `tileCacheKey`:
+	//     TiffBakedTileHeader
+	//     img      (imgH * imgW * imgC bytes, RGBA)
+	//     Mesh mode     : gridSize^2 TiffPackedVertex
+	//     Heightmap mode: gridSize^2 float
+	//     Adaptive mode : uint32 nverts, uint32 nindices, nverts TiffPackedVertex, nindices uint16
+	//
+	// The header records what the tile was baked from (`TiffBakeParams`): the terrain mode, grid size, `colorMult`,
+	// `tiffAdaptiveErrorScale` (adaptive mode only), and a fingerprint of the source rasters. If any of it does not match
+	// the current options and files, the tile is treated as not cached.
+	//
+
+	constexpr uint32_t kTiffBakedTileMagic   = 0x4b415457; // "WTAK"
+	constexpr uint8_t  kTiffBakedTileVersion = 3;
+
+	struct TiffBakeParams {
+		TiffTerrainMode mode;
+		uint32_t gridSize;
+		float colorMult;
+		float adaptiveErrorScale; // 0 in the other modes, which do not use it
+		uint64_t sourceFingerprint;
+	};
+
+	// FNV-1a over the path, size and mtime of each source raster: replacing or editing either invalidates the cache.
+	// A file that can not be stat'd contributes just its path.
+	inline uint64_t tiffSourceFingerprint(const std::string& colorPath, const std::string& dtedPath) {
+		uint64_t h = 0xcbf29ce484222325ull;
+		auto mix   = [&h](const void* data, size_t len) {
+			for (size_t i = 0; i < len; i++) h = (h ^ ((const uint8_t*)data)[i]) * 0x100000001b3ull;
+		};
+		for (const std::string* path : { &colorPath, &dtedPath }) {
+			mix(path->data(), path->size());
+			struct stat st;
+			if (stat(path->c_str(), &st) == 0) {
+				int64_t sizeAndTime[2] = { (int64_t)st.st_size, (int64_t)st.st_mtime };
+				mix(sizeAndTime, sizeof(sizeAndTime));
+			}
+		}
+		return h;
+	}
+
+	inline TiffBakeParams tiffBakeParams(TiffTerrainMode mode, uint32_t gridSize, double colorMult, double adaptiveErrorScale, const std::string& colorPath,
+										 const std::string& dtedPath) {
+		return TiffBakeParams { mode, gridSize, (float)colorMult, mode == TiffTerrainMode::Adaptive ? (float)adaptiveErrorScale : 0.f,
+								tiffSourceFingerprint(colorPath, dtedPath) };
+	}
+
+	struct __attribute__((packed)) TiffBakedTileHeader {
+		uint32_t magic;
+		uint8_t version;
+		uint8_t terrainMode;
+		uint16_t gridSize;
+		uint16_t imgW, imgH;
+		uint8_t imgC;
+		uint8_t pad[3];
+		float model[16];
+		float tlbrUwm[4];
+		float colorMult;
+		float adaptiveErrorScale;
+		uint64_t sourceFingerprint;
+	};
+	static_assert(sizeof(TiffBakedTileHeader) == 112);
+
+	inline std::string tileCacheKey(const QuadtreeCoordinate& c) {
+		return fmt::format("{}/{}/{}", c.z(), c.y(), c.x());
+	}
+
+	inline std::string tileCachePath(const std::string& tiffPath) {
+		return tiffPath + ".tiles";
+	}
+
+	inline void encodeBakedTile(const TileData& item, const TiffBakeParams& params, std::vector<uint8_t>& out) {
+		const TiffTerrainMode mode = params.mode;
+		TiffBakedTileHeader hdr {};
+		hdr.magic              = kTiffBakedTileMagic;
+		hdr.version            = kTiffBakedTileVersion;
+		hdr.terrainMode        = (uint8_t)mode;
+		hdr.gridSize           = params.gridSize;
+		hdr.imgW               = item.img.cols;
+		hdr.imgH               = item.img.rows;
+		hdr.imgC               = item.img.channels();
+		hdr.colorMult          = params.colorMult;
+		hdr.adaptiveErrorScale = params.adaptiveErrorScale;
+		hdr.sourceFingerprint  = params.sourceFingerprint;
+		memcpy(hdr.model, item.model, sizeof(hdr.model));
+		memcpy(hdr.tlbrUwm, item.tlbrUwm, sizeof(hdr.tlbrUwm));
+
+		size_t imgBytes  = item.img.data_.size();
+		size_t vertBytes = item.vertices.size() * sizeof(TiffPackedVertex);
+		size_t gridBytes = mode == TiffTerrainMode::Mesh      ? vertBytes
+						 : mode == TiffTerrainMode::Heightmap ? item.heights.size() * sizeof(float)
+															  : 8 + vertBytes + item.indices.size() * sizeof(uint16_t);
+
+		out.resize(sizeof(hdr) + imgBytes + gridBytes);
+		uint8_t* p = out.data();
+		memcpy(p, &hdr, sizeof(hdr));
+		p += sizeof(hdr);
+		memcpy(p, item.img.data(), imgBytes);
+		p += imgBytes;
+		if (mode == TiffTerrainMode::Mesh) memcpy(p, item.vertices.data(), gridBytes);
+		else if (mode == TiffTerrainMode::Heightmap) memcpy(p, item.heights.data(), gridBytes);
+		else {
+			uint32_t counts[2] = { (uint32_t)item.vertices.size(), (uint32_t)item.indices.size() };
+			memcpy(p, counts, 8);
+			memcpy(p + 8, item.vertices.data(), vertBytes);
+			memcpy(p + 8 + vertBytes, item.indices.data(), item.indices.size() * sizeof(uint16_t));
+		}
+	}
+
+	// Whether the blob starts with a header of this version, baked with `params`. Needs only the first `sizeof(TiffBakedTileHeader)` bytes.
+	inline bool bakedTileMatches(const uint8_t* data, size_t len, const TiffBakeParams& params) {
+		TiffBakedTileHeader hdr;
+		if (len < sizeof(hdr)) return false;
+		memcpy(&hdr, data, sizeof(hdr));
+		return hdr.magic == kTiffBakedTileMagic and hdr.version == kTiffBakedTileVersion and hdr.terrainMode == (uint8_t)params.mode
+			   and hdr.gridSize == params.gridSize and hdr.colorMult == params.colorMult and hdr.adaptiveErrorScale == params.adaptiveErrorScale
+			   and hdr.sourceFingerprint == params.sourceFingerprint;
+	}
+
+	// Returns false if the blob is malformed or was baked with other `params`.
+	inline bool decodeBakedTile(const uint8_t* data, size_t len, const TiffBakeParams& params, TileData& item) {
+		if (not bakedTileMatches(data, len, params)) return false;
+		const TiffTerrainMode mode = params.mode;
+		const uint32_t gridSize    = params.gridSize;
+		TiffBakedTileHeader hdr;
+		memcpy(&hdr, data, sizeof(hdr));
+
+		size_t n         = (size_t)gridSize * gridSize;
+		size_t imgBytes  = (size_t)hdr.imgW * hdr.imgH * hdr.imgC;
+		uint32_t counts[2] = { 0, 0 }; // adaptive mode: vertices, indices
+		if (mode == TiffTerrainMode::Adaptive) {
+			if (len < sizeof(hdr) + imgBytes + 8) return false;
+			memcpy(counts, data + sizeof(hdr) + imgBytes, 8);
+			if (counts[0] > n or counts[1] % 3 != 0) return false;
+		}
+		size_t gridBytes = mode == TiffTerrainMode::Mesh      ? n * sizeof(TiffPackedVertex)
+						 : mode == TiffTerrainMode::Heightmap ? n * sizeof(float)
+															  : 8 + counts[0] * sizeof(TiffPackedVertex) + (size_t)counts[1] * sizeof(uint16_t);
+		if (len != sizeof(hdr) + imgBytes + gridBytes) return false;
+
+		const uint8_t* p = data + sizeof(hdr);
+		item.img.allocate(hdr.imgH, hdr.imgW, hdr.imgC);
+		memcpy(item.img.data(), p, imgBytes);
+		p += imgBytes;
+
+		memcpy(item.model, hdr.model, sizeof(hdr.model));
+		memcpy(item.tlbrUwm, hdr.tlbrUwm, sizeof(hdr.tlbrUwm));
+		if (mode == TiffTerrainMode::Mesh) {
+			item.vertices.resize(n);
+			memcpy(item.vertices.data(), p, gridBytes);
+		} else if (mode == TiffTerrainMode::Adaptive) {
+			p += 8;
+			item.vertices.resize(counts[0]);
+			memcpy(item.vertices.data(), p, counts[0] * sizeof(TiffPackedVertex));
+			p += counts[0] * sizeof(TiffPackedVertex);
+			item.indices.resize(counts[1]);
+			memcpy(item.indices.data(), p, counts[1] * sizeof(uint16_t));
+			// A corrupt entry must not reach the GPU as an index buffer reading past the vertices.
+			for (uint16_t i : item.indices)
+				if (i >= counts[0]) return false;
+		} else {
+			item.heights.resize(n);
+			memcpy(item.heights.data(), p, gridBytes);
+		}
+		return true;
+	}
+
+}
+}
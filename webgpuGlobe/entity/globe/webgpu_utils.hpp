@@ -26,17 +26,19 @@ namespace {
         createVbo_(vbo, ao, vec.data(), vec.size());
     }
     inline void createIbo_(Buffer& ibo, AppObjects& ao, const uint8_t* ptr, size_t bufSize) {
-		while (bufSize % 4 != 0) bufSize++;
+		// The buffer size must be a multiple of 4 (an odd number of uint16 indices is not), but only `bufSize` bytes are ours to read.
+		size_t paddedSize = bufSize;
+		while (paddedSize % 4 != 0) paddedSize++;
         WGPUBufferDescriptor desc {
             .nextInChain      = nullptr,
             .label            = "GlobeIbo",
             .usage            = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Index,
-            .size             = bufSize,
+            .size             = paddedSize,
             .mappedAtCreation = true,
         };
         ibo       = ao.device.create(desc);
 
-        void* dst = wgpuBufferGetMappedRange(ibo, 0, bufSize);
+        void* dst = wgpuBufferGetMappedRange(ibo, 0, paddedSize);
         memcpy(dst, ptr, bufSize);
 
         wgpuBufferUnmap(ibo);
@@ -64,5 +66,26 @@ namespace {
             WGPUExtent3D { w, h, 1 });
     }
 
+    // Same as above, but for block compressed formats with 4x4 blocks (e.g. BC1, where `bytesPerBlock` is 8).
+    inline void uploadTexBlocks_(Texture& sharedTex, AppObjects& ao, uint32_t textureArrayIndex, const uint8_t* ptr, size_t bufSize, uint32_t w,
+                    uint32_t h, uint32_t bytesPerBlock) {
+        ao.queue.writeTexture(
+            WGPUImageCopyTexture {
+                .nextInChain = nullptr,
+                .texture     = sharedTex,
+                .mipLevel    = 0,
+                .origin      = WGPUOrigin3D { 0, 0, textureArrayIndex },
+				.aspect = WGPUTextureAspect_All,
+        },
+            ptr, bufSize,
+            WGPUTextureDataLayout {
+                .nextInChain  = nullptr,
+                .offset       = 0,
+                .bytesPerRow  = ((w + 3) / 4) * bytesPerBlock,
+                .rowsPerImage = (h + 3) / 4,
+            },
+            WGPUExtent3D { w, h, 1 });
+    }
+
 }
 }
@@ -0,0 +1,235 @@
+#include "conversions.h"
+#include "earth.hpp"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <vector>
+
+//
+// The batched conversions (`*_batch`, `*_soa`) vs. the scalar ones in `conversions.cc`:
+//     - accuracy: the worst difference from the scalar double version, over random points on the globe, checked
+//                 against the bounds documented in `conversions.h` (the exit code is non-zero if one is exceeded).
+//     - speed   : points per second of the scalar, strided and SoA versions.
+//     - ecef_to_geodetic sweep: the error of the closed form vs. the iterative method it replaced (`legacy_ecef_to_geodetic`),
+//                 against the true geodetic coordinates the points were made from, by altitude band.
+//
+//     benchConversions [npoints=1000000]
+//
+
+namespace {
+	using namespace wg;
+	using Clock = std::chrono::high_resolution_clock;
+
+	// Inputs for each direction, as AoS doubles.
+	struct Inputs {
+		std::vector<double> llh; // lon, lat (rad), alt (units of the semi-major axis)
+		std::vector<double> uwm; // unit web mercator
+		std::vector<double> ecef;
+	};
+
+	Inputs make_inputs(int n) {
+		std::mt19937_64 rng(0);
+		std::uniform_real_distribution<double> lon(-M_PI, M_PI), lat(-M_PI / 2, M_PI / 2), unit(-1, 1);
+		std::uniform_real_distribution<double> alt(-1'000 / Earth::R1, 10'000'000 / Earth::R1);
+
+		Inputs in;
+		in.llh.resize(n * 3);
+		in.uwm.resize(n * 3);
+		for (int i = 0; i < n; i++) {
+			// Some points at low altitude, where most of them are in practice.
+			double h = i % 2 ? alt(rng) : alt(rng) * 1e-3;
+			in.llh[i * 3 + 0] = lon(rng), in.llh[i * 3 + 1] = lat(rng), in.llh[i * 3 + 2] = h;
+			in.uwm[i * 3 + 0] = unit(rng), in.uwm[i * 3 + 1] = unit(rng), in.uwm[i * 3 + 2] = h / M_PI;
+		}
+		in.ecef.resize(n * 3);
+		geodetic_to_ecef(in.ecef.data(), n, in.llh.data());
+		return in;
+	}
+
+	// Worst difference per component (longitudes compared modulo 2pi).
+	void max_diff(const double* ref, const std::vector<double>& got, int n, bool geodetic, double out[3]) {
+		out[0] = out[1] = out[2] = 0;
+		for (int i = 0; i < n; i++) {
+			for (int c = 0; c < 3; c++) {
+				double d = std::abs(ref[i * 3 + c] - got[i * 3 + c]);
+				if (geodetic and c == 0) d = std::min(d, 2 * M_PI - d);
+				out[c] = std::max(out[c], d);
+			}
+		}
+	}
+
+	template <class T> std::vector<T> cast(const std::vector<double>& v) { return std::vector<T>(v.begin(), v.end()); }
+
+	template <class T> std::vector<double> to_double(const std::vector<T>& v) { return std::vector<double>(v.begin(), v.end()); }
+
+	template <class T> using Aos = std::function<void(T*, int, const T*)>;
+	template <class T> using Soa = void (*)(T*, T*, T*, int, const T*, const T*, const T*);
+
+	bool allOk = true;
+
+	// Run one conversion at precision T: scalar, strided and SoA. Check the latter two against the double scalar version.
+	template <class T> void run(const char* name, const std::vector<double>& in64, bool geodetic, Aos<double> ref64, Aos<T> scalar,
+								Aos<T> batch, Soa<T> soa, double bound) {
+		const int n = in64.size() / 3;
+		std::vector<T> in = cast<T>(in64);
+
+		// The reference is computed from the inputs as rounded to T: only the conversion's own error is measured.
+		std::vector<double> inRounded = to_double(in), ref(n * 3);
+		ref64(ref.data(), n, inRounded.data());
+
+		std::vector<T> outScalar(n * 3), outBatch(n * 3), outSoa(n * 3);
+		std::vector<T> ix(n), iy(n), iz(n), ox(n), oy(n), oz(n);
+		for (int i = 0; i < n; i++) ix[i] = in[i * 3 + 0], iy[i] = in[i * 3 + 1], iz[i] = in[i * 3 + 2];
+
+		auto t0 = Clock::now();
+		scalar(outScalar.data(), n, in.data());
+		auto t1 = Clock::now();
+		batch(outBatch.data(), n, in.data());
+		auto t2 = Clock::now();
+		soa(ox.data(), oy.data(), oz.data(), n, ix.data(), iy.data(), iz.data());
+		auto t3 = Clock::now();
+		for (int i = 0; i < n; i++) outSoa[i * 3 + 0] = ox[i], outSoa[i * 3 + 1] = oy[i], outSoa[i * 3 + 2] = oz[i];
+
+		double eScalar[3], eBatch[3], eSoa[3];
+		max_diff(ref.data(), to_double(outScalar), n, geodetic, eScalar);
+		max_diff(ref.data(), to_double(outBatch), n, geodetic, eBatch);
+		max_diff(ref.data(), to_double(outSoa), n, geodetic, eSoa);
+		double worst = std::max({ eBatch[0], eBatch[1], eBatch[2], eSoa[0], eSoa[1], eSoa[2] });
+		bool ok      = worst <= bound;
+		allOk &= ok;
+
+		auto mpts = [n](auto a, auto b) { return n / std::chrono::duration<double, std::micro>(b - a).count(); };
+		fmt::print("{:<24} {:<6}  scalar {:>7.1f}  batch {:>7.1f}  soa {:>7.1f} Mpt/s   err: scalar {:.1e}  batch {:.1e} {:.1e} {:.1e}  (bound {:.0e}) {}\n",
+				   name, sizeof(T) == 4 ? "float" : "double", mpts(t0, t1), mpts(t1, t2), mpts(t2, t3),
+				   std::max({ eScalar[0], eScalar[1], eScalar[2] }), eBatch[0], eBatch[1], eBatch[2], bound, ok ? "ok" : "EXCEEDED");
+	}
+
+	// The iterative ecef_to_geodetic that `conversions.cc` had before the closed form, for comparison.
+	template <class T> void legacy_ecef_to_geodetic(T* out, int n, const T* x) {
+		using namespace Earth;
+		for (int i = 0; i < n; i++) {
+			const T xx = x[i * 3 + 0], yy = x[i * 3 + 1], zz = x[i * 3 + 2];
+
+			out[i * 3 + 0] = std::atan2(yy, xx);
+
+			T k  = 1. / (1. - static_cast<T>(e2));
+			T z  = zz;
+			T z2 = z * z;
+			T p2 = xx * xx + yy * yy;
+			T p  = std::sqrt(p2);
+			for (int j = 0; j < 2; j++) {
+				const T c_i = std::pow(((1 - static_cast<T>(e2)) * z2) * (k * k) + p2, T(1.5)) / static_cast<T>(e2);
+				k           = (c_i + (1 - static_cast<T>(e2)) * z2 * std::pow(k, T(3))) / (c_i - p2);
+			}
+			out[i * 3 + 1] = std::atan2(k * z, p);
+
+			T rn           = a / std::sqrt(T(1) - static_cast<T>(e2) * std::pow(std::sin(out[i * 3 + 1]), T(2)));
+			T sinabslat    = std::sin(std::abs(out[i * 3 + 1]));
+			T coslat       = std::cos(out[i * 3 + 1]);
+			out[i * 3 + 2] = (std::abs(z) + p - rn * (coslat + (1 - static_cast<T>(e2)) * sinabslat)) / (coslat + sinabslat);
+
+			if (std::isnan(out[i * 3 + 0]) or std::isnan(out[i * 3 + 1]) or std::isnan(out[i * 3 + 2])) {
+				out[i * 3 + 0] = out[i * 3 + 1] = out[i * 3 + 2] = 0;
+			}
+		}
+	}
+
+	// Worst horizontal and vertical error, in meters, of `got` vs. the true `llh`.
+	void geodetic_error_m(const std::vector<double>& llh, const std::vector<double>& got, double& horiz, double& vert) {
+		horiz = vert = 0;
+		for (size_t i = 0; i < llh.size() / 3; i++) {
+			double dlon = std::abs(llh[i * 3 + 0] - got[i * 3 + 0]);
+			dlon        = std::min(dlon, 2 * M_PI - dlon) * std::cos(llh[i * 3 + 1]);
+			double dlat = llh[i * 3 + 1] - got[i * 3 + 1];
+			horiz       = std::max(horiz, std::hypot(dlon, dlat) * Earth::R1);
+			vert        = std::max(vert, std::abs(llh[i * 3 + 2] - got[i * 3 + 2]) * Earth::R1);
+		}
+	}
+
+	// One altitude band at precision T: the legacy and new scalar versions and the SoA one, timed, with their errors.
+	template <class T> void sweep_one(const std::vector<double>& llh, const std::vector<double>& ecef64, const char* band) {
+		const int n = llh.size() / 3;
+		std::vector<T> ecef = cast<T>(ecef64), outLegacy(n * 3), outNew(n * 3), outSoa(n * 3);
+		std::vector<T> ix(n), iy(n), iz(n), ox(n), oy(n), oz(n);
+		for (int i = 0; i < n; i++) ix[i] = ecef[i * 3 + 0], iy[i] = ecef[i * 3 + 1], iz[i] = ecef[i * 3 + 2];
+
+		auto t0 = Clock::now();
+		legacy_ecef_to_geodetic(outLegacy.data(), n, ecef.data());
+		auto t1 = Clock::now();
+		ecef_to_geodetic(outNew.data(), n, ecef.data());
+		auto t2 = Clock::now();
+		ecef_to_geodetic_soa(ox.data(), oy.data(), oz.data(), n, ix.data(), iy.data(), iz.data());
+		auto t3 = Clock::now();
+		for (int i = 0; i < n; i++) outSoa[i * 3 + 0] = ox[i], outSoa[i * 3 + 1] = oy[i], outSoa[i * 3 + 2] = oz[i];
+
+		double h[3], v[3];
+		geodetic_error_m(llh, to_double(outLegacy), h[0], v[0]);
+		geodetic_error_m(llh, to_double(outNew), h[1], v[1]);
+		geodetic_error_m(llh, to_double(outSoa), h[2], v[2]);
+
+		auto mpts = [n](auto a, auto b) { return n / std::chrono::duration<double, std::micro>(b - a).count(); };
+		fmt::print("  {:<18} {:<6}  legacy {:>6.1f} Mpt/s  h {:.1e} v {:.1e} m   closed form {:>6.1f} Mpt/s  h {:.1e} v {:.1e} m   soa {:>6.1f} Mpt/s  h {:.1e} v {:.1e} m\n",
+				   band, sizeof(T) == 4 ? "float" : "double", mpts(t0, t1), h[0], v[0], mpts(t1, t2), h[1], v[1], mpts(t2, t3), h[2], v[2]);
+	}
+
+	// The error of ecef_to_geodetic vs. the geodetic coordinates the points were made from, by altitude band.
+	void sweep(int n) {
+		struct Band {
+			const char* name;
+			double lo, hi; // meters
+		};
+		const Band bands[] = {
+			{ "-1km .. 0", -1'000, 0 },
+			{ "0 .. 10km", 0, 10'000 },
+			{ "10km .. 1000km", 10'000, 1'000'000 },
+			{ "1000km .. 40000km", 1'000'000, 40'000'000 },
+			{ "-6300km .. -1km", -6'300'000, -1'000 },
+		};
+
+		fmt::print("ecef_to_geodetic vs. the true coordinates (worst horizontal and vertical error):\n");
+		std::mt19937_64 rng(1);
+		std::uniform_real_distribution<double> lon(-M_PI, M_PI), lat(-M_PI / 2, M_PI / 2);
+		for (const Band& band : bands) {
+			std::uniform_real_distribution<double> alt(band.lo / Earth::R1, band.hi / Earth::R1);
+			std::vector<double> llh(n * 3), ecef(n * 3);
+			for (int i = 0; i < n; i++) llh[i * 3 + 0] = lon(rng), llh[i * 3 + 1] = lat(rng), llh[i * 3 + 2] = alt(rng);
+			geodetic_to_ecef(ecef.data(), n, llh.data());
+			sweep_one<double>(llh, ecef, band.name);
+			sweep_one<float>(llh, ecef, band.name);
+		}
+	}
+
+	// Overload sets do not convert to std::function by themselves.
+	template <class T> Aos<T> aos(void (*f)(T*, int, const T*, int)) {
+		return [f](T* o, int n, const T* i) { f(o, n, i, 3); };
+	}
+	template <class T> Aos<T> aos(void (*f)(T*, int, const T*)) {
+		return [f](T* o, int n, const T* i) { f(o, n, i); };
+	}
+}
+
+int main(int argc, char** argv) {
+	int n = argc > 1 ? std::atoi(argv[1]) : 1'000'000;
+	Inputs in = make_inputs(n);
+
+	using D = double;
+	using F = float;
+
+	// Bounds: see `conversions.h`.
+	run<D>("geodetic_to_ecef", in.llh, false, aos<D>(geodetic_to_ecef), aos<D>(geodetic_to_ecef), aos<D>(geodetic_to_ecef_batch), geodetic_to_ecef_soa, 2e-15);
+	run<F>("geodetic_to_ecef", in.llh, false, aos<D>(geodetic_to_ecef), aos<F>(geodetic_to_ecef), aos<F>(geodetic_to_ecef_batch), geodetic_to_ecef_soa, 1e-6);
+	run<D>("unit_wm_to_ecef", in.uwm, false, aos<D>(unit_wm_to_ecef), aos<D>(unit_wm_to_ecef), aos<D>(unit_wm_to_ecef_batch), unit_wm_to_ecef_soa, 2e-15);
+	run<F>("unit_wm_to_ecef", in.uwm, false, aos<D>(unit_wm_to_ecef), aos<F>(unit_wm_to_ecef), aos<F>(unit_wm_to_ecef_batch), unit_wm_to_ecef_soa, 1e-6);
+	run<D>("ecef_to_geodetic", in.ecef, true, aos<D>(ecef_to_geodetic), aos<D>(ecef_to_geodetic), aos<D>(ecef_to_geodetic_batch), ecef_to_geodetic_soa, 2e-15);
+	run<F>("ecef_to_geodetic", in.ecef, true, aos<D>(ecef_to_geodetic), aos<F>(ecef_to_geodetic), aos<F>(ecef_to_geodetic_batch), ecef_to_geodetic_soa, 1e-6);
+
+	sweep(std::max(n / 4, 1));
+
+	return allOk ? 0 : 1;
+}
@@ -72,62 +72,44 @@ namespace wg {
 		out[2] = n[2];
     }
 
-	void ecef_to_geodetic(double* out, int n, const double* x) {
-		for (int i = 0; i < n; i++) {
-			const double xx = x[i * 3 + 0], yy = x[i * 3 + 1], zz = x[i * 3 + 2];
-
-			out[i * 3 + 0] = std::atan2(yy, xx);
-
-			double k  = 1. / (1. - e2);
-			double z  = zz;
-			double z2 = z * z;
-			double p2 = xx * xx + yy * yy;
-			double p  = std::sqrt(p2);
-			for (int j = 0; j < 2; j++) {
-				const double c_i = std::pow(((1 - e2) * z2) * (k * k) + p2, 1.5) / e2;
-				k                = (c_i + (1 - e2) * z2 * pow(k, 3)) / (c_i - p2);
-			}
-			out[i * 3 + 1] = std::atan2(k * z, p);
-
-			double rn        = a / std::sqrt(1. - e2 * pow(sin(out[i * 3 + 1]), 2.));
-			double sinabslat = sin(abs(out[i * 3 + 1]));
-			double coslat    = cos(out[i * 3 + 1]);
-			out[i * 3 + 2]   = (abs(z) + p - rn * (coslat + (1 - e2) * sinabslat)) / (coslat + sinabslat);
+	namespace {
+		//
+		// Vermeille's closed form ("Direct transformation from geocentric coordinates to geodetic coordinates", J. Geodesy 2002):
+		// no iteration, one cbrt and a few sqrts. Valid everywhere but within ~e^2 a (43km) of the earth's center,
+		// where the evolute of the ellipse is and the result is zeroed (as is a nan input).
+		// Worst case error, see `conversions.h`.
+		//
+		template <class T> inline void ecef_to_geodetic_one(T* out, T x, T y, T z) {
+			constexpr T e2_ = static_cast<T>(e2);
+			constexpr T e4  = static_cast<T>(e2 * e2);
+
+			const T pp = x * x + y * y;
+			const T q  = (1 - e2_) * z * z;
+			const T r  = (pp + q - e4) / 6;
+			const T s  = e4 * pp * q / (4 * r * r * r);
+			const T t  = std::cbrt(1 + s + std::sqrt(s * (2 + s)));
+			const T u  = r * (1 + t + 1 / t);
+			const T v  = std::sqrt(u * u + e4 * q);
+			const T w  = e2_ * (u + v - q) / (2 * v);
+			const T k  = std::sqrt(u + v + w * w) - w;
+			const T d  = k * std::sqrt(pp) / (k + e2_);
+			const T dz = std::sqrt(d * d + z * z);
+
+			out[0] = std::atan2(y, x);
+			out[1] = 2 * std::atan2(z, d + dz);
+			out[2] = (k + e2_ - 1) / k * dz;
 
 			// Never allow nan.
-			if (std::isnan(out[i*3+0]) or std::isnan(out[i*3+1]) or std::isnan(out[i*3+2])) {
-				out[i*3+0] = out[i*3+1] = out[i*3+2] = 0;
-			}
+			if (std::isnan(out[0]) or std::isnan(out[1]) or std::isnan(out[2])) out[0] = out[1] = out[2] = 0;
 		}
 	}
 
-	void ecef_to_geodetic(float* out, int n, const float* x) {
-		for (int i = 0; i < n; i++) {
-			const float xx = x[i * 3 + 0], yy = x[i * 3 + 1], zz = x[i * 3 + 2];
-
-			out[i * 3 + 0] = std::atan2(yy, xx);
-
-			float k  = 1. / (1. - static_cast<float>(e2));
-			float z  = zz;
-			float z2 = z * z;
-			float p2 = xx * xx + yy * yy;
-			float p  = std::sqrt(p2);
-			for (int j = 0; j < 2; j++) {
-				const float c_i = std::pow(((1 - static_cast<float>(e2)) * z2) * (k * k) + p2, 1.5f) / static_cast<float>(e2);
-				k                = (c_i + (1 - static_cast<float>(e2)) * z2 * pow(k, 3)) / (c_i - p2);
-			}
-			out[i * 3 + 1] = std::atan2(k * z, p);
-
-			float rn        = a / std::sqrt(1. - static_cast<float>(e2) * pow(sin(out[i * 3 + 1]), 2.f));
-			float sinabslat = sin(abs(out[i * 3 + 1]));
-			float coslat    = cos(out[i * 3 + 1]);
-			out[i * 3 + 2]   = (abs(z) + p - rn * (coslat + (1 - static_cast<float>(e2)) * sinabslat)) / (coslat + sinabslat);
+	void ecef_to_geodetic(double* out, int n, const double* x) {
+		for (int i = 0; i < n; i++) ecef_to_geodetic_one(out + i * 3, x[i * 3 + 0], x[i * 3 + 1], x[i * 3 + 2]);
+	}
 
-			// Never allow nan.
-			if (std::isnan(out[i*3+0]) or std::isnan(out[i*3+1]) or std::isnan(out[i*3+2])) {
-				out[i*3+0] = out[i*3+1] = out[i*3+2] = 0;
-			}
-		}
+	void ecef_to_geodetic(float* out, int n, const float* x) {
+		for (int i = 0; i < n; i++) ecef_to_geodetic_one(out + i * 3, x[i * 3 + 0], x[i * 3 + 1], x[i * 3 + 2]);
 	}
 
 
@@ -8,6 +8,11 @@ void unit_wm_to_geodetic(double* out, int n, const double* xyz);
 
 void unit_wm_to_ecef(double* out, int n, const double* xyz);
 
+// ECEF -> (lon, lat, alt), by Vermeille's closed form (no iteration). The float and batched versions are the same method.
+// Worst case error vs. the true coordinates, from -6300km (78km from the center) to 40000km of altitude (`benchConversions`):
+//     double: 3e-8 m (horizontal and vertical)
+//     float : 2 m (10 m vertically above 1000km): about what rounding the input to float costs already
+// Within ~43km of the center, or for nan inputs, all three outputs are 0.
 void ecef_to_geodetic(double* out, int n, const double* x);
 
 
@@ -21,6 +26,28 @@ void unit_wm_to_ecef(float* out, int n, const float* xyz, int stride=3);
 
 void ecef_to_geodetic(float* out, int n, const float* x);
 
+// Batched and vectorized versions of the above (see `conversionsSimd.cc`), for converting many points at once.
+// The strided (AoS) ones take point i at `xyz[i*stride + 0..2]` and may work in place, like the scalar ones.
+// The SoA ones take one array per component, and may also work in place.
+//
+// Worst case differences from the scalar double versions, over the globe and -1km .. 10000km of altitude,
+// in units of the semi-major axis or radians (checked by `benchConversions`, which fails if they are exceeded):
+//     double: 2e-15
+//     float : 1e-6 (a few ulp of the largest coordinates, and no worse than the scalar float versions)
+void geodetic_to_ecef_batch(double* out, int n, const double* llh, int stride=3);
+void geodetic_to_ecef_batch(float* out, int n, const float* llh, int stride=3);
+void unit_wm_to_ecef_batch(double* out, int n, const double* xyz, int stride=3);
+void unit_wm_to_ecef_batch(float* out, int n, const float* xyz, int stride=3);
+void ecef_to_geodetic_batch(double* out, int n, const double* xyz, int stride=3);
+void ecef_to_geodetic_batch(float* out, int n, const float* xyz, int stride=3);
+
+void geodetic_to_ecef_soa(double* ox, double* oy, double* oz, int n, const double* lon, const double* lat, const double* alt);
+void geodetic_to_ecef_soa(float* ox, float* oy, float* oz, int n, const float* lon, const float* lat, const float* alt);
+void unit_wm_to_ecef_soa(double* ox, double* oy, double* oz, int n, const double* x, const double* y, const double* z);
+void unit_wm_to_ecef_soa(float* ox, float* oy, float* oz, int n, const float* x, const float* y, const float* z);
+void ecef_to_geodetic_soa(double* ox, double* oy, double* oz, int n, const double* x, const double* y, const double* z);
+void ecef_to_geodetic_soa(float* ox, float* oy, float* oz, int n, const float* x, const float* y, const float* z);
+
 void wgs84_normal(double *out, const double* xyz);
 
 void ltp(double *out, const double* xyz);
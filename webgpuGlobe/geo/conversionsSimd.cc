@@ -0,0 +1,160 @@
+#include "conversions.h"
+#include "earth.hpp"
+#include "simdMath.hpp"
+
+#include <algorithm>
+
+//
+// The batched conversions: the same math as `conversions.cc`, a vector of points at a time (see `simdMath.hpp`).
+// `benchConversions` checks them against the scalar versions and times both.
+//
+
+namespace wg {
+    using namespace Earth;
+    using namespace simd;
+
+	namespace {
+
+		// Each kernel converts one vector of points in place, one vector per component.
+
+		// (lon, lat, alt) -> ECEF, all in units of the semi-major axis.
+		template <class V> inline void k_geodetic_to_ecef(V& x, V& y, V& z) {
+			using T = ScalarOf<V>;
+			V sin_lamb, cos_lamb, sin_phi, cos_phi;
+			vsincos(x, sin_lamb, cos_lamb);
+			vsincos(y, sin_phi, cos_phi);
+			const V n_phi = T(a) / vsqrt(T(1) - T(e2) * sin_phi * sin_phi);
+
+			x = (n_phi + z) * cos_phi * cos_lamb;
+			y = (n_phi + z) * cos_phi * sin_lamb;
+			z = (T(b2_over_a2) * n_phi + z) * sin_phi;
+		}
+
+		// Unit WM -> ECEF. The latitude is only needed through its sine and cosine, which follow from t = exp(y pi) directly:
+		//     lat = 2 atan(t) - pi/2  =>  sin(lat) = (t^2 - 1) / (t^2 + 1),  cos(lat) = 2t / (t^2 + 1)
+		// so there is one exp and no atan or second sincos.
+		template <class V> inline void k_unit_wm_to_ecef(V& x, V& y, V& z) {
+			using T = ScalarOf<V>;
+			V sin_lamb, cos_lamb;
+			vsincos(x * T(M_PI), sin_lamb, cos_lamb);
+			const V t       = vexp(y * T(M_PI));
+			const V t2      = t * t;
+			const V inv     = T(1) / (t2 + T(1));
+			const V sin_phi = (t2 - T(1)) * inv;
+			const V cos_phi = T(2) * t * inv;
+			const V alt     = z * T(M_PI);
+			const V n_phi   = T(a) / vsqrt(T(1) - T(e2) * sin_phi * sin_phi);
+
+			x = (n_phi + alt) * cos_phi * cos_lamb;
+			y = (n_phi + alt) * cos_phi * sin_lamb;
+			z = (T(b2_over_a2) * n_phi + alt) * sin_phi;
+		}
+
+		// ECEF -> (lon, lat, alt). Vermeille's closed form, like the scalar version (see `conversions.cc`).
+		template <class V> inline void k_ecef_to_geodetic(V& x, V& y, V& z) {
+			using T         = ScalarOf<V>;
+			constexpr T e2_ = static_cast<T>(e2);
+			constexpr T e4  = static_cast<T>(e2 * e2);
+
+			const V pp = x * x + y * y;
+			const V q  = (1 - e2_) * z * z;
+			const V r  = (pp + q - e4) * T(1. / 6.);
+			const V s  = e4 * pp * q / (4 * r * r * r);
+			const V t  = vcbrt(1 + s + vsqrt(s * (2 + s)));
+			const V u  = r * (1 + t + 1 / t);
+			const V v  = vsqrt(u * u + e4 * q);
+			const V w  = e2_ * (u + v - q) / (2 * v);
+			const V k  = vsqrt(u + v + w * w) - w;
+			const V d  = k * vsqrt(pp) / (k + e2_);
+			const V dz = vsqrt(d * d + z * z);
+
+			const V lon = vatan2(y, x);
+			const V lat = 2 * vatan2(z, d + dz);
+			const V alt = (k + e2_ - 1) / k * dz;
+
+			// Never allow nan (near the center, or nan in): all three are zeroed, like the scalar version does.
+			const auto bad = (lon != lon) | (lat != lat) | (alt != alt);
+			x              = select(bad, V{}, lon);
+			y              = select(bad, V{}, lat);
+			z              = select(bad, V{}, alt);
+		}
+
+		// Strided AoS. The lanes past `n` are zeros and are not written back.
+		template <class T, class K> inline void run_aos(T* out, int n, const T* in, int stride, K kernel) {
+			using V         = typename Lanes<T>::V;
+			constexpr int N = Lanes<T>::N;
+			for (int i = 0; i < n; i += N) {
+				const int m = std::min(N, n - i);
+				V x {}, y {}, z {};
+				for (int l = 0; l < m; l++) {
+					const T* p = in + (size_t)(i + l) * stride;
+					x[l] = p[0], y[l] = p[1], z[l] = p[2];
+				}
+				kernel(x, y, z);
+				for (int l = 0; l < m; l++) {
+					T* p = out + (size_t)(i + l) * stride;
+					p[0] = x[l], p[1] = y[l], p[2] = z[l];
+				}
+			}
+		}
+
+		template <class T, class K> inline void run_soa(T* ox, T* oy, T* oz, int n, const T* ix, const T* iy, const T* iz, K kernel) {
+			using V         = typename Lanes<T>::V;
+			constexpr int N = Lanes<T>::N;
+			int i           = 0;
+			for (; i + N <= n; i += N) {
+				V x, y, z;
+				__builtin_memcpy(&x, ix + i, sizeof(V));
+				__builtin_memcpy(&y, iy + i, sizeof(V));
+				__builtin_memcpy(&z, iz + i, sizeof(V));
+				kernel(x, y, z);
+				__builtin_memcpy(ox + i, &x, sizeof(V));
+				__builtin_memcpy(oy + i, &y, sizeof(V));
+				__builtin_memcpy(oz + i, &z, sizeof(V));
+			}
+			if (i < n) {
+				V x {}, y {}, z {};
+				for (int l = 0; l < n - i; l++) x[l] = ix[i + l], y[l] = iy[i + l], z[l] = iz[i + l];
+				kernel(x, y, z);
+				for (int l = 0; l < n - i; l++) ox[i + l] = x[l], oy[i + l] = y[l], oz[i + l] = z[l];
+			}
+		}
+
+		struct GeodeticToEcef {
+			template <class V> inline void operator()(V& x, V& y, V& z) const { k_geodetic_to_ecef(x, y, z); }
+		};
+		struct UnitWmToEcef {
+			template <class V> inline void operator()(V& x, V& y, V& z) const { k_unit_wm_to_ecef(x, y, z); }
+		};
+		struct EcefToGeodetic {
+			template <class V> inline void operator()(V& x, V& y, V& z) const { k_ecef_to_geodetic(x, y, z); }
+		};
+	}
+
+	void geodetic_to_ecef_batch(double* out, int n, const double* llh, int stride) { run_aos(out, n, llh, stride, GeodeticToEcef {}); }
+	void geodetic_to_ecef_batch(float* out, int n, const float* llh, int stride) { run_aos(out, n, llh, stride, GeodeticToEcef {}); }
+	void unit_wm_to_ecef_batch(double* out, int n, const double* xyz, int stride) { run_aos(out, n, xyz, stride, UnitWmToEcef {}); }
+	void unit_wm_to_ecef_batch(float* out, int n, const float* xyz, int stride) { run_aos(out, n, xyz, stride, UnitWmToEcef {}); }
+	void ecef_to_geodetic_batch(double* out, int n, const double* xyz, int stride) { run_aos(out, n, xyz, stride, EcefToGeodetic {}); }
+	void ecef_to_geodetic_batch(float* out, int n, const float* xyz, int stride) { run_aos(out, n, xyz, stride, EcefToGeodetic {}); }
+
+	void geodetic_to_ecef_soa(double* ox, double* oy, double* oz, int n, const double* lon, const double* lat, const double* alt) {
+		run_soa(ox, oy, oz, n, lon, lat, alt, GeodeticToEcef {});
+	}
+	void geodetic_to_ecef_soa(float* ox, float* oy, float* oz, int n, const float* lon, const float* lat, const float* alt) {
+		run_soa(ox, oy, oz, n, lon, lat, alt, GeodeticToEcef {});
+	}
+	void unit_wm_to_ecef_soa(double* ox, double* oy, double* oz, int n, const double* x, const double* y, const double* z) {
+		run_soa(ox, oy, oz, n, x, y, z, UnitWmToEcef {});
+	}
+	void unit_wm_to_ecef_soa(float* ox, float* oy, float* oz, int n, const float* x, const float* y, const float* z) {
+		run_soa(ox, oy, oz, n, x, y, z, UnitWmToEcef {});
+	}
+	void ecef_to_geodetic_soa(double* ox, double* oy, double* oz, int n, const double* x, const double* y, const double* z) {
+		run_soa(ox, oy, oz, n, x, y, z, EcefToGeodetic {});
+	}
+	void ecef_to_geodetic_soa(float* ox, float* oy, float* oz, int n, const float* x, const float* y, const float* z) {
+		run_soa(ox, oy, oz, n, x, y, z, EcefToGeodetic {});
+	}
+
+}
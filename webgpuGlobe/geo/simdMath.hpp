@@ -0,0 +1,213 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <type_traits>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+//
+// Just enough vector math for the batched conversions in `conversionsSimd.cc`: sincos, exp, cbrt, atan2 and sqrt on
+// 128 bit vectors of float (4 lanes) or double (2 lanes).
+//
+// The vectors are GCC/Clang vector extensions, so this is SSE2 on x86_64, NEON on aarch64, and plain lanes elsewhere.
+// The polynomials are Cephes', with branches turned into selects: every lane does the same work.
+// Inputs are assumed to be modest (|x| < 8192 for sincos, |x| < 80 for exp), which is all the conversions need.
+//
+
+namespace wg {
+namespace simd {
+
+	typedef float   f32x4 __attribute__((vector_size(16)));
+	typedef int32_t i32x4 __attribute__((vector_size(16)));
+	typedef double  f64x2 __attribute__((vector_size(16)));
+	typedef int64_t i64x2 __attribute__((vector_size(16)));
+
+	template <class T> struct Lanes;
+	template <> struct Lanes<float> {
+		using V = f32x4;
+		using I = i32x4;
+		static constexpr int N = 4;
+	};
+	template <> struct Lanes<double> {
+		using V = f64x2;
+		using I = i64x2;
+		static constexpr int N = 2;
+	};
+
+	// (A cast between two vector types of the same size reinterprets the bits)
+	template <class V, class I> inline V select(I mask, V a, V b) {
+		return (V)(((I)a & mask) | ((I)b & ~mask));
+	}
+
+	template <class V> using ScalarOf = std::remove_reference_t<decltype(V{}[0])>;
+
+	// (`-V{}` is -0 in every lane: just the sign bits)
+	template <class V> inline V vabs(V x) {
+		using I = decltype(x < x);
+		return (V)((I)x & ~(I)(-V{}));
+	}
+
+	template <class V, class I> inline V flipSign(V x, I mask) {
+		return (V)((I)x ^ (mask & (I)(-V{})));
+	}
+
+	inline f32x4 vsqrt(f32x4 x) {
+#if defined(__SSE2__)
+		return (f32x4)_mm_sqrt_ps((__m128)x);
+#else
+		for (int i = 0; i < 4; i++) x[i] = std::sqrt(x[i]);
+		return x;
+#endif
+	}
+
+	inline f64x2 vsqrt(f64x2 x) {
+#if defined(__SSE2__)
+		return (f64x2)_mm_sqrt_pd((__m128d)x);
+#else
+		for (int i = 0; i < 2; i++) x[i] = std::sqrt(x[i]);
+		return x;
+#endif
+	}
+
+	// -----------------------------------------------------------------------------------------------------
+	// sincos: reduce to [-pi/4, pi/4] by multiples of pi/4 (in three parts), then a polynomial for each.
+	// -----------------------------------------------------------------------------------------------------
+
+	inline void vsincos(f32x4 x, f32x4& s, f32x4& c) {
+		const f32x4 ax = vabs(x);
+		i32x4 j        = __builtin_convertvector(ax * (float)(4 / M_PI), i32x4);
+		j              = (j + 1) & ~1;
+		const f32x4 y  = __builtin_convertvector(j, f32x4);
+		const f32x4 r  = ((ax - y * 0.78515625f) - y * 2.4187564849853515625e-4f) - y * 3.77489497744594108e-8f;
+		const f32x4 z  = r * r;
+
+		const f32x4 ps = ((-1.9515295891e-4f * z + 8.3321608736e-3f) * z - 1.6666654611e-1f) * z * r + r;
+		const f32x4 pc = ((2.443315711809948e-5f * z - 1.388731625493765e-3f) * z + 4.166664568298827e-2f) * z * z - .5f * z + 1.f;
+
+		// j is 0, 2, 4 or 6 (mod 8): the octant pair. Odd pairs swap the polynomials, and the signs follow the quadrant.
+		const i32x4 swap = (j & 2) != 0;
+		s                = flipSign(select(swap, pc, ps), ((j & 4) != 0) ^ (x < 0));
+		c                = flipSign(select(swap, ps, pc), ((j + 2) & 4) != 0);
+	}
+
+	inline void vsincos(f64x2 x, f64x2& s, f64x2& c) {
+		const f64x2 ax = vabs(x);
+		i64x2 j        = __builtin_convertvector(ax * (4 / M_PI), i64x2);
+		j              = (j + 1) & ~1;
+		const f64x2 y  = __builtin_convertvector(j, f64x2);
+		const f64x2 r  = ((ax - y * 7.85398125648498535156e-1) - y * 3.77489470793079817668e-8) - y * 2.69515142907905952645e-15;
+		const f64x2 z  = r * r;
+
+		const f64x2 ps = r + r * z
+							 * (((((1.58962301576546568060e-10 * z - 2.50507477628578072866e-8) * z + 2.75573136213857245213e-6) * z
+								  - 1.98412698295895385996e-4) * z + 8.33333333332211858878e-3) * z - 1.66666666666666307295e-1);
+		const f64x2 pc = 1. - .5 * z + z * z
+							 * (((((-1.13585365213876817300e-11 * z + 2.08757008419747316778e-9) * z - 2.75573141792967388112e-7) * z
+								  + 2.48015872888517045348e-5) * z - 1.38888888888730564116e-3) * z + 4.16666666666665929218e-2);
+
+		const i64x2 swap = (j & 2) != 0;
+		s                = flipSign(select(swap, pc, ps), ((j & 4) != 0) ^ (x < 0));
+		c                = flipSign(select(swap, ps, pc), ((j + 2) & 4) != 0);
+	}
+
+	// -----------------------------------------------------------------------------------------------------
+	// exp: x = n ln2 + r, |r| <= ln2 / 2, then 2^n by adding to the exponent bits.
+	// -----------------------------------------------------------------------------------------------------
+
+	inline f32x4 vexp(f32x4 x) {
+		// Round to nearest with the 1.5 * 2^23 trick: the integer ends up in the low mantissa bits.
+		const f32x4 magic = f32x4{} + 12582912.f;
+		const f32x4 t     = x * (float)M_LOG2E + magic;
+		const i32x4 n     = (i32x4)t - (i32x4)magic;
+		const f32x4 fn    = t - magic;
+		const f32x4 r     = (x - fn * 0.693359375f) - fn * -2.12194440e-4f;
+
+		const f32x4 p = (((((1.9875691500e-4f * r + 1.3981999507e-3f) * r + 8.3334519073e-3f) * r + 4.1665795894e-2f) * r
+						  + 1.6666665459e-1f) * r + 5.0000001201e-1f) * r * r + r + 1.f;
+		return (f32x4)((i32x4)p + (n << 23));
+	}
+
+	inline f64x2 vexp(f64x2 x) {
+		const f64x2 magic = f64x2{} + 6755399441055744.0; // 1.5 * 2^52
+		const f64x2 t     = x * M_LOG2E + magic;
+		const i64x2 n     = (i64x2)t - (i64x2)magic;
+		const f64x2 fn    = t - magic;
+		const f64x2 r     = (x - fn * 6.93145751953125e-1) - fn * 1.42860682030941723212e-6;
+		const f64x2 rr    = r * r;
+
+		// exp(r) = 1 + 2 r P(r^2) / (Q(r^2) - r P(r^2))
+		const f64x2 px = r * ((1.26177193074810590878e-4 * rr + 3.02994407707441961300e-2) * rr + 9.99999999999999999910e-1);
+		const f64x2 qx = ((3.00198505138664455042e-6 * rr + 2.52448340349684104192e-3) * rr + 2.27265548208155028766e-1) * rr
+						 + 2.00000000000000000009e0;
+		const f64x2 e = 1. + 2. * px / (qx - px);
+		return (f64x2)((i64x2)e + (n << 52));
+	}
+
+	// -----------------------------------------------------------------------------------------------------
+	// cbrt (of positive x): a guess from the exponent bits (divided by 3), then Halley steps, which triple the digits each.
+	// -----------------------------------------------------------------------------------------------------
+
+	inline f32x4 vcbrt(f32x4 x) {
+		const f32x4 bits = __builtin_convertvector((i32x4)x, f32x4) * (1.f / 3.f);
+		f32x4 y          = (f32x4)(__builtin_convertvector(bits, i32x4) + 0x2a514067);
+		for (int i = 0; i < 2; i++) {
+			const f32x4 y3 = y * y * y;
+			y              = y * (y3 + 2.f * x) / (2.f * y3 + x);
+		}
+		return y;
+	}
+
+	inline f64x2 vcbrt(f64x2 x) {
+		const f64x2 bits = __builtin_convertvector((i64x2)x, f64x2) * (1. / 3.);
+		f64x2 y          = (f64x2)(__builtin_convertvector(bits, i64x2) + 0x2a9f7893782da1ceLL);
+		for (int i = 0; i < 3; i++) {
+			const f64x2 y3 = y * y * y;
+			y              = y * (y3 + 2. * x) / (2. * y3 + x);
+		}
+		return y;
+	}
+
+	// -----------------------------------------------------------------------------------------------------
+	// atan2: atan on [0, 1] (the smaller of |x|, |y| over the larger), then unfold the octant.
+	// -----------------------------------------------------------------------------------------------------
+
+	inline f32x4 vatan01(f32x4 t) {
+		const i32x4 big = t > 0.4142135623730950f;
+		const f32x4 u   = select(big, (t - 1.f) / (t + 1.f), t);
+		const f32x4 z   = u * u;
+		const f32x4 a   = (((8.05374449538e-2f * z - 1.38776856032e-1f) * z + 1.99777106478e-1f) * z - 3.33329491539e-1f) * z * u + u;
+		return a + select(big, f32x4{} + (float)M_PI_4, f32x4{});
+	}
+
+	inline f64x2 vatan01(f64x2 t) {
+		const i64x2 big = t > 0.66;
+		const f64x2 u   = select(big, (t - 1.) / (t + 1.), t);
+		const f64x2 z   = u * u;
+		const f64x2 p   = (((-8.750608600031904122785e-1 * z - 1.615753718733365076637e1) * z - 7.500855792314704667340e1) * z
+						   - 1.228866684490136173410e2) * z - 6.485021904942025371773e1;
+		const f64x2 q   = ((((z + 2.485846490142306297962e1) * z + 1.650270098316988542046e2) * z + 4.328810604912902668951e2) * z
+						   + 4.853903996359136964868e2) * z + 1.945506571482613964425e2;
+		const f64x2 a   = u * (z * p / q) + u;
+		// (pi/4 is added in two parts, the second being what the double pi/4 is missing)
+		return a + select(big, f64x2{} + M_PI_4, f64x2{}) + select(big, f64x2{} + 3.061616997868382943065e-17, f64x2{});
+	}
+
+	template <class V> inline V vatan2(V y, V x) {
+		using I       = decltype(x < x);
+		using T       = ScalarOf<V>;
+		const V ax    = vabs(x), ay = vabs(y);
+		const I swap  = ay > ax;
+		const V num   = select(swap, ax, ay);
+		const V den   = select(swap, ay, ax);
+		const V t     = select(den > 0, num / den, V{});
+		V a           = vatan01(t);
+		a             = select(swap, (V{} + T(M_PI_2)) - a, a);
+		a             = select(x < 0, (V{} + T(M_PI)) - a, a);
+		return flipSign(a, (I)y < 0);
+	}
+
+}
+}
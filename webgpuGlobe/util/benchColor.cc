@@ -0,0 +1,71 @@
+#include "colorKernels.h"
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <fmt/core.h>
+
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <vector>
+
+//
+// The fused tile color kernel (`color_to_rgba`) vs. the OpenCV chain it replaced in `TiffTileBuilder::build`:
+//     cvtColor(GRAY2BGR) (1 band only) -> addWeighted(colorMult) (if != 1) -> cvtColor(RGB2RGBA) -> alpha = 255
+// on random 256x256 tiles, for 1 and 3 bands, with and without a gain. Checks that all three give the same bytes.
+//
+//     benchColor [iters=2000]
+//
+
+namespace {
+	using namespace wg;
+	using Clock = std::chrono::high_resolution_clock;
+
+	void opencv_chain(const cv::Mat& in, double colorMult, cv::Mat& out) {
+		cv::Mat mat0 = in.clone();
+		if (mat0.channels() == 1) cv::cvtColor(mat0, mat0, cv::COLOR_GRAY2BGR);
+		if (colorMult != 1) cv::addWeighted(mat0, colorMult, mat0, 0, 0, mat0);
+		out.create(mat0.rows, mat0.cols, CV_8UC4);
+		cv::cvtColor(mat0, out, cv::COLOR_RGB2RGBA);
+		for (int y = 0; y < out.rows; y++)
+			for (int x = 0; x < out.cols; x++) out.data[y * out.step + x * 4 + 3] = 255;
+	}
+}
+
+int main(int argc, char** argv) {
+	int iters = argc > 1 ? std::atoi(argv[1]) : 2000;
+	constexpr int S = 256;
+
+	std::mt19937 rng(0);
+	bool allSame = true;
+
+	for (int channels : { 1, 3 }) {
+		for (double colorMult : { 1.0, 1.3, .7 }) {
+			cv::Mat in(S, S, channels == 1 ? CV_8UC1 : CV_8UC3);
+			for (size_t i = 0; i < in.total() * in.elemSize(); i++) in.data[i] = rng();
+
+			cv::Mat ref;
+			std::vector<uint8_t> fused(S * S * 4), scalar(S * S * 4);
+
+			auto t0 = Clock::now();
+			for (int it = 0; it < iters; it++) opencv_chain(in, colorMult, ref);
+			auto t1 = Clock::now();
+			simdEnabled() = false;
+			for (int it = 0; it < iters; it++) color_to_rgba(in.data, channels, S * S, (float)colorMult, scalar.data());
+			auto t2 = Clock::now();
+			simdEnabled() = true;
+			for (int it = 0; it < iters; it++) color_to_rgba(in.data, channels, S * S, (float)colorMult, fused.data());
+			auto t3 = Clock::now();
+
+			bool same = memcmp(ref.data, fused.data(), fused.size()) == 0 and memcmp(ref.data, scalar.data(), scalar.size()) == 0;
+			allSame &= same;
+
+			auto us = [&](auto a, auto b) { return std::chrono::duration<double, std::micro>(b - a).count() / iters; };
+			fmt::print("{} band(s), colorMult {:.1f}: opencv {:>7.1f}us  scalar {:>7.1f}us  fused {:>7.1f}us  ({:.1f}x)  {}\n", channels,
+					   colorMult, us(t0, t1), us(t1, t2), us(t2, t3), us(t0, t1) / us(t2, t3), same ? "(same output)" : "(OUTPUT DIFFERS)");
+		}
+	}
+
+	return allSame ? 0 : 1;
+}
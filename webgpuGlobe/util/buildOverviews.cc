@@ -0,0 +1,76 @@
+#include <gdal_priv.h>
+#include <cpl_conv.h>
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+//
+// Adds the overviews (2x, 4x, 8x, ... down to `minSize` pixels) that a raster is missing, so that `GdalDataset` can
+// read low zoom tiles from a small overview instead of resampling the full resolution raster.
+//
+//     buildOverviews <path> [resampling=AVERAGE] [minSize=256] [--external]
+//
+// Overviews are written into the file itself, or to `<path>.ovr` with `--external` (or if the file can not be opened for update).
+// Overview factors that already exist are left alone, so it is cheap to re-run.
+//
+
+int main(int argc, char** argv) {
+	if (argc < 2) {
+		fmt::print("Usage: {} <path> [resampling=AVERAGE] [minSize=256] [--external]\n", argv[0]);
+		return 1;
+	}
+
+	std::string path       = argv[1];
+	std::string resampling = argc > 2 ? argv[2] : "AVERAGE";
+	int minSize            = argc > 3 ? std::atoi(argv[3]) : 256;
+	bool external          = argc > 4 and std::string(argv[4]) == "--external";
+
+	GDALAllRegister();
+	CPLSetConfigOption("GDAL_NUM_THREADS", "ALL_CPUS");
+	CPLSetConfigOption("COMPRESS_OVERVIEW", "DEFLATE");
+
+	GDALDataset* dset = nullptr;
+	if (not external) dset = (GDALDataset*)GDALOpen(path.c_str(), GA_Update);
+	if (dset == nullptr) {
+		if (not external) fmt::print("could not open '{}' for update, writing external overviews\n", path);
+		dset = (GDALDataset*)GDALOpen(path.c_str(), GA_ReadOnly);
+	}
+	if (dset == nullptr or dset->GetRasterCount() == 0) {
+		fmt::print("could not open '{}'\n", path);
+		return 1;
+	}
+
+	int w = dset->GetRasterXSize(), h = dset->GetRasterYSize();
+	GDALRasterBand* band = dset->GetRasterBand(1);
+
+	std::vector<int> have;
+	for (int i = 0; i < band->GetOverviewCount(); i++) {
+		if (GDALRasterBand* ovr = band->GetOverview(i)) have.push_back((int)std::lround(static_cast<double>(w) / ovr->GetXSize()));
+	}
+
+	std::vector<int> missing;
+	for (int f = 2; std::max(w, h) / f >= minSize; f *= 2) {
+		if (std::find(have.begin(), have.end(), f) == have.end()) missing.push_back(f);
+	}
+
+	fmt::print("'{}': {}x{}, {} bands, {} overviews present, {} to build\n", path, w, h, dset->GetRasterCount(), have.size(), missing.size());
+	if (missing.empty()) {
+		GDALClose(dset);
+		return 0;
+	}
+	for (int f : missing) fmt::print("   - {}x ({}x{})\n", f, (w + f - 1) / f, (h + f - 1) / f);
+
+	CPLErr err = dset->BuildOverviews(resampling.c_str(), (int)missing.size(), missing.data(), 0, nullptr, GDALTermProgress, nullptr);
+	GDALClose(dset);
+
+	if (err != CE_None) {
+		fmt::print("BuildOverviews failed\n");
+		return 1;
+	}
+	fmt::print("done\n");
+	return 0;
+}
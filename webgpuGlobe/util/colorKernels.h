@@ -0,0 +1,96 @@
+#pragma once
+
+#include "simd.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+//
+// Tile imagery as read from GDAL (1 band gray or 3 band RGB, 8 bit) -> RGBA8 with a gain, in one pass.
+// Replaces the OpenCV chain `cvtColor(GRAY2BGR)` -> `addWeighted(gain)` -> `cvtColor(RGB2RGBA)` -> set alpha, and gives
+// the same bytes: the gain is done like `addWeighted` does it for 8 bit (float multiply, round half to even, saturate).
+// `benchColor` compares the two.
+//
+// The gray path is SSE2. The RGB path is `expand3to4_ssse3`, picked at runtime. `simdEnabled` turns both off.
+//
+
+namespace wg {
+
+	inline uint8_t color_gain_u8(uint8_t v, float gain) {
+		float f = std::nearbyint(static_cast<float>(v) * gain);
+		return f <= 0 ? 0 : f >= 255 ? 255 : static_cast<uint8_t>(f);
+	}
+
+	inline void color_to_rgba_scalar(const uint8_t* in, int channels, size_t npix, float gain, uint8_t* out) {
+		bool doGain = gain != 1.f;
+		for (size_t i = 0; i < npix; i++) {
+			uint8_t r, g, b;
+			if (channels == 1) r = g = b = in[i];
+			else r = in[i * 3 + 0], g = in[i * 3 + 1], b = in[i * 3 + 2];
+			if (doGain) r = color_gain_u8(r, gain), g = color_gain_u8(g, gain), b = color_gain_u8(b, gain);
+			out[i * 4 + 0] = r;
+			out[i * 4 + 1] = g;
+			out[i * 4 + 2] = b;
+			out[i * 4 + 3] = 255;
+		}
+	}
+
+#if defined(__SSE2__)
+	// `x * gain` for 16 bytes: widen to 4x 4 floats, multiply, round (MXCSR default: half to even), pack with saturation.
+	inline __m128i color_gain_16(__m128i x, __m128 gain) {
+		const __m128i zero = _mm_setzero_si128();
+		__m128i lo = _mm_unpacklo_epi8(x, zero), hi = _mm_unpackhi_epi8(x, zero);
+		__m128i a = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)), gain));
+		__m128i b = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)), gain));
+		__m128i c = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)), gain));
+		__m128i d = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)), gain));
+		return _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+	}
+
+	// 16 gray pixels per iteration: gain on the gray bytes, then two unpacks spread each to 4 bytes.
+	inline void color_gray_to_rgba_sse2(const uint8_t* in, size_t npix, float gain, uint8_t* out) {
+		const __m128i alpha = _mm_set1_epi32(0xFF000000);
+		const __m128 vgain  = _mm_set1_ps(gain);
+		bool doGain         = gain != 1.f;
+		size_t i = 0;
+		for (; i + 16 <= npix; i += 16) {
+			__m128i g = _mm_loadu_si128((const __m128i*)(in + i));
+			if (doGain) g = color_gain_16(g, vgain);
+			__m128i gg0 = _mm_unpacklo_epi8(g, g), gg1 = _mm_unpackhi_epi8(g, g);
+			_mm_storeu_si128((__m128i*)(out + i * 4 + 0), _mm_or_si128(_mm_unpacklo_epi16(gg0, gg0), alpha));
+			_mm_storeu_si128((__m128i*)(out + i * 4 + 16), _mm_or_si128(_mm_unpackhi_epi16(gg0, gg0), alpha));
+			_mm_storeu_si128((__m128i*)(out + i * 4 + 32), _mm_or_si128(_mm_unpacklo_epi16(gg1, gg1), alpha));
+			_mm_storeu_si128((__m128i*)(out + i * 4 + 48), _mm_or_si128(_mm_unpackhi_epi16(gg1, gg1), alpha));
+		}
+		color_to_rgba_scalar(in + i, 1, npix - i, gain, out + i * 4);
+	}
+
+	// The gain goes on all 16 shuffled bytes, the alpha is set after it.
+	inline void color_rgb_to_rgba_ssse3(const uint8_t* in, size_t npix, float gain, uint8_t* out) {
+		const __m128i shuf = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+		const __m128 vgain = _mm_set1_ps(gain);
+		size_t i           = gain != 1.f ? expand3to4_ssse3(in, npix, out, shuf, [vgain](__m128i v) { return color_gain_16(v, vgain); })
+										 : expand3to4_ssse3(in, npix, out, shuf, [](__m128i v) { return v; });
+		color_to_rgba_scalar(in + i * 3, 3, npix - i, gain, out + i * 4);
+	}
+#endif
+
+	// `in` is `npix` packed pixels of 1 (gray) or 3 (RGB) bytes. `out` gets `npix` RGBA pixels, alpha 255.
+	inline void color_to_rgba(const uint8_t* in, int channels, size_t npix, float gain, uint8_t* out) {
+#if defined(__SSE2__)
+		if (simdEnabled()) {
+			if (channels == 1) {
+				color_gray_to_rgba_sse2(in, npix, gain, out);
+				return;
+			}
+			if (channels == 3 and haveSsse3()) {
+				color_rgb_to_rgba_ssse3(in, npix, gain, out);
+				return;
+			}
+		}
+#endif
+		color_to_rgba_scalar(in, channels, npix, gain, out);
+	}
+
+}
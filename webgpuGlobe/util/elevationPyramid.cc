@@ -0,0 +1,290 @@
+#include "elevationPyramid.h"
+#include "gdalDataset.h"
+#include "parallel.h"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <memory>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace wg {
+
+	namespace {
+		inline int16_t to_units(double v, double noData, bool hasNoData, float metersPerUnit) {
+			if (std::isnan(v) or (hasNoData and v == noData)) return ElevationPyramid::kNoData;
+			double u = std::round(v / metersPerUnit);
+			return (int16_t)std::clamp(u, -32767., 32767.);
+		}
+
+		bool file_exists(const std::string& path) {
+			struct stat buf;
+			return stat(path.c_str(), &buf) == 0 and buf.st_size > 0;
+		}
+	}
+
+	bool ElevationPyramid::build(const std::string& srcPath, const std::string& outPath) {
+		std::unique_ptr<GdalDataset> src;
+		try {
+			src = std::make_unique<GdalDataset>(srcPath);
+		} catch (std::exception& e) {
+			SPDLOG_ERROR("[ElevationPyramid::build] could not open '{}': {}", srcPath, e.what());
+			return false;
+		}
+
+		// int16 meters fit as they are. Anything else is stored in .5m units, which still covers +-16km.
+		float metersPerUnit = (src->gdalType == GDT_Int16 or src->gdalType == GDT_Byte) ? 1.f : .5f;
+		int hasNoData_      = 0;
+		double noData       = src->bands[0]->GetNoDataValue(&hasNoData_);
+		bool hasNoData      = hasNoData_ != 0;
+
+		std::vector<LevelHeader> lvls;
+		uint32_t lw = src->w, lh = src->h;
+		while (true) {
+			lvls.push_back(LevelHeader { lw, lh, 0 });
+			if (std::max(lw, lh) <= kMinLevelSize) break;
+			lw = (lw + 1) / 2, lh = (lh + 1) / 2;
+		}
+
+		uint64_t total = sizeof(Header) + lvls.size() * sizeof(LevelHeader);
+		for (auto& l : lvls) {
+			total    = (total + 63) & ~uint64_t(63);
+			l.offset = total;
+			total += (uint64_t)l.w * l.h * sizeof(int16_t);
+		}
+
+		SPDLOG_INFO("[ElevationPyramid::build] '{}' ({}x{}) -> '{}', {} levels, {:.1f}MB", srcPath, src->w, src->h, outPath, lvls.size(),
+					total / double(1 << 20));
+
+		// Written in place through a shared mapping, so that a large level 0 never has to fit in memory.
+		std::string tmpPath = outPath + ".tmp";
+		int fd = ::open(tmpPath.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+		if (fd < 0) return false;
+		if (ftruncate(fd, total) != 0) {
+			::close(fd);
+			return false;
+		}
+		void* p = mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		::close(fd);
+		if (p == MAP_FAILED) return false;
+		uint8_t* base = static_cast<uint8_t*>(p);
+
+		Header hdr {};
+		memcpy(hdr.magic, kMagic, sizeof(kMagic));
+		hdr.nlevels       = lvls.size();
+		hdr.metersPerUnit = metersPerUnit;
+		for (int i = 0; i < 6; i++) hdr.nativeFromPix[i] = src->native_from_pix(i / 3, i % 3);
+		memcpy(base, &hdr, sizeof(hdr));
+		memcpy(base + sizeof(hdr), lvls.data(), lvls.size() * sizeof(LevelHeader));
+
+		// Level 0, in strips of rows.
+		bool ok = true;
+		{
+			constexpr int kStrip = 256;
+			int16_t* dst = reinterpret_cast<int16_t*>(base + lvls[0].offset);
+			std::vector<double> buf((size_t)src->w * kStrip);
+			for (int y = 0; y < src->h and ok; y += kStrip) {
+				int rows = std::min(kStrip, src->h - y);
+				ok = src->bands[0]->RasterIO(GF_Read, 0, y, src->w, rows, buf.data(), src->w, rows, GDT_Float64, 0, 0) == CE_None;
+				for (size_t i = 0; ok and i < (size_t)src->w * rows; i++) dst[(size_t)y * src->w + i] = to_units(buf[i], noData, hasNoData, metersPerUnit);
+			}
+		}
+
+		// Each next level: the mean of the valid pixels of each 2x2 (clamped at odd edges).
+		for (size_t k = 1; ok and k < lvls.size(); k++) {
+			const LevelHeader& pl = lvls[k - 1];
+			const LevelHeader& l  = lvls[k];
+			const int16_t* prev   = reinterpret_cast<const int16_t*>(base + pl.offset);
+			int16_t* cur          = reinterpret_cast<int16_t*>(base + l.offset);
+
+			parallelFor(l.h, defaultThreadCount(), [&](size_t y, int) {
+				const int16_t* r0 = prev + (size_t)std::min<uint32_t>(2 * y, pl.h - 1) * pl.w;
+				const int16_t* r1 = prev + (size_t)std::min<uint32_t>(2 * y + 1, pl.h - 1) * pl.w;
+				for (uint32_t x = 0; x < l.w; x++) {
+					uint32_t x0 = std::min(2 * x, pl.w - 1), x1 = std::min(2 * x + 1, pl.w - 1);
+					int16_t vs[4] = { r0[x0], r0[x1], r1[x0], r1[x1] };
+					int sum = 0, n = 0;
+					for (int16_t v : vs)
+						if (v != kNoData) sum += v, n++;
+					cur[y * l.w + x] = n ? (int16_t)((sum + (sum >= 0 ? n / 2 : -n / 2)) / n) : kNoData;
+				}
+			});
+		}
+
+		msync(base, total, MS_SYNC);
+		munmap(base, total);
+
+		if (not ok or rename(tmpPath.c_str(), outPath.c_str()) != 0) {
+			SPDLOG_ERROR("[ElevationPyramid::build] failed to build '{}'", outPath);
+			unlink(tmpPath.c_str());
+			return false;
+		}
+		return true;
+	}
+
+	bool ElevationPyramid::open(const std::string& path) {
+		close();
+		if (not file.open(path, false)) return false;
+
+		Header hdr;
+		if (file.size() < sizeof(hdr)) return close(), false;
+		memcpy(&hdr, file.data(), sizeof(hdr));
+		if (memcmp(hdr.magic, kMagic, sizeof(kMagic)) != 0 or hdr.nlevels == 0 or hdr.nlevels > 32) return close(), false;
+		if (file.size() < sizeof(hdr) + hdr.nlevels * sizeof(LevelHeader)) return close(), false;
+
+		for (uint32_t i = 0; i < hdr.nlevels; i++) {
+			LevelHeader l;
+			memcpy(&l, file.data() + sizeof(hdr) + i * sizeof(LevelHeader), sizeof(l));
+			if (l.w == 0 or l.h == 0 or l.offset % alignof(int16_t) != 0 or l.offset + (uint64_t)l.w * l.h * sizeof(int16_t) > file.size())
+				return close(), false;
+			levels.push_back(Level { l.w, l.h, reinterpret_cast<const int16_t*>(file.data() + l.offset) });
+		}
+
+		metersPerUnit = hdr.metersPerUnit;
+		Eigen::Matrix3d nativeFromPix;
+		nativeFromPix << hdr.nativeFromPix[0], hdr.nativeFromPix[1], hdr.nativeFromPix[2], hdr.nativeFromPix[3], hdr.nativeFromPix[4],
+			hdr.nativeFromPix[5], 0, 0, 1;
+		pixFromNative = nativeFromPix.inverse().topRows<2>();
+		return true;
+	}
+
+	bool ElevationPyramid::openOrBuild(const std::string& dtedPath) {
+		std::string path = pathFor(dtedPath);
+		if (not file_exists(path)) {
+			SPDLOG_WARN("[ElevationPyramid] making '{}', this may take a while...", path);
+			if (not build(dtedPath, path)) return false;
+		}
+		return open(path);
+	}
+
+	void ElevationPyramid::close() {
+		file.close();
+		levels.clear();
+	}
+
+	void ElevationPyramid::sampleWm(const Eigen::Vector4d& tlbrWm, cv::Mat& out) const {
+		assert(out.type() == CV_32FC1 and out.isContinuous());
+		Eigen::Matrix<double, 4, 2> pts;
+		pts << (pixFromNative * Eigen::Vector3d{tlbrWm(0), tlbrWm(1), 1.}).transpose(),
+			(pixFromNative * Eigen::Vector3d{tlbrWm(2), tlbrWm(1), 1.}).transpose(),
+			(pixFromNative * Eigen::Vector3d{tlbrWm(2), tlbrWm(3), 1.}).transpose(),
+			(pixFromNative * Eigen::Vector3d{tlbrWm(0), tlbrWm(3), 1.}).transpose();
+		Eigen::Vector4d tlbrPix{pts.col(0).minCoeff(), pts.col(1).minCoeff(), pts.col(0).maxCoeff(), pts.col(1).maxCoeff()};
+		samplePix(tlbrPix, out.cols, out.rows, (float*)out.data);
+	}
+
+	void ElevationPyramid::samplePix(const Eigen::Vector4d& tlbrPix, int outW, int outH, float* out) const {
+		double x0 = std::min(tlbrPix(0), tlbrPix(2)), x1 = std::max(tlbrPix(0), tlbrPix(2));
+		double y0 = std::min(tlbrPix(1), tlbrPix(3)), y1 = std::max(tlbrPix(1), tlbrPix(3));
+		double stepX = (x1 - x0) / outW, stepY = (y1 - y0) / outH;
+
+		// The coarsest level whose pixels are no larger than the output's.
+		int k = 0;
+		double step = std::min(stepX, stepY);
+		while (k + 1 < (int)levels.size() and double(1 << (k + 1)) <= step * (1 + 1e-6)) k++;
+		const Level& L = levels[k];
+		const double s = 1.0 / (1 << k);
+
+		// Output pixel i's center, as a (fractional) pixel index of level k.
+		// (GDAL's convention: pixel i spans [i, i+1), its center is i + .5)
+		auto toLevel = [s](double lo, double step, int i) { return (lo + (i + .5) * step) * s - .5; };
+
+		// The column weights are the same for every row.
+		constexpr int kMaxStack = 512;
+		int colX0_[kMaxStack], colX1_[kMaxStack];
+		float colF_[kMaxStack], colValid_[kMaxStack];
+		std::vector<int> colX0v, colX1v;
+		std::vector<float> colFv, colValidv;
+		int *colX0 = colX0_, *colX1 = colX1_;
+		float *colF = colF_, *colValid = colValid_;
+		if (outW > kMaxStack) {
+			colX0v.resize(outW), colX1v.resize(outW), colFv.resize(outW), colValidv.resize(outW);
+			colX0 = colX0v.data(), colX1 = colX1v.data(), colF = colFv.data(), colValid = colValidv.data();
+		}
+
+		for (int i = 0; i < outW; i++) {
+			double c     = toLevel(x0, stepX, i);
+			colValid[i]  = (c >= -.5 and c <= L.w - .5) ? 1.f : 0.f;
+			c            = std::clamp(c, 0., (double)L.w - 1);
+			int ci       = (int)c;
+			colX0[i]     = ci;
+			colX1[i]     = std::min<int>(ci + 1, L.w - 1);
+			colF[i]      = (float)(c - ci);
+		}
+
+		const float mpu = metersPerUnit;
+		for (int j = 0; j < outH; j++) {
+			float* dst = out + (size_t)j * outW;
+			double r   = toLevel(y0, stepY, j);
+			if (r < -.5 or r > L.h - .5) {
+				std::fill(dst, dst + outW, 0.f);
+				continue;
+			}
+			r = std::clamp(r, 0., (double)L.h - 1);
+			int ri            = (int)r;
+			const float fy    = (float)(r - ri);
+			const int16_t* r0 = L.data + (size_t)ri * L.w;
+			const int16_t* r1 = L.data + (size_t)std::min<int>(ri + 1, L.h - 1) * L.w;
+
+			// Bilinear over the taps that have data: the weights are renormalized over those, so that nodata does not
+			// pull its neighbours down (a partial blend with -32768 would get past the callers' nodata checks).
+			// Only when all four taps are nodata is the result nodata. (`kTapEps` lets a valid tap count even at zero weight)
+			constexpr float kTapEps = 1e-6f;
+			const float noDataOut   = kNoData * mpu;
+
+			int i = 0;
+#if defined(__SSE2__)
+			// Four columns at a time. (The loads are a gather, which SSE2 does not have, so those stay scalar.)
+			const __m128 vfy     = _mm_set1_ps(fy);
+			const __m128 vmpu    = _mm_set1_ps(mpu);
+			const __m128 vone    = _mm_set1_ps(1.f);
+			const __m128 veps    = _mm_set1_ps(kTapEps);
+			const __m128 vzero   = _mm_setzero_ps();
+			const __m128 vnodata = _mm_set1_ps((float)kNoData);
+			const __m128 vndOut  = _mm_set1_ps(noDataOut);
+			for (; i + 4 <= outW; i += 4) {
+				__m128 v00 = _mm_setr_ps(r0[colX0[i]], r0[colX0[i + 1]], r0[colX0[i + 2]], r0[colX0[i + 3]]);
+				__m128 v01 = _mm_setr_ps(r0[colX1[i]], r0[colX1[i + 1]], r0[colX1[i + 2]], r0[colX1[i + 3]]);
+				__m128 v10 = _mm_setr_ps(r1[colX0[i]], r1[colX0[i + 1]], r1[colX0[i + 2]], r1[colX0[i + 3]]);
+				__m128 v11 = _mm_setr_ps(r1[colX1[i]], r1[colX1[i + 1]], r1[colX1[i + 2]], r1[colX1[i + 3]]);
+				__m128 fx  = _mm_loadu_ps(colF + i);
+				__m128 gx  = _mm_sub_ps(vone, fx), gy = _mm_sub_ps(vone, vfy);
+				// Zero weight for nodata taps.
+				__m128 w00 = _mm_and_ps(_mm_add_ps(_mm_mul_ps(gx, gy), veps), _mm_cmpneq_ps(v00, vnodata));
+				__m128 w01 = _mm_and_ps(_mm_add_ps(_mm_mul_ps(fx, gy), veps), _mm_cmpneq_ps(v01, vnodata));
+				__m128 w10 = _mm_and_ps(_mm_add_ps(_mm_mul_ps(gx, vfy), veps), _mm_cmpneq_ps(v10, vnodata));
+				__m128 w11 = _mm_and_ps(_mm_add_ps(_mm_mul_ps(fx, vfy), veps), _mm_cmpneq_ps(v11, vnodata));
+				__m128 wsum = _mm_add_ps(_mm_add_ps(w00, w01), _mm_add_ps(w10, w11));
+				__m128 sum  = _mm_add_ps(_mm_add_ps(_mm_mul_ps(w00, v00), _mm_mul_ps(w01, v01)), _mm_add_ps(_mm_mul_ps(w10, v10), _mm_mul_ps(w11, v11)));
+				__m128 any  = _mm_cmpgt_ps(wsum, vzero);
+				__m128 v    = _mm_div_ps(sum, _mm_or_ps(_mm_and_ps(any, wsum), _mm_andnot_ps(any, vone)));
+				v           = _mm_or_ps(_mm_and_ps(any, _mm_mul_ps(v, vmpu)), _mm_andnot_ps(any, vndOut));
+				_mm_storeu_ps(dst + i, _mm_mul_ps(v, _mm_loadu_ps(colValid + i)));
+			}
+#endif
+			for (; i < outW; i++) {
+				const float v[4] = { (float)r0[colX0[i]], (float)r0[colX1[i]], (float)r1[colX0[i]], (float)r1[colX1[i]] };
+				const float fx = colF[i];
+				const float w[4] = { (1 - fx) * (1 - fy), fx * (1 - fy), (1 - fx) * fy, fx * fy };
+				float sum = 0, wsum = 0;
+				for (int t = 0; t < 4; t++) {
+					if (v[t] == kNoData) continue;
+					sum += (w[t] + kTapEps) * v[t];
+					wsum += w[t] + kTapEps;
+				}
+				dst[i] = (wsum > 0 ? sum / wsum * mpu : noDataOut) * colValid[i];
+			}
+		}
+	}
+
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "mappedFile.h"
+
+#include <Eigen/Core>
+#include <opencv2/core.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace wg {
+
+	//
+	// An elevation raster (the `dtedPath` dataset) as a memory-mapped int16 pyramid, for sampling small grids fast.
+	// Every tiff tile needs just an E x E grid of heights: through GDAL that is a whole `RasterIO` call per tile,
+	// costing much more than the few dozen samples it returns. From the pyramid it is a bilinear lookup per sample.
+	//
+	// Built once from the source raster into `<dtedPath>.pyr` (see `openOrBuild`):
+	//     Header
+	//     LevelHeader levels[nlevels]
+	//     level data: int16 row major, level 0 is the full resolution, each next level is a 2x2 average of the last,
+	//                 down to one no larger than 256 pixels.
+	// Heights are stored as `int16 * metersPerUnit` (1m for int16 sources, .5m for float ones), with -32768 as nodata.
+	//
+	// Sampling reproduces `GdalDataset::getWm` with bilinear resampling (same pixel center convention), from the
+	// coarsest level that still has the output's resolution.
+	//
+
+	struct ElevationPyramid {
+
+		static constexpr char kMagic[8]       = { 'W','G','E','L','P','Y','R','1' };
+		static constexpr int16_t kNoData      = -32768;
+		static constexpr uint32_t kMinLevelSize = 256;
+
+		struct Header {
+			char magic[8];
+			uint32_t nlevels;
+			float metersPerUnit;
+			double nativeFromPix[6]; // row major 2x3, like `GdalDataset::native_from_pix`, for level 0.
+		};
+
+		struct LevelHeader {
+			uint32_t w, h;
+			uint64_t offset; // from the start of the file, in bytes.
+		};
+
+		ElevationPyramid() = default;
+
+		ElevationPyramid(const ElevationPyramid&)            = delete;
+		ElevationPyramid& operator=(const ElevationPyramid&) = delete;
+
+		static inline std::string pathFor(const std::string& dtedPath) { return dtedPath + ".pyr"; }
+
+		// Builds `outPath` from the GDAL raster at `srcPath` (band 1). Returns false on failure.
+		static bool build(const std::string& srcPath, const std::string& outPath);
+
+		// Maps a built pyramid. Returns false if it is missing or malformed.
+		bool open(const std::string& path);
+
+		// Opens `pathFor(dtedPath)`, building it first if it does not exist yet.
+		bool openOrBuild(const std::string& dtedPath);
+
+		void close();
+		inline bool isOpen() const { return file.isOpen(); }
+
+		// Fill `out` (CV_32FC1, already sized) with heights in meters over the WM box `tlbrWm`.
+		// Samples outside the raster are 0. Nodata pixels are left out of the interpolation; where all four taps are nodata,
+		// the sample reads as a large negative height (-32768 units), which callers treat as nodata.
+		void sampleWm(const Eigen::Vector4d& tlbrWm, cv::Mat& out) const;
+
+		// The same over a box in level 0 pixel coordinates, into `outW x outH` floats.
+		void samplePix(const Eigen::Vector4d& tlbrPix, int outW, int outH, float* out) const;
+
+		inline int numLevels() const { return levels.size(); }
+
+		private:
+		struct Level {
+			uint32_t w, h;
+			const int16_t* data;
+		};
+
+		MappedFile file;
+		float metersPerUnit = 1;
+		Eigen::Matrix<double, 2, 3, Eigen::RowMajor> pixFromNative;
+		std::vector<Level> levels;
+	};
+
+}
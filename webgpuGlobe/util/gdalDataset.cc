@@ -6,6 +6,8 @@
 // #include <opencv2/highgui.hpp>
 
 #include <algorithm>
+#include <cmath>
+#include <cstring>
 
 #include <spdlog/spdlog.h>
 
@@ -111,6 +113,13 @@ GdalDataset::GdalDataset(const std::string& path, bool isTerrain) : isTerrain(is
 	w							 = dset->GetRasterXSize();
 	h							 = dset->GetRasterYSize();
 
+	for (int i = 0; i < bands[0]->GetOverviewCount(); i++) {
+		GDALRasterBand* ovr = bands[0]->GetOverview(i);
+		overviewFactors.push_back(ovr ? static_cast<double>(w) / ovr->GetXSize() : 0);
+	}
+	if (overviewFactors.empty() and std::max(w, h) > 8192)
+		SPDLOG_WARN("dset '{}' is {}x{} and has no overviews, low zoom reads will be slow. See `buildOverviews`.", path, w, h);
+
 	// Need gdal 3.10+ :(
 	// SPDLOG_INFO(" - Dataset is thread-safe: {}", dset->IsThreadSafe());
 	// exit(1);
@@ -137,7 +146,17 @@ GdalDataset::GdalDataset(const std::string& path, bool isTerrain) : isTerrain(is
 		SPDLOG_INFO("          matched level: {}", matchedPixelLevel);
 		SPDLOG_INFO("             pixel size: {}, with err {}", matchedPixelSize, bestErr);
 		SPDLOG_INFO("              rel error: {}", bestErr/matchedPixelSize);
-		if (matchedPixelLevel != -1 and bestErr / matchedPixelLevel < .001) {
+		// Aligned for the block copy path means exactly: same pixel size, no rotation, and an origin on the level's pixel grid.
+		// (Else the pixels drift off the WM grid across a large raster.)
+		if (matchedPixelLevel != -1 and bestErr / matchedPixelSize < 1e-6 and native_from_pix(0,1) == 0 and native_from_pix(1,0) == 0
+				and std::abs(std::abs(native_from_pix(1,1)) - matchedPixelSize) / matchedPixelSize < 1e-6) {
+			double ox = (native_from_pix(0,2) + Earth::WebMercatorScale) / matchedPixelSize;
+			double oy = (native_from_pix(1,2) + Earth::WebMercatorScale) / matchedPixelSize;
+			if (std::abs(ox - std::round(ox)) < 1e-3 and std::abs(oy - std::round(oy)) < 1e-3) alignedPixelLevel = matchedPixelLevel;
+		}
+		if (alignedPixelLevel != -1) {
+			SPDLOG_INFO(" - The dataset IS aligned to the WM quadtree (pixel level {}), using block copies.", alignedPixelLevel);
+		} else if (matchedPixelLevel != -1 and bestErr / matchedPixelSize < .001) {
 			SPDLOG_INFO(" - The dataset IS aligned to the WM quadtree.");
 		} else {
 			SPDLOG_INFO(" - The dataset IS NOT aligned to the WM quadtree.");
@@ -167,14 +186,75 @@ GdalDataset::~GdalDataset() {
 
 int GdalDataset::getNumOverviews() const { return bands[0]->GetOverviewCount(); }
 
-Vector4d GdalDataset::getWm(const Vector4d& tlbrWm, cv::Mat& out) {
+int GdalDataset::chooseOverview(double srcW, double srcH, int dstW, int dstH) const {
+	if (not useOverviews) return -1;
+
+	// The coarsest overview that is still at least as fine as the output. (A little slack, so that a window of exactly
+	// 2x the output is read from the 2x overview despite rounding.)
+	double ratio = std::min(srcW / dstW, srcH / dstH) * 1.001;
+	int best = -1;
+	double bestFactor = 1;
+	for (int i = 0; i < (int)overviewFactors.size(); i++) {
+		if (overviewFactors[i] > bestFactor and overviewFactors[i] <= ratio) {
+			best = i;
+			bestFactor = overviewFactors[i];
+		}
+	}
+	return best;
+}
+
+CPLErr GdalDataset::readWindow(int ovr, int xoff, int yoff, int xsize, int ysize, void* buf, int bufW, int bufH, GDALDataType type,
+							   int eleSize, GDALRasterIOExtraArg* arg) {
+	if (ovr < 0)
+		return dset->RasterIO(GF_Read, xoff, yoff, xsize, ysize, buf, bufW, bufH, type, nbands, nullptr,
+							  eleSize * nbands, eleSize * nbands * bufW, eleSize, arg);
+
+	// Map the window into the overview's pixels.
+	GDALRasterBand* ovr0 = bands[0]->GetOverview(ovr);
+	int ow = ovr0->GetXSize(), oh = ovr0->GetYSize();
+	double sx = static_cast<double>(ow) / w, sy = static_cast<double>(oh) / h;
+
+	int oxoff  = std::clamp((int)std::floor(xoff * sx), 0, ow - 1);
+	int oyoff  = std::clamp((int)std::floor(yoff * sy), 0, oh - 1);
+	int oxsize = std::clamp((int)std::lround(xsize * sx), 1, ow - oxoff);
+	int oysize = std::clamp((int)std::lround(ysize * sy), 1, oh - oyoff);
+
+	GDALRasterIOExtraArg ovrArg = *arg;
+	if (ovrArg.bFloatingPointWindowValidity) {
+		ovrArg.dfXOff  = arg->dfXOff * sx;
+		ovrArg.dfYOff  = arg->dfYOff * sy;
+		ovrArg.dfXSize = arg->dfXSize * sx;
+		ovrArg.dfYSize = arg->dfYSize * sy;
+		// GDAL rejects a floating point window that disagrees with the integer one, so keep them consistent.
+		if (ovrArg.dfXOff < 0 or ovrArg.dfYOff < 0 or ovrArg.dfXOff + ovrArg.dfXSize > ow or ovrArg.dfYOff + ovrArg.dfYSize > oh)
+			ovrArg.bFloatingPointWindowValidity = 0;
+		else {
+			oxoff  = (int)ovrArg.dfXOff;
+			oyoff  = (int)ovrArg.dfYOff;
+			oxsize = std::clamp((int)std::ceil(ovrArg.dfXOff + ovrArg.dfXSize) - oxoff, 1, ow - oxoff);
+			oysize = std::clamp((int)std::ceil(ovrArg.dfYOff + ovrArg.dfYSize) - oyoff, 1, oh - oyoff);
+		}
+	}
+
+	// Overviews are per band: read each into its place in the interleaved buffer.
+	for (int b = 0; b < nbands; b++) {
+		GDALRasterBand* band = bands[b]->GetOverview(ovr);
+		if (band == nullptr) return CE_Failure;
+		CPLErr err = band->RasterIO(GF_Read, oxoff, oyoff, oxsize, oysize, static_cast<uint8_t*>(buf) + b * eleSize, bufW, bufH, type,
+									eleSize * nbands, (GSpacing)eleSize * nbands * bufW, &ovrArg);
+		if (err != CE_None) return err;
+	}
+	return CE_None;
+}
+
+Vector4d GdalDataset::getWm(const Vector4d& tlbrWm, cv::Mat& out, bool* ok) {
 	RowMatrix42d pts;
 	pts << (pix_from_native * Vector3d{tlbrWm(0), tlbrWm(1), 1.}).transpose(),
 		(pix_from_native * Vector3d{tlbrWm(2), tlbrWm(1), 1.}).transpose(),
 		(pix_from_native * Vector3d{tlbrWm(2), tlbrWm(3), 1.}).transpose(),
 		(pix_from_native * Vector3d{tlbrWm(0), tlbrWm(3), 1.}).transpose();
 	Vector4d tlbrPix{pts.col(0).minCoeff(), pts.col(1).minCoeff(), pts.col(0).maxCoeff(), pts.col(1).maxCoeff()};
-	return getPix(tlbrPix, out);
+	return getPix(tlbrPix, out, ok);
 }
 
 Vector4d GdalDataset::getGlobalTileBoundsWm(int z, int y, int x) {
@@ -194,7 +274,77 @@ void GdalDataset::getGlobalTile(cv::Mat& out, uint32_t z, uint32_t y, uint32_t x
 	getWm(tlbr, out);
 }
 
-Vector4d GdalDataset::getPix(const Vector4d& tlbrPix, cv::Mat& out) {
+bool GdalDataset::tryBlockCopy(const Vector2d& tl, const Vector2d& br, cv::Mat& out, GDALDataType outType, int eleSize) {
+	if (alignedPixelLevel < 0 or not useBlockCopy) return false;
+	if (outType != gdalType or out.channels() != nbands or not out.isContinuous()) return false;
+
+	// The window must be an exact power of two multiple of the output size ...
+	int outw = out.cols, outh = out.rows;
+	double f = (br(0) - tl(0)) / outw;
+	int fi = (int)std::lround(f);
+	if (fi < 1 or std::abs(f - fi) > 1e-6 * fi or std::abs((br(1) - tl(1)) / outh - fi) > 1e-6 * fi) return false;
+
+	// ... with a level that has exactly that factor.
+	int ovr = -1, lw = w, lh = h;
+	if (fi > 1) {
+		if (not useOverviews) return false;
+		for (int i = 0; i < (int)overviewFactors.size(); i++) {
+			GDALRasterBand* ob = bands[0]->GetOverview(i);
+			if (ob and ob->GetXSize() * fi == w and ob->GetYSize() * fi == h) {
+				ovr = i, lw = ob->GetXSize(), lh = ob->GetYSize();
+				break;
+			}
+		}
+		if (ovr < 0) return false;
+	}
+
+	// ... at an integer pixel offset of that level, entirely inside it.
+	double lx = tl(0) / fi, ly = tl(1) / fi;
+	int x0 = (int)std::lround(lx), y0 = (int)std::lround(ly);
+	if (std::abs(lx - x0) > 1e-3 or std::abs(ly - y0) > 1e-3) return false;
+	if (x0 < 0 or y0 < 0 or x0 + outw > lw or y0 + outh > lh) return false;
+
+	GDALRasterBand* levelBands[4];
+	for (int b = 0; b < nbands; b++) {
+		levelBands[b] = ovr < 0 ? bands[b] : bands[b]->GetOverview(ovr);
+		if (levelBands[b] == nullptr) return false;
+	}
+
+	int bw, bh;
+	levelBands[0]->GetBlockSize(&bw, &bh);
+	if (bw <= 0 or bh <= 0) return false;
+
+	// Go through the block cache (rather than `ReadBlock`), so that blocks shared by neighbouring tiles are read once.
+	const size_t pixStride = (size_t)eleSize * nbands;
+	for (int by = y0 / bh; by <= (y0 + outh - 1) / bh; by++) {
+		for (int bx = x0 / bw; bx <= (x0 + outw - 1) / bw; bx++) {
+			int r0 = std::max(y0, by * bh), r1 = std::min(y0 + outh, (by + 1) * bh);
+			int c0 = std::max(x0, bx * bw), c1 = std::min(x0 + outw, (bx + 1) * bw);
+
+			for (int b = 0; b < nbands; b++) {
+				GDALRasterBlock* block = levelBands[b]->GetLockedBlockRef(bx, by);
+				if (block == nullptr) return false;
+				const uint8_t* src = static_cast<const uint8_t*>(block->GetDataRef());
+
+				for (int r = r0; r < r1; r++) {
+					const uint8_t* srow = src + ((size_t)(r - by * bh) * bw + (c0 - bx * bw)) * eleSize;
+					uint8_t* drow       = out.data + (size_t)(r - y0) * out.step + (size_t)(c0 - x0) * pixStride + (size_t)b * eleSize;
+					if (nbands == 1) {
+						memcpy(drow, srow, (size_t)(c1 - c0) * eleSize);
+					} else {
+						for (int c = 0; c < c1 - c0; c++) memcpy(drow + c * pixStride, srow + c * eleSize, eleSize);
+					}
+				}
+
+				block->DropLock();
+			}
+		}
+	}
+
+	return true;
+}
+
+Vector4d GdalDataset::getPix(const Vector4d& tlbrPix, cv::Mat& out, bool* ok) {
 	// SPDLOG_INFO("getPix :: {} size {} {} c {}", tlbrPix.transpose(), out.rows, out.cols, out.channels());
 	int outh = out.rows, outw = out.cols;
 
@@ -231,7 +381,11 @@ Vector4d GdalDataset::getPix(const Vector4d& tlbrPix, cv::Mat& out) {
 	if (bilinearSampling) arg.eResampleAlg = GRIORA_Bilinear;
 	else arg.eResampleAlg = GRIORA_NearestNeighbour;
 
-	if (xoff > 0 and xoff + xsize < w and yoff > 0 and yoff + ysize < h) {
+	if (tryBlockCopy(tl, br, out, gdalOutputType, eleSizeOut)) {
+		// TODO If converting from other terrain then GMTED, must modify here
+		if (isTerrain) transform_gmted((uint16_t*)out.data, outh, outw, gdalOutputType);
+
+	} else if (xoff > 0 and xoff + xsize < w and yoff > 0 and yoff + ysize < h) {
 		// FIXME: use greater precision with bFloatingPointWindowValidity
 
 
@@ -248,8 +402,8 @@ Vector4d GdalDataset::getPix(const Vector4d& tlbrPix, cv::Mat& out) {
 
 		// auto err = dset->RasterIO(GF_Read, xoff, yoff, xsize, ysize, out.data, outw, outh, gdalType, nbands, nullptr,
 								  // eleSize * nbands, eleSize * nbands * outw, eleSize, &arg);
-		auto err = dset->RasterIO(GF_Read, xoff, yoff, xsize, ysize, out.data, outw, outh, gdalOutputType, nbands, nullptr,
-								  eleSizeOut * nbands, eleSizeOut * nbands * outw, eleSizeOut, &arg);
+		int ovr = chooseOverview(br(0) - tl(0), br(1) - tl(1), outw, outh);
+		auto err = readWindow(ovr, xoff, yoff, xsize, ysize, out.data, outw, outh, gdalOutputType, eleSizeOut, &arg);
 		// SPDLOG_INFO(" - err: {}\n", err);
 
 		// TODO If converting from other terrain then GMTED, must modify here
@@ -262,7 +416,10 @@ Vector4d GdalDataset::getPix(const Vector4d& tlbrPix, cv::Mat& out) {
 		}
 		*/
 
-		if (err != CE_None) return Vector4d::Zero();
+		if (err != CE_None) {
+			if (ok) *ok = false;
+			return Vector4d::Zero();
+		}
 
 	} else if (xoff + xsize >= 1 and xoff < w and yoff + ysize >= 1 and yoff < h) {
 		// case where there is partial overlap
@@ -282,9 +439,12 @@ Vector4d GdalDataset::getPix(const Vector4d& tlbrPix, cv::Mat& out) {
 
 		// auto err = dset->RasterIO(GF_Read, inner(0), inner(1), inner_w, inner_h, tmp.data, read_w, read_h, gdalType,
 								  // nbands, nullptr, eleSize * nbands, eleSize * nbands * read_w, eleSize * 1, nullptr);
-		auto err = dset->RasterIO(GF_Read, inner(0), inner(1), inner_w, inner_h, tmp.data, read_w, read_h, gdalOutputType,
-								  nbands, nullptr, eleSizeOut * nbands, eleSizeOut * nbands * read_w, eleSizeOut * 1, &arg);
-		if (err != CE_None) return Vector4d::Zero();
+		int ovr = chooseOverview(inner_w, inner_h, read_w, read_h);
+		auto err = readWindow(ovr, inner(0), inner(1), inner_w, inner_h, tmp.data, read_w, read_h, gdalOutputType, eleSizeOut, &arg);
+		if (err != CE_None) {
+			if (ok) *ok = false;
+			return Vector4d::Zero();
+		}
 
 		// TODO If converting from other terrain then GMTED, must modify here
 		if (isTerrain) transform_gmted((uint16_t*)tmp.data, tmp.rows, tmp.cols, gdalOutputType);
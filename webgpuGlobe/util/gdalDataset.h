@@ -12,6 +12,8 @@
 
 #include <opencv2/core.hpp>
 
+#include <vector>
+
 namespace wg {
 
 using RowMatrix23d = Eigen::Matrix<double,2,3,Eigen::RowMajor>;
@@ -41,14 +43,31 @@ struct GdalDataset {
 		GdalDataset(const std::string& path, bool isTerrain=false);
 		~GdalDataset();
 
-		Vector4d getWm(const Vector4d& tlbrWm, cv::Mat& out);
-		Vector4d getPix(const Vector4d& tlbrPix, cv::Mat& out);
+		// If `ok` is given, it is cleared when GDAL fails a read (`out` is then garbage). A box off the raster is not a failure: it reads as zeros.
+		Vector4d getWm(const Vector4d& tlbrWm, cv::Mat& out, bool* ok = nullptr);
+		Vector4d getPix(const Vector4d& tlbrPix, cv::Mat& out, bool* ok = nullptr);
 		
 		void getGlobalTile(cv::Mat& out, uint32_t z, uint32_t y, uint32_t x);
 		static Vector4d getGlobalTileBoundsWm(int z, int y, int x);
 
 		int getNumOverviews() const;
 
+		// Reads use the coarsest overview that still has at least the output's resolution, rather than always
+		// resampling the full resolution band (which reads the whole window, e.g. 64k^2 pixels for a low zoom tile).
+		// See `util/buildOverviews.cc` for datasets that do not have overviews yet.
+		bool useOverviews = true;
+		inline void setUseOverviews(bool on) { useOverviews = on; }
+
+		// Downsampling factor of each overview vs. the full resolution (e.g. 2, 4, 8, ...), indexed like `GetOverview`.
+		std::vector<double> overviewFactors;
+
+		// If the dataset's pixels are exactly those of WM pixel level `alignedPixelLevel` (pixel size and origin), -1 if not.
+		// Then a tile read is an integer pixel window of the full res raster or of a 2^k overview, and `getPix` copies
+		// the native blocks (`GetBlockSize`) straight into the output, with no resampling.
+		int alignedPixelLevel = -1;
+		bool useBlockCopy = true;
+		inline void setUseBlockCopy(bool on) { useBlockCopy = on; }
+
 		RowMatrix23d pix_from_native;
 		RowMatrix23d native_from_pix;
 
@@ -59,6 +78,19 @@ struct GdalDataset {
 		inline void setUseSubpixelOffsets(bool on) { useSubpixelOffsets = on; }
 
 		Vector4d getWmTlbrOfDataset();
+
+	private:
+		// The overview to read a `srcW x srcH` (full res) window into a `dstW x dstH` buffer from. -1 is the full res bands.
+		int chooseOverview(double srcW, double srcH, int dstW, int dstH) const;
+
+		// Like `GDALDataset::RasterIO` with interleaved output, but from overview `ovr` (or full res if -1).
+		// The window is in full resolution pixels, and is scaled to the overview here.
+		CPLErr readWindow(int ovr, int xoff, int yoff, int xsize, int ysize, void* buf, int bufW, int bufH, GDALDataType type, int eleSize,
+						  GDALRasterIOExtraArg* arg);
+
+		// The aligned fast path. Returns false (having maybe written part of `out`) if the window is not an integer, unscaled
+		// window of some level, or the types differ, and `getPix` should do a normal read.
+		bool tryBlockCopy(const Vector2d& tl, const Vector2d& br, cv::Mat& out, GDALDataType outType, int eleSize);
 };
 
 
@@ -0,0 +1,87 @@
+#include "gdalDatasetPool.h"
+#include "options.h"
+
+#include <spdlog/spdlog.h>
+
+#include <cassert>
+
+namespace wg {
+
+	void GdalDatasetPool::Lease::release() {
+		if (dset) pool->giveBack(slot, dset);
+		dset = nullptr;
+	}
+
+	GdalDatasetPool::GdalDatasetPool(int maxPerPath) : maxPerPath(maxPerPath) {
+	}
+
+	GdalDatasetPool::~GdalDatasetPool() {
+		// Leases must not outlive the pool.
+		for (auto& it : slots) assert(it.second.idle.size() == it.second.all.size());
+	}
+
+	GdalDatasetPool::Lease GdalDatasetPool::acquire(const std::string& path, bool isTerrain) {
+		std::unique_lock<std::mutex> lck(mtx);
+		// The `isTerrain` flag changes how the dataset is opened, so it is part of the key.
+		Slot& slot = slots[isTerrain ? path + "\n1" : path];
+
+		while (true) {
+			if (slot.idle.size()) {
+				GdalDataset* dset = slot.idle.back();
+				slot.idle.pop_back();
+				return Lease(this, &slot, dset);
+			}
+
+			if (maxPerPath <= 0 or (int)slot.all.size() + slot.opening < maxPerPath) {
+				// Open without the lock held: it does IO, and other paths (or idle handles being returned) should not wait on it.
+				slot.opening++;
+				lck.unlock();
+				std::unique_ptr<GdalDataset> dset;
+				try {
+					dset = std::make_unique<GdalDataset>(path, isTerrain);
+				} catch (...) {
+					lck.lock();
+					slot.opening--;
+					cv.notify_all();
+					throw;
+				}
+				lck.lock();
+				slot.opening--;
+				GdalDataset* ptr = dset.get();
+				slot.all.push_back(std::move(dset));
+				SPDLOG_DEBUG("[GdalDatasetPool] opened handle #{} of '{}'", slot.all.size(), path);
+				return Lease(this, &slot, ptr);
+			}
+
+			cv.wait(lck);
+		}
+	}
+
+	int GdalDatasetPool::numOpen(const std::string& path, bool isTerrain) {
+		std::lock_guard<std::mutex> lck(mtx);
+		auto it = slots.find(isTerrain ? path + "\n1" : path);
+		return it == slots.end() ? 0 : it->second.all.size();
+	}
+
+	void GdalDatasetPool::giveBack(void* slot_, GdalDataset* dset) {
+		{
+			std::lock_guard<std::mutex> lck(mtx);
+			static_cast<Slot*>(slot_)->idle.push_back(dset);
+		}
+		// All: the waiters may be waiting on other paths.
+		cv.notify_all();
+	}
+
+	GdalDatasetPool& GdalDatasetPool::shared() {
+		static GdalDatasetPool pool;
+		return pool;
+	}
+
+	void configureGdalCache(const GlobeOptions& opts) {
+		double mb = opts.getDouble("gdalCacheMb", 0);
+		if (mb <= 0) return;
+		GDALSetCacheMax64(static_cast<GIntBig>(mb * (1 << 20)));
+		SPDLOG_INFO("[configureGdalCache] GDAL block cache set to {:.0f}MB", mb);
+	}
+
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "gdalDataset.h"
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace wg {
+
+	struct GlobeOptions;
+
+	//
+	// Hands out `GdalDataset`s to many threads. A `GDALDataset*` must not be used by two threads at once (before GDAL 3.10),
+	// so instead of sharing one, each thread leases a handle of its own for as long as it needs it.
+	//
+	// Handles are opened lazily, the first time all existing handles of a path are leased, and are kept open for reuse.
+	// With `maxPerPath > 0`, `acquire` blocks rather than open more than that many handles of one path.
+	//
+	// All handles of the process share GDAL's block cache (`GDAL_CACHEMAX`), so opening more handles does not multiply
+	// the memory used for cached blocks. See `configureGdalCache`.
+	//
+	// Usage:
+	//     auto dset = GdalDatasetPool::shared().acquire(path);
+	//     dset->getWm(tlbr, mat); // returned to the pool when `dset` goes out of scope.
+	//
+
+	struct GdalDatasetPool {
+
+		struct Lease {
+			inline Lease() = default;
+			inline Lease(Lease&& o) noexcept : pool(o.pool), slot(o.slot), dset(o.dset) { o.dset = nullptr; }
+			inline Lease& operator=(Lease&& o) noexcept {
+				if (this != &o) {
+					release();
+					pool = o.pool, slot = o.slot, dset = o.dset;
+					o.dset = nullptr;
+				}
+				return *this;
+			}
+			Lease(const Lease&)            = delete;
+			Lease& operator=(const Lease&) = delete;
+			inline ~Lease() { release(); }
+
+			inline GdalDataset* operator->() const { return dset; }
+			inline GdalDataset& operator*() const { return *dset; }
+			inline GdalDataset* get() const { return dset; }
+			inline explicit operator bool() const { return dset != nullptr; }
+
+			// Give the handle back early.
+			void release();
+
+			private:
+			friend struct GdalDatasetPool;
+			inline Lease(GdalDatasetPool* pool, void* slot, GdalDataset* dset) : pool(pool), slot(slot), dset(dset) {}
+
+			GdalDatasetPool* pool = nullptr;
+			void* slot            = nullptr;
+			GdalDataset* dset     = nullptr;
+		};
+
+		explicit GdalDatasetPool(int maxPerPath = 0);
+		~GdalDatasetPool();
+
+		GdalDatasetPool(const GdalDatasetPool&)            = delete;
+		GdalDatasetPool& operator=(const GdalDatasetPool&) = delete;
+
+		// Throws (like `GdalDataset`) if the dataset can not be opened.
+		Lease acquire(const std::string& path, bool isTerrain = false);
+
+		// Number of handles opened for `path` so far.
+		int numOpen(const std::string& path, bool isTerrain = false);
+
+		// The pool used by the tiff loader, `bakeTiles` and the tiff bb builder.
+		static GdalDatasetPool& shared();
+
+		private:
+		struct Slot {
+			std::vector<std::unique_ptr<GdalDataset>> all;
+			std::vector<GdalDataset*> idle;
+			int opening = 0;
+		};
+
+		void giveBack(void* slot, GdalDataset* dset);
+
+		int maxPerPath;
+		std::mutex mtx;
+		std::condition_variable cv;
+		std::unordered_map<std::string, Slot> slots;
+	};
+
+	// Sets GDAL's block cache size from the `gdalCacheMb` option, if given. It is one cache for the whole process.
+	// Many threads reading neighbouring tiles of the same rasters hit the same blocks, so it is worth making large
+	// enough to hold a few screens worth of tiles. (GDAL's default is 5% of RAM.)
+	void configureGdalCache(const GlobeOptions& opts);
+
+}
@@ -0,0 +1,81 @@
+#include "packFile.h"
+#include "mappedFile.h"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <dirent.h>
+#include <sys/stat.h>
+
+//
+// Packs every regular file of a directory into one `PackFile`, keyed by file name.
+//
+// For a gearth dataset:
+//     makePackFile <gearthPath>/node <gearthPath>/node.pack
+//     makePackFile <gearthPath>/bulk <gearthPath>/bulk.pack
+// `DiskGearthDataLoader` and the bb file builder use the packs instead of the directories when they exist.
+//
+// Pass `--append` to add to an existing pack (e.g. after an interrupted run): keys already in it are skipped.
+//
+
+using namespace wg;
+
+// Some filesystems (XFS, NFS, some overlays) do not fill in `d_type`: then ask `stat`.
+static bool isRegularFile(const std::string& dir, const struct dirent* ent) {
+	if (ent->d_type != DT_UNKNOWN) return ent->d_type == DT_REG;
+	struct stat st;
+	return stat((dir + "/" + ent->d_name).c_str(), &st) == 0 and S_ISREG(st.st_mode);
+}
+
+int main(int argc, char** argv) {
+	if (argc < 3) {
+		fmt::print("Usage: {} <inputDir> <output.pack> [--append]\n", argv[0]);
+		return 1;
+	}
+
+	std::string inDir   = argv[1];
+	std::string outPath = argv[2];
+	bool append         = argc > 3 and std::string(argv[3]) == "--append";
+
+	std::vector<std::string> names;
+	if (DIR* d = opendir(inDir.c_str())) {
+		while (struct dirent* ent = readdir(d))
+			if (isRegularFile(inDir, ent)) names.push_back(ent->d_name);
+		closedir(d);
+	} else {
+		fmt::print("could not open directory '{}'\n", inDir);
+		return 1;
+	}
+	// Sorted, so that blobs of neighbouring keys are near each other in the pack.
+	std::sort(names.begin(), names.end());
+
+	PackFile existing;
+	if (append) existing.open(outPath);
+
+	PackFileWriter writer;
+	if (not writer.open(outPath, append)) {
+		fmt::print("could not open '{}' for writing\n", outPath);
+		return 1;
+	}
+
+	size_t nadded = 0, nskipped = 0, nfailed = 0, nbytes = 0;
+	for (size_t i = 0; i < names.size(); i++) {
+		if (i % 10000 == 0) fmt::print("on file {} / {}\n", i, names.size());
+
+		if (existing.isOpen() and existing.find(names[i])) {
+			nskipped++;
+			continue;
+		}
+
+		MappedFile f;
+		if (not f.open(fmt::format("{}/{}", inDir, names[i])) or not writer.add(names[i], f.data(), f.size())) {
+			nfailed++;
+			continue;
+		}
+		nadded++;
+		nbytes += f.size();
+	}
+
+	fmt::print("makePackFile(added={}, skipped={}, failed={}, {:.2f}MB) -> '{}'\n", nadded, nskipped, nfailed, nbytes / double(1 << 20), outPath);
+	return nfailed == 0 ? 0 : 1;
+}
@@ -0,0 +1,62 @@
+#include "mappedFile.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace wg {
+
+	MappedFile::~MappedFile() {
+		close();
+	}
+
+	MappedFile::MappedFile(MappedFile&& o) {
+		ptr   = o.ptr;
+		len   = o.len;
+		o.ptr = nullptr;
+		o.len = 0;
+	}
+
+	MappedFile& MappedFile::operator=(MappedFile&& o) {
+		if (this != &o) {
+			close();
+			ptr   = o.ptr;
+			len   = o.len;
+			o.ptr = nullptr;
+			o.len = 0;
+		}
+		return *this;
+	}
+
+	bool MappedFile::open(const std::string& path, bool sequential) {
+		close();
+
+		int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0) return false;
+
+		struct stat st;
+		if (fstat(fd, &st) != 0 or st.st_size <= 0) {
+			::close(fd);
+			return false;
+		}
+
+		// NOTE: The mapping stays valid after the fd is closed.
+		void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		::close(fd);
+		if (p == MAP_FAILED) return false;
+
+		if (sequential) madvise(p, st.st_size, MADV_SEQUENTIAL);
+
+		ptr = (const uint8_t*)p;
+		len = st.st_size;
+		return true;
+	}
+
+	void MappedFile::close() {
+		if (ptr) munmap((void*)ptr, len);
+		ptr = nullptr;
+		len = 0;
+	}
+
+}
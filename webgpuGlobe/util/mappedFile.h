@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+namespace wg {
+
+	// A read-only memory mapping of a whole file.
+	// Used so that decoders can work on the file's bytes in place, without copying them through an iostream first.
+	struct MappedFile {
+
+		MappedFile() = default;
+		~MappedFile();
+
+		MappedFile(MappedFile&& o);
+		MappedFile& operator=(MappedFile&& o);
+		MappedFile(const MappedFile&)            = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		// Returns false if the file could not be opened or is empty.
+		// `sequential` hints the kernel to read ahead (`MADV_SEQUENTIAL`), good for files that are parsed front to back once.
+		bool open(const std::string& path, bool sequential=true);
+		void close();
+
+		inline const uint8_t* data() const { return ptr; }
+		inline size_t size() const { return len; }
+		inline bool isOpen() const { return ptr != nullptr; }
+
+		private:
+		const uint8_t* ptr = nullptr;
+		size_t len         = 0;
+	};
+
+}
@@ -34,6 +34,23 @@ namespace wg {
 			if (it == opts.end()) throw std::runtime_error(fmt::format("failed to get key '{}'", key));
             return std::get<std::string>(it->second);
         }
+
+        // Same as above, but for optional knobs: return `def` if the key was not given.
+        inline double getDouble(const std::string& key, double def) const {
+            auto it = opts.find(key);
+			if (it == opts.end()) return def;
+            return std::get<double>(it->second);
+        }
+        inline std::vector<double> getDoubleVec(const std::string& key, const std::vector<double>& def) const {
+            auto it = opts.find(key);
+			if (it == opts.end()) return def;
+            return std::get<std::vector<double>>(it->second);
+        }
+        inline std::string getString(const std::string& key, const std::string& def) const {
+            auto it = opts.find(key);
+			if (it == opts.end()) return def;
+            return std::get<std::string>(it->second);
+        }
     };
 
 	GlobeOptions parseArgs(const char* argv[], int argc);
@@ -0,0 +1,217 @@
+#include "packFile.h"
+#include "mappedFile.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace wg {
+
+	namespace {
+		constexpr char kIndexMagic[8] = { 'W', 'G', 'P', 'K', 'I', 'D', 'X', '1' };
+		constexpr size_t kRecordHeaderSize = 8 + 4 + 2;
+
+		// Parses as many whole records as there are. `validLen` is set to the length they span (including the magic).
+		// Returns false if the magic is wrong.
+		bool parseIndex(const uint8_t* p, size_t len, std::vector<PackFile::Entry>& out, size_t& validLen) {
+			validLen = 0;
+			if (len < sizeof(kIndexMagic) or memcmp(p, kIndexMagic, sizeof(kIndexMagic)) != 0) return false;
+
+			size_t i = sizeof(kIndexMagic);
+			while (i + kRecordHeaderSize <= len) {
+				PackFile::Entry e;
+				uint16_t keyLen;
+				memcpy(&e.offset, p + i + 0, 8);
+				memcpy(&e.size, p + i + 8, 4);
+				memcpy(&keyLen, p + i + 12, 2);
+				if (i + kRecordHeaderSize + keyLen > len) break;
+				e.key.assign((const char*)p + i + kRecordHeaderSize, keyLen);
+				out.push_back(std::move(e));
+				i += kRecordHeaderSize + keyLen;
+			}
+			validLen = i;
+			return true;
+		}
+
+		bool writeAll(int fd, const void* data, size_t len) {
+			const uint8_t* p = (const uint8_t*)data;
+			while (len > 0) {
+				ssize_t n = ::write(fd, p, len);
+				if (n <= 0) return false;
+				p += n;
+				len -= n;
+			}
+			return true;
+		}
+	}
+
+	// -----------------------------------------------------------------------------------------------------
+	// PackFile
+	// -----------------------------------------------------------------------------------------------------
+
+	PackFile::~PackFile() {
+		close();
+	}
+
+	bool PackFile::open(const std::string& path) {
+		close();
+
+		MappedFile idx;
+		if (not idx.open(path + ".idx")) return false;
+
+		size_t validLen;
+		if (not parseIndex(idx.data(), idx.size(), entries_, validLen)) {
+			entries_.clear();
+			return false;
+		}
+
+		fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0) {
+			entries_.clear();
+			return false;
+		}
+
+		// Drop records that point past the end of the data (a truncated copy, say).
+		struct stat st;
+		uint64_t dataSize = fstat(fd, &st) == 0 ? st.st_size : 0;
+		entries_.erase(std::remove_if(entries_.begin(), entries_.end(), [dataSize](const Entry& e) {
+			return e.offset + e.size > dataSize;
+		}), entries_.end());
+
+		// Stable, so that of duplicate keys the last written one ends up last, and is kept.
+		std::stable_sort(entries_.begin(), entries_.end(), [](const Entry& a, const Entry& b) { return a.key < b.key; });
+		auto dup = [](const Entry& a, const Entry& b) { return a.key == b.key; };
+		auto last = entries_.end();
+		std::vector<Entry> deduped;
+		deduped.reserve(entries_.size());
+		for (auto it = entries_.begin(); it != last; ++it) {
+			if (it + 1 != last and dup(*it, *(it + 1))) continue;
+			deduped.push_back(std::move(*it));
+		}
+		entries_ = std::move(deduped);
+
+		return true;
+	}
+
+	void PackFile::close() {
+		if (fd >= 0) ::close(fd);
+		fd = -1;
+		entries_.clear();
+	}
+
+	const PackFile::Entry* PackFile::find(const std::string& key) const {
+		auto it = std::lower_bound(entries_.begin(), entries_.end(), key, [](const Entry& e, const std::string& k) { return e.key < k; });
+		if (it == entries_.end() or it->key != key) return nullptr;
+		return &*it;
+	}
+
+	bool PackFile::read(const std::string& key, std::vector<uint8_t>& out) const {
+		const Entry* e = find(key);
+		return e != nullptr and read(*e, out);
+	}
+
+	bool PackFile::read(const Entry& e, std::vector<uint8_t>& out) const {
+		return readPrefix(e, e.size, out);
+	}
+
+	bool PackFile::readPrefix(const Entry& e, size_t len, std::vector<uint8_t>& out) const {
+		len = std::min<size_t>(len, e.size);
+		out.resize(len);
+		size_t done = 0;
+		while (done < len) {
+			ssize_t n = pread(fd, out.data() + done, len - done, e.offset + done);
+			if (n <= 0) return false;
+			done += n;
+		}
+		return true;
+	}
+
+	// -----------------------------------------------------------------------------------------------------
+	// PackFileWriter
+	// -----------------------------------------------------------------------------------------------------
+
+	PackFileWriter::~PackFileWriter() {
+		close();
+	}
+
+	bool PackFileWriter::open(const std::string& path, bool append) {
+		close();
+
+		std::string idxPath = path + ".idx";
+		size_t idxValidLen = 0;
+		if (append) {
+			MappedFile idx;
+			std::vector<PackFile::Entry> entries;
+			if (idx.open(idxPath) and not parseIndex(idx.data(), idx.size(), entries, idxValidLen)) return false;
+		}
+
+		int flags = O_WRONLY | O_CREAT | O_CLOEXEC | (append ? 0 : O_TRUNC);
+		dataFd = ::open(path.c_str(), flags, 0644);
+		idxFd  = ::open(idxPath.c_str(), flags, 0644);
+		if (dataFd < 0 or idxFd < 0) {
+			close();
+			return false;
+		}
+
+		if (idxValidLen > 0) {
+			if (ftruncate(idxFd, idxValidLen) != 0) {
+				close();
+				return false;
+			}
+			lseek(idxFd, idxValidLen, SEEK_SET);
+			idxEnd = idxValidLen;
+		} else {
+			if (ftruncate(idxFd, 0) != 0 or not writeAll(idxFd, kIndexMagic, sizeof(kIndexMagic))) {
+				close();
+				return false;
+			}
+			idxEnd = sizeof(kIndexMagic);
+		}
+
+		off_t end = lseek(dataFd, 0, SEEK_END);
+		if (end < 0) {
+			close();
+			return false;
+		}
+		dataEnd = end;
+		return true;
+	}
+
+	void PackFileWriter::close() {
+		if (dataFd >= 0) ::close(dataFd);
+		if (idxFd >= 0) ::close(idxFd);
+		dataFd = idxFd = -1;
+		dataEnd = idxEnd = 0;
+	}
+
+	bool PackFileWriter::rollback_() {
+		bool ok = ftruncate(dataFd, dataEnd) == 0 and lseek(dataFd, dataEnd, SEEK_SET) == (off_t)dataEnd
+				  and ftruncate(idxFd, idxEnd) == 0 and lseek(idxFd, idxEnd, SEEK_SET) == (off_t)idxEnd;
+		if (not ok) close();
+		return false;
+	}
+
+	bool PackFileWriter::add(const std::string& key, const uint8_t* data, size_t len) {
+		if (dataFd < 0 or key.size() > UINT16_MAX or len > UINT32_MAX) return false;
+
+		if (not writeAll(dataFd, data, len)) return rollback_();
+
+		std::vector<uint8_t> rec(kRecordHeaderSize + key.size());
+		uint64_t offset = dataEnd;
+		uint32_t size   = len;
+		uint16_t keyLen = key.size();
+		memcpy(rec.data() + 0, &offset, 8);
+		memcpy(rec.data() + 8, &size, 4);
+		memcpy(rec.data() + 12, &keyLen, 2);
+		memcpy(rec.data() + kRecordHeaderSize, key.data(), key.size());
+
+		if (not writeAll(idxFd, rec.data(), rec.size())) return rollback_();
+		dataEnd += len;
+		idxEnd += rec.size();
+		return true;
+	}
+
+}
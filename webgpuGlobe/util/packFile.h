@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace wg {
+
+	//
+	// Many small blobs (e.g. gearth `node/` & `bulk/` files) stored in one large file, looked up by key.
+	//
+	// On disk a pack is two files:
+	//     <path>     : the blobs, back to back.
+	//     <path>.idx : "WGPKIDX1", then one record per blob: { u64 offset, u32 size, u16 keyLen, char key[keyLen] }.
+	// The index is append-only and unsorted on disk, and sorted by key when loaded.
+	// If a key appears more than once, the last record wins.
+	//
+	// Reads use `pread` on one file descriptor held open, so there are no per-blob opens (and `read` is thread safe).
+	//
+
+	struct PackFile {
+
+		struct Entry {
+			std::string key;
+			uint64_t offset;
+			uint32_t size;
+		};
+
+		PackFile() = default;
+		~PackFile();
+
+		PackFile(const PackFile&)            = delete;
+		PackFile& operator=(const PackFile&) = delete;
+
+		// Returns false if either file is missing or the index is malformed.
+		bool open(const std::string& path);
+		void close();
+
+		inline bool isOpen() const { return fd >= 0; }
+
+		// Returns nullptr if `key` is not in the pack.
+		const Entry* find(const std::string& key) const;
+
+		// Reads the blob for `key` into `out`. Returns false if it is missing or the read fails.
+		bool read(const std::string& key, std::vector<uint8_t>& out) const;
+		bool read(const Entry& e, std::vector<uint8_t>& out) const;
+		// Just the first `len` bytes of the blob (or all of it, if it is shorter), e.g. to check a header.
+		bool readPrefix(const Entry& e, size_t len, std::vector<uint8_t>& out) const;
+
+		// Sorted by key.
+		inline const std::vector<Entry>& entries() const { return entries_; }
+
+		private:
+		int fd = -1;
+		std::vector<Entry> entries_;
+	};
+
+	struct PackFileWriter {
+
+		PackFileWriter() = default;
+		~PackFileWriter();
+
+		PackFileWriter(const PackFileWriter&)            = delete;
+		PackFileWriter& operator=(const PackFileWriter&) = delete;
+
+		// If `append` and the pack exists, new blobs go after the existing ones.
+		// (A partial index record left by a crash is cut off first. Blob bytes without an index record are just dead space.)
+		// Returns false on failure.
+		bool open(const std::string& path, bool append=false);
+		void close();
+
+		// Blob first, then its index record, so that a record never points at missing data.
+		// If either write fails, both files are cut back to where they were, so the next `add` is still correct.
+		// If even that fails, the writer closes: every later `add` returns false.
+		bool add(const std::string& key, const uint8_t* data, size_t len);
+
+		private:
+		bool rollback_();
+
+		int dataFd     = -1;
+		int idxFd      = -1;
+		uint64_t dataEnd = 0;
+		uint64_t idxEnd  = 0;
+	};
+
+}
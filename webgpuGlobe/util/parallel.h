@@ -0,0 +1,37 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace wg {
+
+	// Runs `f(i, worker)` for every i in [0, n), on `nthreads` threads. `worker` is in [0, nthreads),
+	// so per-thread state (e.g. scratch buffers) can be indexed by it.
+	// Indices are handed out one at a time, so uneven item costs balance out. Returns when all are done.
+	template <class F>
+	inline void parallelFor(size_t n, int nthreads, F&& f) {
+		if (nthreads <= 1 or n <= 1) {
+			for (size_t i = 0; i < n; i++) f(i, 0);
+			return;
+		}
+
+		std::atomic<size_t> next { 0 };
+		std::vector<std::thread> threads;
+		threads.reserve(nthreads);
+		for (int t = 0; t < nthreads; t++) {
+			threads.emplace_back([&, t]() {
+				for (size_t i = next++; i < n; i = next++) f(i, t);
+			});
+		}
+		for (auto& th : threads) th.join();
+	}
+
+	// `hardware_concurrency`, or `def` if that is unknown.
+	inline int defaultThreadCount(int def = 4) {
+		unsigned n = std::thread::hardware_concurrency();
+		return n == 0 ? def : (int)n;
+	}
+
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#endif
+
+//
+// What the SIMD kernels (`util/colorKernels.h`, `gearth/decode/rt_simd.hpp`) share: the switch to turn them all off,
+// the runtime SSSE3 check, and the pshufb 3 -> 4 channel expansion they both do.
+//
+
+namespace wg {
+
+	// Flip to false to force the scalar paths of every kernel (for testing and benchmarking).
+	inline bool& simdEnabled() {
+		static bool enabled = true;
+		return enabled;
+	}
+
+#if defined(__SSE2__)
+	inline bool haveSsse3() {
+		static const bool have = __builtin_cpu_supports("ssse3");
+		return have;
+	}
+
+	// Packed 3 byte pixels -> 4 byte pixels with alpha 255, 4 pixels (12 bytes in, 16 out) per pshufb.
+	// `shuf` picks the input byte of each output byte (e.g. `2,1,0,-1, ...` swaps BGR to RGB). `post` is applied to the
+	// shuffled 16 bytes before the alpha is set. Returns how many pixels it did: the caller does the rest with its scalar loop,
+	// since the 16 byte loads would read past the end of `in` for the last pixels.
+	template <class Post>
+	__attribute__((target("ssse3"))) inline size_t expand3to4_ssse3(const uint8_t* in, size_t npix, uint8_t* out, __m128i shuf, Post&& post) {
+		const __m128i alpha = _mm_set1_epi32(0xFF000000);
+		size_t i = 0;
+		for (; i + 6 <= npix; i += 4) {
+			__m128i v = post(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(in + i * 3)), shuf));
+			_mm_storeu_si128((__m128i*)(out + i * 4), _mm_or_si128(v, alpha));
+		}
+		return i;
+	}
+#endif
+
+}